@@ -0,0 +1,136 @@
+#include "banlist.hpp"
+
+#include <algorithm>
+#include <ctime>
+#include <vector>
+
+#include "database.hpp"
+#include "util.hpp"
+
+template <class T> static void banlist_unindex(std::unordered_multimap<T, std::list<BanList::Ban>::iterator> &index, const T &key, std::list<BanList::Ban>::iterator it)
+{
+	auto range = index.equal_range(key);
+
+	for (auto i = range.first; i != range.second; ++i)
+	{
+		if (i->second == it)
+		{
+			index.erase(i);
+			return;
+		}
+	}
+}
+
+BanList::BanList()
+	: loaded(false)
+{ }
+
+void BanList::Load(Database &db)
+{
+	// NULL can't be told apart from '' or 0 by every driver, so it's asked for explicitly
+	Database_Result res = db.Execute("SELECT `username`, `ip`, `hdid`, `expires`, `username` IS NULL AS `no_username`, `ip` IS NULL AS `no_ip`, `hdid` IS NULL AS `no_hdid` "
+		"FROM `bans` WHERE `expires` = 0 OR `expires` > ?", Database_Params().Add(int(std::time(0))));
+
+	this->bans.clear();
+	this->by_username.clear();
+	this->by_ip.clear();
+	this->by_hdid.clear();
+
+	UTIL_FOREACH_CREF(res, row)
+	{
+		Ban ban;
+
+		ban.has_username = !row["no_username"].GetBool();
+		ban.has_ip = !row["no_ip"].GetBool();
+		ban.has_hdid = !row["no_hdid"].GetBool();
+		ban.username = row["username"].GetString();
+		ban.ip = row["ip"].GetInt();
+		ban.hdid = row["hdid"].GetInt();
+		ban.expires = row["expires"].GetInt();
+
+		this->Add(ban);
+	}
+
+	this->loaded = true;
+}
+
+void BanList::Add(const Ban &ban)
+{
+	iterator it = this->bans.insert(this->bans.end(), ban);
+
+	if (ban.has_username)
+		this->by_username.insert(std::make_pair(ban.username, it));
+
+	if (ban.has_ip)
+		this->by_ip.insert(std::make_pair(ban.ip, it));
+
+	if (ban.has_hdid)
+		this->by_hdid.insert(std::make_pair(ban.hdid, it));
+}
+
+void BanList::Erase(iterator it)
+{
+	if (it->has_username)
+		banlist_unindex(this->by_username, it->username, it);
+
+	if (it->has_ip)
+		banlist_unindex(this->by_ip, it->ip, it);
+
+	if (it->has_hdid)
+		banlist_unindex(this->by_hdid, it->hdid, it);
+
+	this->bans.erase(it);
+}
+
+void BanList::Remove(const std::string &username)
+{
+	auto range = this->by_username.equal_range(username);
+	std::vector<iterator> matches;
+
+	for (auto i = range.first; i != range.second; ++i)
+		matches.push_back(i->second);
+
+	UTIL_FOREACH(matches, it)
+	{
+		this->Erase(it);
+	}
+}
+
+int BanList::Check(const std::string *username, const int *ip, const int *hdid, int now) const
+{
+	int expires = -1;
+
+	auto match = [&](const Ban &ban)
+	{
+		if (ban.expires == 0)
+			expires = std::max(expires, 0);
+		else if (ban.expires > now)
+			expires = std::max(expires, ban.expires);
+	};
+
+	if (username)
+	{
+		auto range = this->by_username.equal_range(*username);
+
+		for (auto i = range.first; i != range.second; ++i)
+			match(*i->second);
+	}
+
+	if (ip)
+	{
+		auto range = this->by_ip.equal_range(*ip);
+
+		for (auto i = range.first; i != range.second; ++i)
+			match(*i->second);
+	}
+
+	if (hdid)
+	{
+		auto range = this->by_hdid.equal_range(*hdid);
+
+		for (auto i = range.first; i != range.second; ++i)
+			match(*i->second);
+	}
+
+	return expires;
+}
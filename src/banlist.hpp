@@ -0,0 +1,81 @@
+#ifndef BANLIST_HPP_INCLUDED
+#define BANLIST_HPP_INCLUDED
+
+#include "fwd/banlist.hpp"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "fwd/database.hpp"
+
+/**
+ * Copy of the unexpired rows of the bans table, indexed by username, IP and HDID
+ */
+class BanList
+{
+	public:
+		struct Ban
+		{
+			// Rows can leave any of these NULL, in which case they never match
+			bool has_username, has_ip, has_hdid;
+
+			std::string username;
+			int ip;
+			int hdid;
+
+			// 0 for a permanent ban
+			int expires;
+
+			Ban()
+				: has_username(false)
+				, has_ip(false)
+				, has_hdid(false)
+				, ip(0)
+				, hdid(0)
+				, expires(0)
+			{ }
+		};
+
+	protected:
+		typedef std::list<Ban>::iterator iterator;
+
+		std::list<Ban> bans;
+
+		std::unordered_multimap<std::string, iterator> by_username;
+		std::unordered_multimap<int, iterator> by_ip;
+		std::unordered_multimap<int, iterator> by_hdid;
+
+		bool loaded;
+
+		void Erase(iterator it);
+
+	public:
+		BanList();
+
+		/**
+		 * Replaces the contents of the list with the unexpired rows of the bans table
+		 * @throw Database_Exception
+		 */
+		void Load(Database &db);
+
+		bool Loaded() const { return this->loaded; }
+
+		void Add(const Ban &ban);
+
+		/**
+		 * Removes every ban on a username, along with the IP and HDID bans made with it
+		 */
+		void Remove(const std::string &username);
+
+		/**
+		 * Finds the latest expiry of the unexpired bans matching any of the given keys, the same as
+		 * SELECT COALESCE(MAX(expires), -1) FROM bans WHERE (...) AND (expires > now OR expires = 0)
+		 * @return -1 if none match, 0 if the latest is permanent
+		 */
+		int Check(const std::string *username, const int *ip, const int *hdid, int now) const;
+
+		std::size_t Size() const { return this->bans.size(); }
+};
+
+#endif // BANLIST_HPP_INCLUDED
@@ -17,6 +17,7 @@
 #include "eoclient.hpp"
 #include "eodata.hpp"
 #include "eoplus.hpp"
+#include "journal.hpp"
 #include "map.hpp"
 #include "npc.hpp"
 #include "packet.hpp"
@@ -99,10 +100,91 @@ void character_cast_spell(void *character_void)
 	}
 }
 
+// Packed columns start with a marker that the text format never does, then a format version
+static const char packed_marker = '!';
+static const char packed_version = '1';
+
+static bool packed_serialize = false;
+
+// Numbers are written 4 bits at a time, lowest first, as 'a'-'p' with 'A'-'P' for the last group.
+// Sticking to letters keeps packed columns safe in TEXT columns, SQL dumps and LIKE patterns.
+static void packed_put(std::string &serialized, unsigned int value)
+{
+	while (value >= 16)
+	{
+		serialized += char('a' + (value & 15));
+		value >>= 4;
+	}
+
+	serialized += char('A' + value);
+}
+
+static bool packed_get(const std::string &serialized, std::size_t &pos, unsigned int &value)
+{
+	value = 0;
+
+	for (int shift = 0; pos < serialized.length() && shift < 32; shift += 4)
+	{
+		char c = serialized[pos++];
+
+		if (c >= 'a' && c <= 'p')
+		{
+			value |= (unsigned int)(c - 'a') << shift;
+		}
+		else if (c >= 'A' && c <= 'P')
+		{
+			value |= (unsigned int)(c - 'A') << shift;
+			return true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return false;
+}
+
+static std::string packed_begin()
+{
+	std::string serialized;
+	serialized += packed_marker;
+	serialized += packed_version;
+	return serialized;
+}
+
+static bool packed_check(const std::string &serialized)
+{
+	return serialized.length() >= 2 && serialized[0] == packed_marker && serialized[1] == packed_version;
+}
+
+void SetPackedSerialize(bool packed)
+{
+	packed_serialize = packed;
+}
+
 std::string ItemSerialize(const std::list<Character_Item> &list)
+{
+	return ItemSerialize(list, packed_serialize);
+}
+
+std::string ItemSerialize(const std::list<Character_Item> &list, bool packed)
 {
 	std::string serialized;
 
+	if (packed)
+	{
+		serialized = packed_begin();
+
+		UTIL_FOREACH_CREF(list, item)
+		{
+			packed_put(serialized, (unsigned short)item.id);
+			packed_put(serialized, item.amount);
+		}
+
+		return serialized;
+	}
+
 	UTIL_CIFOREACH(list, item)
 	{
 		serialized.append(util::to_string(item->id));
@@ -118,6 +200,17 @@ std::list<Character_Item> ItemUnserialize(const std::string& serialized)
 {
 	std::list<Character_Item> list;
 
+	if (packed_check(serialized))
+	{
+		std::size_t pos = 2;
+		unsigned int id, amount;
+
+		while (packed_get(serialized, pos, id) && packed_get(serialized, pos, amount))
+			list.emplace_back(short(id), int(amount));
+
+		return list;
+	}
+
 	std::vector<std::string> parts = util::explode(';', serialized);
 
 	UTIL_FOREACH(parts, part)
@@ -140,9 +233,26 @@ std::list<Character_Item> ItemUnserialize(const std::string& serialized)
 }
 
 std::string DollSerialize(const std::array<int, 15> &list)
+{
+	return DollSerialize(list, packed_serialize);
+}
+
+std::string DollSerialize(const std::array<int, 15> &list, bool packed)
 {
 	std::string serialized;
 
+	if (packed)
+	{
+		serialized = packed_begin();
+
+		UTIL_FOREACH(list, item)
+		{
+			packed_put(serialized, item);
+		}
+
+		return serialized;
+	}
+
 	UTIL_FOREACH (list, item)
 	{
 		serialized.append(util::to_string(item));
@@ -157,6 +267,17 @@ std::array<int, 15> DollUnserialize(const std::string& serialized)
 	std::array<int, 15> list{{}};
 	std::size_t i = 0;
 
+	if (packed_check(serialized))
+	{
+		std::size_t pos = 2;
+		unsigned int item;
+
+		while (i < list.size() && packed_get(serialized, pos, item))
+			list[i++] = int(item);
+
+		return list;
+	}
+
 	std::vector<std::string> parts = util::explode(',', serialized);
 
 	UTIL_FOREACH(parts, part)
@@ -171,9 +292,27 @@ std::array<int, 15> DollUnserialize(const std::string& serialized)
 }
 
 std::string SpellSerialize(const std::list<Character_Spell> &list)
+{
+	return SpellSerialize(list, packed_serialize);
+}
+
+std::string SpellSerialize(const std::list<Character_Spell> &list, bool packed)
 {
 	std::string serialized;
 
+	if (packed)
+	{
+		serialized = packed_begin();
+
+		UTIL_FOREACH_CREF(list, spell)
+		{
+			packed_put(serialized, (unsigned short)spell.id);
+			packed_put(serialized, spell.level);
+		}
+
+		return serialized;
+	}
+
 	UTIL_FOREACH (list, spell)
 	{
 		serialized.append(util::to_string(spell.id));
@@ -189,6 +328,17 @@ std::list<Character_Spell> SpellUnserialize(const std::string& serialized)
 {
 	std::list<Character_Spell> list;
 
+	if (packed_check(serialized))
+	{
+		std::size_t pos = 2;
+		unsigned int id, level;
+
+		while (packed_get(serialized, pos, id) && packed_get(serialized, pos, level))
+			list.emplace_back(short(id), (unsigned char)level);
+
+		return list;
+	}
+
 	std::vector<std::string> parts = util::explode(';', serialized);
 
 	UTIL_FOREACH(parts, part)
@@ -394,7 +544,7 @@ std::vector<std::string> BotListUnserialize(std::string serialized)
 	return bots;
 }
 
-template <typename T> static T GetRow(std::unordered_map<std::string, util::variant> &row, const char *col)
+template <typename T> static T GetRow(const Database_Row &row, const char *col)
 {
 	return row[col];
 }
@@ -424,12 +574,14 @@ display_cha(this->world->config["UseAdjustedStats"] ? adj_cha : cha)
 	    }
 	}
 
-	Database_Result res = this->world->db.Query("SELECT `name`, `title`, `guild_rankname`, `home`, `fiance`, `partner`, `admin`, `class`, `rebirth`, `immune`, `bounty`, `member`, `gender`, `race`, `oldhairstyle`, `hairstyle`, `haircolor`,"
+	this->world->WaitForQueued("character:" + name);
+
+	Database_Result res = this->world->db.Execute("SELECT `name`, `title`, `guild_rankname`, `home`, `fiance`, `partner`, `admin`, `class`, `rebirth`, `immune`, `bounty`, `member`, `gender`, `race`, `oldhairstyle`, `hairstyle`, `haircolor`,"
 	"`map`, `x`, `y`, `oldmap`, `oldx`, `oldy`, `direction`, `level`, `exp`, `flevel`, `fexp`, `mlevel`, `mexp`, `wlevel`, `wexp`, `clevel`, `cexp`, `lockerpin`, `hp`, `tp`, `str`, `int`, `wis`, `agi`, `con`, `cha`, `statpoints`, `skillpoints`, "
 	"`karma`, `sitting`, `bankmax`, `goldbank`, `usage`, `warn`, `inventory`, `bank`, `paperdoll`, `spells`, `guild`, `guild_rank`, `quest`, `achievements`, `vars`, `nointeract` FROM `characters` "
-	"WHERE `name` = '$'", name.c_str());
+	"WHERE `name` = ?", Database_Params().Add(name));
 
-	std::unordered_map<std::string, util::variant> row = res.front();
+	Database_Row row = res.front();
 
 	this->login_time = std::time(0);
 
@@ -624,6 +776,7 @@ display_cha(this->world->config["UseAdjustedStats"] ? adj_cha : cha)
 	this->party = 0;
 	this->map = this->world->GetMap(GetRow<int>(row, "map"));
 	this->mapid = this->map->id;
+	this->grid_cell = -1;
 
 	this->last_walk = 0.0;
 	this->attacks = 0;
@@ -636,6 +789,8 @@ display_cha(this->world->config["UseAdjustedStats"] ? adj_cha : cha)
     {
         this->nointeract = static_cast<int>(world->config["NoInteractDefault"]);
     }
+	this->saved = std::make_shared<Character_SaveState>(this->SaveState());
+	this->journaled = this->JournalState();
 }
 
 void Character::Login()
@@ -1339,7 +1494,7 @@ bool Character::Equip(short item, unsigned char subloc)
 
 bool Character::InRange(unsigned char x, unsigned char y) const
 {
-	return util::path_length(this->x, this->y, x, y) <= static_cast<int>(this->world->config.at("SeeDistance"));
+	return util::path_length(this->x, this->y, x, y) <= this->world->hot_config.see_distance;
 }
 
 bool Character::InRange(const Character *other) const
@@ -2369,7 +2524,7 @@ void Character::PetTransfer()
                 this->pet->RemoveFromView(character);
         }
 
-        pet->map->npcs.erase(std::remove(pet->map->npcs.begin(), pet->map->npcs.end(), pet),this->map->npcs.end());
+        pet->map->RemoveNPC(pet);
 
         this->HasPet = false;
         this->pettransfer = true;
@@ -2388,12 +2543,12 @@ void Character::SavePet()
 {
     if (HasPet)
     {
-        this->world->db.Query("UPDATE `pets` SET `name` = '$', `owner_name` = '$', `npcid` = #, "
-        "`rebirth` = #, `level` = #, `exp` = #, `hp` = #, `tp` = #, "
-        "`inventory` = '$' WHERE `name` = '$' AND `owner_name` = '$'",
+        this->world->QueueExecute("UPDATE `pets` SET `name` = ?, `owner_name` = ?, `npcid` = ?, "
+        "`rebirth` = ?, `level` = ?, `exp` = ?, `hp` = ?, `tp` = ?, "
+        "`inventory` = ? WHERE `name` = ? AND `owner_name` = ?",
 
-        this->pet->name.c_str(), this->SourceName().c_str(), this->pet->id, this->pet->rebirth, this->pet->level, this->pet->exp, this->pet->hp, this->pet->tp,
-        ItemSerialize(this->pet->inventory).c_str(), this->pet->name.c_str(), this->SourceName().c_str());
+        Database_Params().Add(this->pet->name).Add(this->SourceName()).Add(this->pet->id).Add(this->pet->rebirth).Add(this->pet->level).Add(this->pet->exp).Add(this->pet->hp).Add(this->pet->tp)
+        .Add(ItemSerialize(this->pet->inventory)).Add(this->pet->name).Add(this->SourceName()), {"character:" + this->SourceName()});
     }
     else
     {
@@ -2403,6 +2558,8 @@ void Character::SavePet()
 
 bool Character::PetNameTaken(Character *owner, std::string petname)
 {
+    this->world->WaitForQueued("character:" + owner->SourceName());
+
     Database_Result res = this->world->db.Query("SELECT `name` FROM `pets` WHERE `name` = '$' AND `owner_name` = '$'", petname.c_str(), owner->SourceName().c_str());
 
     return res.empty() ? true : false;
@@ -2412,6 +2569,8 @@ bool Character::HatchPet(Character *hatcher, int npcid)
 {
     ENF_Data& npc = hatcher->world->enf->Get(npcid);
 
+    this->world->WaitForQueued("character:" + hatcher->SourceName());
+
     Database_Result res = this->world->db.Query("SELECT `npcid` FROM `pets` WHERE `owner_name` = '$' AND `npcid` = #", hatcher->SourceName().c_str(), npcid);
 
     if (res.empty())
@@ -2434,6 +2593,8 @@ bool Character::HatchPet(Character *hatcher, int npcid)
 
 bool Character::RevivePets()
 {
+    this->world->WaitForQueued("character:" + this->SourceName());
+
     Database_Result res = this->world->db.Query("SELECT `npcid`, `hp` FROM `pets` WHERE `owner_name` = '$'", this->SourceName().c_str());
 
     if (!res.empty())
@@ -2467,13 +2628,15 @@ void Character::SummonPet(Character *owner, std::string petname)
     if (this->HasPet)
         this->SavePet();
 
+    this->world->WaitForQueued("character:" + owner->SourceName());
+
     Database_Result res = this->world->db.Query("SELECT `name`, `owner_name`, `npcid`, "
     "`rebirth`, `level`, `exp`, `hp`, `tp`, "
     "`inventory` FROM `pets` WHERE `name` = '$' AND `owner_name` = '$'", petname.c_str(), owner->SourceName().c_str());
 
     if (!res.empty())
     {
-        std::unordered_map<std::string, util::variant> row = res.front();
+        Database_Row row = res.front();
 
         if (owner->HasPet)
         {
@@ -2489,7 +2652,7 @@ void Character::SummonPet(Character *owner, std::string petname)
         int petid = GetRow<int>(row, "npcid");
 
         NPC *npc = new NPC(owner->map, petid, owner->x, owner->y, 1, 1, index, true, true);
-        owner->map->npcs.push_back(npc);
+        owner->map->AddNPC(npc);
         npc->Spawn();
 
         npc->owner = owner;
@@ -2535,13 +2698,15 @@ bool Character::AddPet(Character *owner, int npcid)
     if (this->HasPet)
         this->SavePet();
 
+    this->world->WaitForQueued("character:" + owner->SourceName());
+
     Database_Result res = this->world->db.Query("SELECT `name`, `owner_name`, `npcid`, "
     "`rebirth`, `level`, `exp`, `hp`, `tp`, "
     "`inventory` FROM `pets` WHERE `npcid` = '#' AND `owner_name` = '$'", npcid, owner->SourceName().c_str());
 
     if (!res.empty())
     {
-        std::unordered_map<std::string, util::variant> row = res.front();
+        Database_Row row = res.front();
 
         if (owner->HasPet)
         {
@@ -2557,7 +2722,7 @@ bool Character::AddPet(Character *owner, int npcid)
         int petid = GetRow<int>(row, "npcid");
 
         NPC *npc = new NPC(owner->map, petid, owner->x, owner->y, 1, 1, index, true, true);
-        owner->map->npcs.push_back(npc);
+        owner->map->AddNPC(npc);
         npc->Spawn();
 
         npc->owner = owner;
@@ -2620,6 +2785,11 @@ void Character::Send(const PacketBuilder &builder)
 	this->player->Send(builder);
 }
 
+void Character::Send(PacketBroadcast &packet)
+{
+	this->player->Send(packet);
+}
+
 void Character::Logout()
 {
 	if (!this->online)
@@ -3001,31 +3171,243 @@ std::string Character::ReplaceStrings(Character *from, std::string message)
     return message;
 }
 
-void Character::Save()
-{
-    const std::string & quest_data = (!this->quest_string.empty()) ? this->quest_string : QuestSerialize(this->quests, this->quests_inactive);
+// Assignments for the parameters in Character_SaveState::stats
+static const char *character_stats_columns = "`title` = ?, `guild_rankname` = ?, `home` = ?, `fiance` = ?, `partner` = ?, `admin` = ?, `class` = ?, `rebirth` = ?, `immune` = ?, `bounty` = ?, `member` = ?, `gender` = ?, `race` = ?, "
+    "`oldhairstyle` = ?, `hairstyle` = ?, `haircolor` = ?, `map` = ?, `x` = ?, `y` = ?, `oldmap` = ?, `oldx` = ?, `oldy` = ?, `direction` = ?, `level` = ?, `exp` = ?, `flevel` = ?, `fexp` = ?, `mlevel` = ?, `mexp` = ?, "
+    "`wlevel` = ?, `wexp` = ?, `clevel` = ?, `cexp` = ?, `lockerpin` = ?, `hp` = ?, `tp` = ?, `str` = ?, `int` = ?, `wis` = ?, `agi` = ?, `con` = ?, `cha` = ?, `statpoints` = ?, `skillpoints` = ?, `karma` = ?, `sitting` = ?, "
+    "`nointeract` = ?, `bankmax` = ?, `goldbank` = ?, `warn` = ?, `guild` = ?, guild_rank = ?, `vars` = ?";
 
+Character_SaveState Character::SaveState()
+{
     int nointeract = this->nointeract;
 
     if (!(nointeract & NoInteractCustom))
         nointeract = 0;
 
+	Character_SaveState state;
+
+	state.stats.Add(this->title).Add(this->guild_rankname).Add(this->home).Add(this->fiance).Add(this->partner).Add(int(this->admin)).Add(this->clas).Add(this->rebirth).Add(this->immune).Add(this->bounty).Add(this->member).Add(int(this->gender)).Add(int(this->race))
+	    .Add(this->oldhairstyle).Add(this->hairstyle).Add(this->haircolor).Add(this->mapid).Add(this->x).Add(this->y).Add(this->oldmap).Add(this->oldx).Add(this->oldy).Add(int(this->direction)).Add(this->level).Add(this->exp).Add(this->flevel).Add(this->fexp).Add(this->mlevel).Add(this->mexp)
+	    .Add(this->wlevel).Add(this->wexp).Add(this->clevel).Add(this->cexp).Add(this->lockerpin).Add(this->hp).Add(this->tp).Add(this->str).Add(this->intl).Add(this->wis).Add(this->agi).Add(this->con).Add(this->cha).Add(this->statpoints).Add(this->skillpoints).Add(this->karma).Add(int(this->sitting))
+	    .Add(nointeract).Add(this->bankmax).Add(this->goldbank).Add(this->warn).Add(this->guild ? this->guild->tag : std::string()).Add(this->guild_rank).Add("");
+
+	state.usage = this->Usage();
+	state.inventory = this->inventory;
+	state.bank = this->bank;
+	state.paperdoll = this->paperdoll;
+	state.spells = this->spells;
+	state.quest = (!this->quest_string.empty()) ? this->quest_string : QuestSerialize(this->quests, this->quests_inactive);
+	state.achievements = this->achievements;
+
+	return state;
+}
+
+// Pairs of (item id, new amount) for every item whose amount differs, with 0 for removed items
+static std::vector<int> journal_item_changes(const std::list<Character_Item> &from, const std::list<Character_Item> &to)
+{
+	std::map<short, int> amounts;
+	std::vector<int> changes;
+
+	UTIL_FOREACH_CREF(from, item)
+	{
+		amounts[item.id] += item.amount;
+	}
+
+	UTIL_FOREACH_CREF(to, item)
+	{
+		amounts[item.id] -= item.amount;
+	}
+
+	UTIL_FOREACH_CREF(amounts, change)
+	{
+		if (change.second == 0)
+			continue;
+
+		int amount = 0;
+
+		UTIL_FOREACH_CREF(to, item)
+		{
+			if (item.id == change.first)
+				amount += item.amount;
+		}
+
+		changes.push_back(change.first);
+		changes.push_back(amount);
+	}
+
+	return changes;
+}
+
+Character_JournalState Character::JournalState()
+{
+	Character_JournalState state;
+
+	state.map = this->mapid;
+	state.x = this->x;
+	state.y = this->y;
+	state.direction = this->direction;
+	state.level = this->level;
+	state.exp = this->exp;
+	state.statpoints = this->statpoints;
+	state.skillpoints = this->skillpoints;
+	state.goldbank = this->goldbank;
+	state.inventory = this->inventory;
+	state.bank = this->bank;
+	state.paperdoll = this->paperdoll;
+
+	return state;
+}
+
+bool Character::JournalChanges()
+{
+	if (!this->world->journal.IsOpen())
+		return false;
+
+	Character_JournalState state = this->JournalState();
+	const Character_JournalState &last = this->journaled;
+	bool changed = false;
+
+	auto append = [&](Journal::RecordType type, std::vector<int> values)
+	{
+		Journal::Record record;
+		record.type = type;
+		record.name = this->real_name;
+		record.values = std::move(values);
+
+		this->world->journal.Append(record);
+		changed = true;
+	};
+
+	if (state.map != last.map || state.x != last.x || state.y != last.y || state.direction != last.direction)
+		append(Journal::Position, {state.map, state.x, state.y, state.direction});
+
+	if (state.level != last.level || state.exp != last.exp || state.statpoints != last.statpoints || state.skillpoints != last.skillpoints)
+		append(Journal::Progress, {state.level, state.exp, state.statpoints, state.skillpoints});
+
+	if (state.goldbank != last.goldbank)
+		append(Journal::GoldBank, {state.goldbank});
+
+	if (state.inventory != last.inventory)
+	{
+		std::vector<int> changes = journal_item_changes(last.inventory, state.inventory);
+
+		if (!changes.empty())
+			append(Journal::Inventory, std::move(changes));
+	}
+
+	if (state.bank != last.bank)
+	{
+		std::vector<int> changes = journal_item_changes(last.bank, state.bank);
+
+		if (!changes.empty())
+			append(Journal::Bank, std::move(changes));
+	}
+
+	// Equipping moves items out of the inventory, so the two are only consistent if both are replayed
+	if (state.paperdoll != last.paperdoll)
+		append(Journal::Paperdoll, std::vector<int>(UTIL_RANGE(state.paperdoll)));
+
+	this->journaled = std::move(state);
+
+	return changed;
+}
+
+void Character::Save()
+{
     #ifdef DEBUG
 	Console::Dbg("Saving character '%s' (session lasted %i minutes)", this->real_name.c_str(), int(std::time(0) - this->login_time) / 60);
     #endif
 
-	this->world->db.Query("UPDATE `characters` SET `title` = '$', `guild_rankname` = '$', `home` = '$', `fiance` = '$', `partner` = '$', `admin` = #, `class` = #, `rebirth` = #, `immune` = #, `bounty` = #, `member` = #, `gender` = #, `race` = #, "
-    "`oldhairstyle` = #, `hairstyle` = #, `haircolor` = #, `map` = #, `x` = #, `y` = #, `oldmap` = #, `oldx` = #, `oldy` = #, `direction` = #, `level` = #, `exp` = #, `flevel` = #, `fexp` = #, `mlevel` = #, `mexp` = #, "
-    "`wlevel` = #, `wexp` = #, `clevel` = #, `cexp` = #, `lockerpin` = #, `hp` = #, `tp` = #, `str` = #, `int` = #, `wis` = #, `agi` = #, `con` = #, `cha` = #, `statpoints` = #, `skillpoints` = #, `karma` = #, `sitting` = #, "
-    "`nointeract` = #, `bankmax` = #, `goldbank` = #, `usage` = #, `warn` = #, `inventory` = '$', `bank` = '$', `paperdoll` = '$', "
-    "`spells` = '$', `guild` = '$', guild_rank = #, `quest` = '$', `achievements` = '$', `vars` = '$' WHERE `name` = '$'",
-
-    this->title.c_str(), this->guild_rankname.c_str(), this->home.c_str(), this->fiance.c_str(), this->partner.c_str(), int(this->admin), this->clas, this->rebirth, this->immune, this->bounty, this->member, int(this->gender), int(this->race),
-    this->oldhairstyle, this->hairstyle, this->haircolor, this->mapid, this->x, this->y, this->oldmap, this->oldx, this->oldy, int(this->direction), this->level, this->exp, this->flevel, this->fexp, this->mlevel, this->mexp,
-    this->wlevel, this->wexp, this->clevel, this->cexp, this->lockerpin, this->hp, this->tp, this->str, this->intl, this->wis, this->agi, this->con, this->cha, this->statpoints, this->skillpoints, this->karma, int(this->sitting),
-    nointeract, this->bankmax, this->goldbank, this->Usage(), this->warn, ItemSerialize(this->inventory).c_str(), ItemSerialize(this->bank).c_str(),
-    DollSerialize(this->paperdoll).c_str(), SpellSerialize(this->spells).c_str(), (this->guild ? this->guild->tag.c_str() : ""),
-    this->guild_rank, quest_data.c_str(), AchievementsSerialize(this->achievements).c_str(), "", this->real_name.c_str());
+	// Records journaled earlier may not be on disk yet either, so this is done even if nothing changed
+	this->JournalChanges();
+	this->world->HoldSavesForJournal();
+
+	Character_SaveState state = this->SaveState();
+	std::string columns;
+	Database_Params params;
+
+	// Each combination of changed groups is its own statement, prepared the first time it's seen
+	auto add_column = [&](const char *column)
+	{
+		if (!columns.empty())
+			columns += ", ";
+
+		columns += column;
+	};
+
+	if (state.stats != this->saved->stats)
+	{
+		add_column(character_stats_columns);
+		params.Add(state.stats);
+	}
+
+	if (state.inventory != this->saved->inventory)
+	{
+		add_column("`inventory` = ?");
+		params.Add(ItemSerialize(state.inventory));
+	}
+
+	if (state.bank != this->saved->bank)
+	{
+		add_column("`bank` = ?");
+		params.Add(ItemSerialize(state.bank));
+	}
+
+	if (state.paperdoll != this->saved->paperdoll)
+	{
+		add_column("`paperdoll` = ?");
+		params.Add(DollSerialize(state.paperdoll));
+	}
+
+	if (state.spells != this->saved->spells)
+	{
+		add_column("`spells` = ?");
+		params.Add(SpellSerialize(state.spells));
+	}
+
+	if (state.quest != this->saved->quest)
+	{
+		add_column("`quest` = ?");
+		params.Add(state.quest);
+	}
+
+	if (state.achievements != this->saved->achievements)
+	{
+		add_column("`achievements` = ?");
+		params.Add(AchievementsSerialize(state.achievements));
+	}
+
+	// Play time goes up every minute, so on its own it's only written hourly and on logout
+	if (!columns.empty() || !this->online || state.usage - this->saved->usage >= 60)
+	{
+		add_column("`usage` = ?");
+		params.Add(state.usage);
+	}
+	else
+	{
+		state.usage = this->saved->usage;
+	}
+
+	if (columns.empty())
+		return;
+
+	params.Add(this->real_name);
+
+	// Loading the guild reads its members' rows, so it has to wait for this too
+	std::vector<std::string> keys = {"character:" + this->real_name};
+
+	if (this->guild)
+		keys.push_back("guild:" + this->guild->tag);
+
+	// The snapshot is only replaced once the write is committed, so a failed write is made again by the next save
+	std::shared_ptr<Character_SaveState> saved = this->saved;
+	std::shared_ptr<Character_SaveState> written = std::make_shared<Character_SaveState>(std::move(state));
+
+	this->world->QueueExecute("UPDATE `characters` SET " + columns + " WHERE `name` = ?", params, std::move(keys), [saved, written](Database_Result &result)
+	{
+		if (!result.Error())
+			*saved = std::move(*written);
+	});
 }
 
 AdminLevel Character::SourceAccess() const
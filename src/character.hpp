@@ -8,6 +8,7 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 
 #include "fwd/arena.hpp"
@@ -21,6 +22,7 @@
 #include "fwd/world.hpp"
 
 #include "command_source.hpp"
+#include "database.hpp"
 #include "eodata.hpp"
 #include "guild.hpp"
 
@@ -58,10 +60,18 @@ struct Timestamp
 
 void character_cast_spell(void *character_void);
 
+/**
+ * Sets which format the Item, Doll and Spell serialize functions write by default.
+ * Packed columns are a version marker followed by variable-length numbers, and the
+ * unserialize functions read both formats.
+ */
+void SetPackedSerialize(bool packed);
+
 /**
  * Serialize a list of items in to a text format that can be restored with ItemUnserialize
  */
 std::string ItemSerialize(const std::list<Character_Item> &list);
+std::string ItemSerialize(const std::list<Character_Item> &list, bool packed);
 
 /**
  * Convert a string generated by ItemSerialze back to a list of items
@@ -72,6 +82,7 @@ std::list<Character_Item> ItemUnserialize(const std::string& serialized);
  * Serialize a paperdoll of 15 items in to a string that can be restored with DollUnserialize
  */
 std::string DollSerialize(const std::array<int, 15> &list);
+std::string DollSerialize(const std::array<int, 15> &list, bool packed);
 
 /**
  * Convert a string generated by DollSerialze back to a list of 15 items
@@ -82,6 +93,7 @@ std::array<int, 15> DollUnserialize(const std::string& serialized);
  * Serialize a list of spells in to a text format that can be restored with SpellUnserialize
  */
 std::string SpellSerialize(const std::list<Character_Spell> &list);
+std::string SpellSerialize(const std::list<Character_Spell> &list, bool packed);
 
 /**
  * Convert a string generated by SpellSerialze back to a list of items
@@ -108,6 +120,11 @@ struct Character_Item
 
 	Character_Item() = default;
 	Character_Item(short id, int amount) : id(id), amount(amount) { }
+
+	bool operator ==(const Character_Item& rhs) const
+	{
+		return this->id == rhs.id && this->amount == rhs.amount;
+	}
 };
 
 /**
@@ -120,6 +137,11 @@ struct Character_Spell
 
 	Character_Spell() = default;
 	Character_Spell(short id, unsigned char level) : id(id), level(level) { }
+
+	bool operator ==(const Character_Spell& rhs) const
+	{
+		return this->id == rhs.id && this->level == rhs.level;
+	}
 };
 
 /**
@@ -145,6 +167,43 @@ struct Character_Achievements
     std::string name;
 
     Character_Achievements() : name("") {}
+
+    bool operator ==(const Character_Achievements& rhs) const
+    {
+        return this->name == rhs.name;
+    }
+};
+
+/**
+ * Column values of a Character as they were last written to the database
+ */
+struct Character_SaveState
+{
+	// Every scalar column except usage
+	Database_Params stats;
+
+	int usage;
+
+	std::list<Character_Item> inventory;
+	std::list<Character_Item> bank;
+	std::array<int, 15> paperdoll;
+	std::list<Character_Spell> spells;
+	std::string quest;
+	std::list<Character_Achievements> achievements;
+};
+
+/**
+ * Values of a Character as they were last written to the journal
+ */
+struct Character_JournalState
+{
+	int map, x, y, direction;
+	int level, exp, statpoints, skillpoints;
+	int goldbank;
+
+	std::list<Character_Item> inventory;
+	std::list<Character_Item> bank;
+	std::array<int, 15> paperdoll;
 };
 
 class Character : public Command_Source
@@ -373,6 +432,13 @@ class Character : public Command_Source
 		std::set<Character_QuestState> quests_inactive;
 		std::string quest_string;
 
+		// What's known to be in the database, so Save() can skip anything unchanged.
+		// Only replaced once a save is committed, by a callback that may outlive the Character.
+		std::shared_ptr<Character_SaveState> saved;
+
+		// What's currently in the journal, so JournalChanges() only records what moved on since
+		Character_JournalState journaled;
+
 		Character(std::string name, World *);
 
 		bool CanInteractItems() const { return !(nointeract & NoInteractItems); }
@@ -445,8 +511,30 @@ class Character : public Command_Source
 		std::string GetChatLogDump();
 
 		void Send(const PacketBuilder &);
+		void Send(PacketBroadcast &);
 		void Logout();
+
+		/**
+		 * Writes the column groups that changed since the last save, or nothing for an idle character
+		 */
 		void Save();
+
+		/**
+		 * Captures the current column values for comparison by Save()
+		 */
+		Character_SaveState SaveState();
+
+		/**
+		 * Appends a record to the world's journal for everything changed since the last call
+		 * @return true if anything was appended
+		 */
+		bool JournalChanges();
+
+		/**
+		 * Captures the current values for comparison by JournalChanges()
+		 */
+		Character_JournalState JournalState();
+
 		void GiveRebirth(short rebirth);
 		void GiveEXP(int exp);
 		void GiveItem(short item, int amount);
@@ -495,6 +583,8 @@ class Character : public Command_Source
 
 		Party *party;
 		Map *map;
+		int grid_cell; // Maintained by Map, -1 when not indexed
+		std::vector<Character *> in_view; // Other characters within SeeDistance, maintained by Map
 
 		const short &display_str, &display_intl, &display_wis, &display_agi, &display_con, &display_cha;
 };
@@ -58,6 +58,7 @@ namespace Commands
 
                 if (!victim->world->CharacterExists(newname) && Character::ValidName(newname))
                 {
+                    victim->world->WaitForQueued("character:" + victim->SourceName());
                     victim->world->db.Query("UPDATE `pets` SET `owner_name` = '$' WHERE `owner_name` = '$'", newname.c_str(), victim->SourceName().c_str());
                     victim->world->db.Query("UPDATE `characters` SET `name` = '$' WHERE `name` = '$'", newname.c_str(), victim->SourceName().c_str());
 
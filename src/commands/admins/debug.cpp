@@ -47,7 +47,7 @@ namespace Commands
             if (item)
             {
                 item->owner = from->player->id;
-                item->unprotecttime = Timer::GetTime() + double(from->world->config["ProtectPlayerDrop"]);
+                item->unprotecttime = Timer::GetTime() + from->world->hot_config.protect_player_drop;
                 from->DelItem(id, amount);
 
                 PacketBuilder reply(PACKET_ITEM, PACKET_DROP, 15);
@@ -95,7 +95,7 @@ namespace Commands
                     return;
             }
 
-            from->map->npcs.push_back(npc);
+            from->map->AddNPC(npc);
                 npc->Spawn();
         }
     }
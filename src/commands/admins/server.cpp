@@ -1,6 +1,7 @@
 #include "commands.hpp"
 
 #include "../../util.hpp"
+#include "../../character.hpp"
 #include "../../console.hpp"
 #include "../../eoclient.hpp"
 #include "../../eoserver.hpp"
@@ -131,6 +132,96 @@ namespace Commands
         from->ServerMsg("Server started " + util::timeago(from->SourceWorld()->server->start, Timer::GetTime()));
     }
 
+    void DatabaseStats(const std::vector<std::string>& arguments, Command_Source* from)
+    {
+        (void)arguments;
+
+        World* world = from->SourceWorld();
+
+        auto show_stats = [&](const std::string& name, const Database::Commit_Stats& stats)
+        {
+            int avg_ms = stats.commits ? int(stats.total_latency * 1000.0 / stats.commits) : 0;
+
+            from->ServerMsg(name + ": " + util::to_string(stats.commits) + " commits, avg " + util::to_string(avg_ms)
+                + "ms, max " + util::to_string(int(stats.max_latency * 1000.0)) + "ms");
+
+            from->ServerMsg(name + " last commit: " + util::to_string(int(stats.last_writes)) + " writes, "
+                + util::to_string(int(stats.last_bytes)) + " bytes, " + util::to_string(int(stats.last_latency * 1000.0))
+                + "ms (largest " + util::to_string(int(stats.max_writes)) + " writes)");
+        };
+
+        show_stats("Database", world->db.CommitStats());
+
+        if (world->db_worker.Running())
+        {
+            show_stats("Save worker", world->db_worker.Stats());
+            from->ServerMsg("Save worker queue: " + util::to_string(int(world->db_worker.Pending())));
+        }
+    }
+
+    void ColumnBenchmark(const std::vector<std::string>& arguments, Command_Source* from)
+    {
+        // Runs on the main thread, so both the iterations and the sample are kept small enough not to stall the server
+        int iterations = (arguments.size() >= 1) ? util::clamp(util::to_int(arguments[0]), 1, 1000) : 100;
+
+        // A typical inventory and a full bank, the same whoever is online
+        std::vector<std::list<Character_Item>> samples(2);
+
+        for (int i = 1; i <= 30; ++i)
+            samples[0].emplace_back(short(i * 7), (i % 5 == 0) ? i * 1000 : 1);
+
+        for (int i = 1; i <= 200; ++i)
+            samples[1].emplace_back(short(i * 3), (i % 10 == 0) ? i * 100000 : i % 7 + 1);
+
+        auto run = [&](const std::string& name, bool packed)
+        {
+            std::vector<std::string> serialized;
+            std::size_t bytes = 0;
+            std::size_t items = 0;
+
+            double start = Timer::GetTime();
+
+            for (int i = 0; i < iterations; ++i)
+            {
+                serialized.clear();
+
+                UTIL_FOREACH_CREF(samples, sample)
+                {
+                    serialized.push_back(ItemSerialize(sample, packed));
+                }
+            }
+
+            double save_time = Timer::GetTime() - start;
+
+            start = Timer::GetTime();
+
+            for (int i = 0; i < iterations; ++i)
+            {
+                items = 0;
+
+                UTIL_FOREACH_CREF(serialized, column)
+                {
+                    items += ItemUnserialize(column).size();
+                }
+            }
+
+            double load_time = Timer::GetTime() - start;
+
+            UTIL_FOREACH_CREF(serialized, column)
+            {
+                bytes += column.length();
+            }
+
+            double per_column = 1000000.0 / (double(iterations) * serialized.size());
+
+            from->ServerMsg(name + ": " + util::to_string(int(bytes)) + " bytes for " + util::to_string(int(items)) + " items, save "
+                + util::to_string(int(save_time * per_column)) + "us, load " + util::to_string(int(load_time * per_column)) + "us per column");
+        };
+
+        run("Text", false);
+        run("Packed", true);
+    }
+
     void SetConfig(const std::vector<std::string>& arguments, Command_Source* from)
     {
         (void)arguments;
@@ -161,6 +252,8 @@ namespace Commands
         Register({"request", {}, {}, 3}, ReloadQuest);
         Register({"shutdown", {}, {}, 8}, Shutdown);
         Register({"uptime"}, Uptime);
+        Register({"dbstats", {}, {}, 3}, DatabaseStats);
+        Register({"columnbench", {}, {"iterations"}, 3}, ColumnBenchmark);
         Register({"configset", {"name"}, {}, 3}, SetConfig);
     COMMAND_HANDLER_REGISTER_END()
 }
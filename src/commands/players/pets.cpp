@@ -63,6 +63,8 @@ namespace PlayerCommands
         }
         else if (arguments[0] == "list" && from->world->commands_config["PetList"])
         {
+            from->world->WaitForQueued("character:" + from->SourceName());
+
             Database_Result res = from->world->db.Query("SELECT `name`, `npcid`, `level`, `rebirth` FROM `pets` WHERE `owner_name` = '$'", from->SourceName().c_str());
 
             if (!res.empty())
@@ -189,6 +191,7 @@ namespace PlayerCommands
                     if (from->PetNameTaken(from, newname))
                     {
                         from->ServerMsg("Your pet, " + util::ucfirst(from->pet->name) + " had it's name changed to " + util::ucfirst(newname));
+                        from->world->WaitForQueued("character:" + from->SourceName());
                         from->world->db.Query("UPDATE `pets` SET `name` = '$' WHERE `name` = '$' AND `owner_name` = '$'", newname.c_str(), from->pet->name.c_str(), from->SourceName().c_str());
                         from->pet->name = util::lowercase(newname);
                     }
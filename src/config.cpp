@@ -119,3 +119,13 @@ void Config::Read(const std::string& filename)
 
 	std::fclose(fh);
 }
+
+util::variant Config::Get(const std::string& key, const util::variant& def) const
+{
+	const_iterator it = this->find(key);
+
+	if (it == this->end())
+		return def;
+
+	return it->second;
+}
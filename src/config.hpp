@@ -44,6 +44,13 @@ class Config : public std::unordered_map<std::string, util::variant>
 		 * @param filename File to read from.
 		 */
 		void Read(const std::string& filename);
+
+		/**
+		 * Looks up a value without inserting an empty one if it's missing.
+		 * @param key Key to look up.
+		 * @param def Value returned if the key does not exist.
+		 */
+		util::variant Get(const std::string& key, const util::variant& def = util::variant()) const;
 };
 
 #endif
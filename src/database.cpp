@@ -4,6 +4,8 @@
 #include <cstring>
 #include <list>
 
+#include <pthread.h>
+
 #include "console.hpp"
 #include "util.hpp"
 
@@ -30,36 +32,354 @@ struct Database::impl_
 
 static int sqlite_callback(void *data, int num, char *fields[], char *columns[])
 {
-	std::unordered_map<std::string, util::variant> result;
-	std::string column;
-	util::variant field;
-	int i;
+	Database_Result &result = static_cast<Database *>(data)->callbackdata;
+
+	if (result.Columns().empty())
+	{
+		std::vector<std::string> names(num);
+
+		for (int i = 0; i < num; ++i)
+		{
+			if (columns[i] != NULL)
+				names[i] = columns[i];
+		}
+
+		result.SetColumns(std::move(names));
+	}
+
+	Database_Value *values = result.AddRow();
+
+	for (int i = 0; i < num && i < int(result.Columns().size()); ++i)
+	{
+		values[i] = Database_Value(std::string(fields[i] ? fields[i] : ""));
+	}
+
+	return 0;
+}
+
+struct Database::Statement
+{
+	Database::Engine engine;
+
+	union
+	{
+		void *handle;
+#ifdef DATABASE_MYSQL
+		MYSQL_STMT *mysql_stmt;
+#endif // DATABASE_MYSQL
+#ifdef DATABASE_SQLITE
+		sqlite3_stmt *sqlite_stmt;
+#endif // DATABASE_SQLITE
+	};
+
+	explicit Statement(Database::Engine engine)
+		: engine(engine)
+		, handle(0)
+	{ }
+
+	~Statement()
+	{
+		switch (this->engine)
+		{
+#ifdef DATABASE_MYSQL
+			case Database::MySQL:
+				if (this->mysql_stmt)
+					mysql_stmt_close(this->mysql_stmt);
+				break;
+#endif // DATABASE_MYSQL
+
+#ifdef DATABASE_SQLITE
+			case Database::SQLite:
+				if (this->sqlite_stmt)
+					sqlite3_finalize(this->sqlite_stmt);
+				break;
+#endif // DATABASE_SQLITE
+		}
+	}
+};
+
+#ifdef DATABASE_MYSQL
+static int mysql_run_statement(MYSQL_STMT *stmt, const Database_Params &params, Database_Result &result)
+{
+	std::size_t num_params = params.params.size();
+	std::vector<MYSQL_BIND> param_binds(num_params);
+	std::vector<unsigned long> param_lengths(num_params);
 
-	for (i = 0; i < num; ++i)
+	if (mysql_stmt_param_count(stmt) != num_params)
+		return -1;
+
+	for (std::size_t i = 0; i < num_params; ++i)
 	{
-		if (columns[i] == NULL)
+		const Database_Params::Param &param = params.params[i];
+		MYSQL_BIND &bind = param_binds[i];
+
+		std::memset(&bind, 0, sizeof(MYSQL_BIND));
+
+		if (param.text)
 		{
-			column = "";
+			param_lengths[i] = param.string.length();
+			bind.buffer_type = MYSQL_TYPE_STRING;
+			bind.buffer = const_cast<char *>(param.string.data());
+			bind.buffer_length = param_lengths[i];
+			bind.length = &param_lengths[i];
 		}
 		else
 		{
-			column = columns[i];
+			bind.buffer_type = MYSQL_TYPE_LONG;
+			bind.buffer = const_cast<int *>(&param.number);
 		}
+	}
+
+	if ((num_params > 0 && mysql_stmt_bind_param(stmt, param_binds.data()) != 0) || mysql_stmt_execute(stmt) != 0)
+		return mysql_stmt_errno(stmt);
+
+	MYSQL_RES *meta = mysql_stmt_result_metadata(stmt);
 
-		if (fields[i] == NULL)
+	if (!meta)
+		return 0;
+
+	// Lets string columns be fetched in to buffers of exactly the right size
+	decltype(MYSQL_BIND::is_null_value) update_max_length = 1;
+	mysql_stmt_attr_set(stmt, STMT_ATTR_UPDATE_MAX_LENGTH, &update_max_length);
+
+	int err = 0;
+
+	if (mysql_stmt_store_result(stmt) != 0)
+	{
+		err = mysql_stmt_errno(stmt);
+		mysql_free_result(meta);
+		return err;
+	}
+
+	unsigned int num_fields = mysql_num_fields(meta);
+	MYSQL_FIELD *fields = mysql_fetch_fields(meta);
+
+	std::vector<MYSQL_BIND> binds(num_fields);
+	std::vector<long long> numbers(num_fields);
+	std::vector<std::vector<char>> strings(num_fields);
+	std::vector<unsigned long> lengths(num_fields);
+
+	for (unsigned int i = 0; i < num_fields; ++i)
+	{
+		MYSQL_BIND &bind = binds[i];
+
+		std::memset(&bind, 0, sizeof(MYSQL_BIND));
+
+		if (IS_NUM(fields[i].type))
 		{
-			field = "";
+			bind.buffer_type = MYSQL_TYPE_LONGLONG;
+			bind.buffer = &numbers[i];
 		}
 		else
 		{
-			field = fields[i];
+			strings[i].resize(fields[i].max_length + 1);
+			bind.buffer_type = MYSQL_TYPE_STRING;
+			bind.buffer = strings[i].data();
+			bind.buffer_length = strings[i].size();
 		}
 
-		result.insert(result.begin(), make_pair(column, field));
+		bind.length = &lengths[i];
+		bind.is_null = &bind.is_null_value;
 	}
 
-	static_cast<Database *>(data)->callbackdata.push_back(result);
-	return 0;
+	if (mysql_stmt_bind_result(stmt, binds.data()) != 0)
+	{
+		err = mysql_stmt_errno(stmt);
+	}
+	else
+	{
+		int status;
+
+		std::vector<std::string> columns(num_fields);
+
+		for (unsigned int i = 0; i < num_fields; ++i)
+		{
+			columns[i] = fields[i].name;
+		}
+
+		result.SetColumns(std::move(columns));
+
+		while ((status = mysql_stmt_fetch(stmt)) == 0 || status == MYSQL_DATA_TRUNCATED)
+		{
+			Database_Value *values = result.AddRow();
+
+			for (unsigned int i = 0; i < num_fields; ++i)
+			{
+				if (IS_NUM(fields[i].type))
+					values[i] = Database_Value(binds[i].is_null_value ? 0 : int(numbers[i]));
+				else
+					values[i] = Database_Value(binds[i].is_null_value ? std::string() : std::string(strings[i].data(), lengths[i]));
+			}
+		}
+
+		if (status == 1)
+			err = mysql_stmt_errno(stmt);
+	}
+
+	mysql_free_result(meta);
+	mysql_stmt_free_result(stmt);
+
+	return err;
+}
+#endif // DATABASE_MYSQL
+
+#ifdef DATABASE_SQLITE
+static int sqlite_run_statement(sqlite3_stmt *stmt, const Database_Params &params, Database_Result &result)
+{
+	int rc = SQLITE_OK;
+
+	if (sqlite3_bind_parameter_count(stmt) != int(params.params.size()))
+		return -1;
+
+	for (std::size_t i = 0; i < params.params.size() && rc == SQLITE_OK; ++i)
+	{
+		const Database_Params::Param &param = params.params[i];
+
+		if (param.text)
+			rc = sqlite3_bind_text(stmt, i + 1, param.string.data(), param.string.length(), SQLITE_TRANSIENT);
+		else
+			rc = sqlite3_bind_int(stmt, i + 1, param.number);
+	}
+
+	if (rc != SQLITE_OK)
+		return rc;
+
+	int num_columns = sqlite3_column_count(stmt);
+	std::vector<std::string> columns(num_columns);
+
+	for (int i = 0; i < num_columns; ++i)
+	{
+		const char *column = sqlite3_column_name(stmt, i);
+
+		if (column)
+			columns[i] = column;
+	}
+
+	result.SetColumns(std::move(columns));
+
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+	{
+		Database_Value *values = result.AddRow();
+
+		for (int i = 0; i < num_columns; ++i)
+		{
+			switch (sqlite3_column_type(stmt, i))
+			{
+				case SQLITE_INTEGER:
+					values[i] = Database_Value(sqlite3_column_int(stmt, i));
+					break;
+
+				case SQLITE_NULL:
+					values[i] = Database_Value(std::string());
+					break;
+
+				default:
+					values[i] = Database_Value(std::string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, i)), sqlite3_column_bytes(stmt, i)));
+			}
+		}
+	}
+
+	return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+}
+#endif // DATABASE_SQLITE
+
+Database_Params &Database_Params::Add(int number)
+{
+	Param param;
+	param.text = false;
+	param.number = number;
+	this->params.push_back(std::move(param));
+	return *this;
+}
+
+Database_Params &Database_Params::Add(const std::string &string)
+{
+	Param param;
+	param.text = true;
+	param.number = 0;
+	param.string = string;
+	this->params.push_back(std::move(param));
+	return *this;
+}
+
+Database_Params &Database_Params::Add(const char *string)
+{
+	return this->Add(std::string(string));
+}
+
+Database_Params &Database_Params::Add(const Database_Params &other)
+{
+	this->params.insert(this->params.end(), UTIL_CRANGE(other.params));
+	return *this;
+}
+
+int Database_Value::GetInt() const
+{
+	return this->is_number ? this->number : util::to_int(this->text);
+}
+
+double Database_Value::GetFloat() const
+{
+	return this->is_number ? double(this->number) : util::to_float(this->text);
+}
+
+std::string Database_Value::GetString() const
+{
+	return this->is_number ? util::to_string(this->number) : this->text;
+}
+
+bool Database_Value::GetBool() const
+{
+	return this->is_number ? (this->number != 0) : util::variant(this->text).GetBool();
+}
+
+int Database_Row::Index(const std::string &column) const
+{
+	auto it = this->data->index.find(column);
+
+	if (it == this->data->index.end())
+		return -1;
+
+	return int(it->second);
+}
+
+const Database_Value &Database_Row::operator [](const std::string &column) const
+{
+	static const Database_Value empty;
+
+	int i = this->Index(column);
+
+	return (i == -1) ? empty : this->At(i);
+}
+
+void Database_Result::SetColumns(std::vector<std::string> columns)
+{
+	this->data->columns = std::move(columns);
+	this->data->index.clear();
+
+	for (std::size_t i = 0; i < this->data->columns.size(); ++i)
+	{
+		this->data->index.emplace(this->data->columns[i], i);
+	}
+}
+
+Database_Value *Database_Result::AddRow()
+{
+	std::size_t offset = this->data->values.size();
+
+	this->data->values.resize(offset + this->data->columns.size());
+	this->rows.emplace_back(this->data, offset);
+
+	return this->data->values.data() + offset;
+}
+
+void Database_Result::clear()
+{
+	// Rows copied out of the result keep the old storage alive
+	this->data = std::make_shared<Database_Result_Data>();
+	this->rows.clear();
+	this->affected_rows = 0;
+	this->error = false;
 }
 
 int Database_Result::AffectedRows()
@@ -91,10 +411,12 @@ void Database::Bulk_Query_Context::RawQuery(const std::string& query)
 
 void Database::Bulk_Query_Context::Commit()
 {
+	// A failed commit closes the transaction itself
 	if (pending)
+	{
+		pending = false;
 		db.Commit();
-
-	pending = false;
+	}
 }
 
 void Database::Bulk_Query_Context::Rollback()
@@ -116,9 +438,23 @@ Database::Database()
 	, connected(false)
 	, engine(Engine(0))
 	, in_transaction(false)
+	, transaction_writes(0)
+	, transaction_bytes(0)
+	, group_transaction(false)
+	, group_max_writes(0)
+	, group_max_bytes(0)
+	, group_max_age(0.0)
 { }
 
 Database::Database(Database::Engine type, const std::string& host, unsigned short port, const std::string& user, const std::string& pass, const std::string& db, bool connectnow)
+	: impl(new impl_)
+	, in_transaction(false)
+	, transaction_writes(0)
+	, transaction_bytes(0)
+	, group_transaction(false)
+	, group_max_writes(0)
+	, group_max_bytes(0)
+	, group_max_age(0.0)
 {
 	this->connected = false;
 
@@ -236,6 +572,7 @@ void Database::Close()
 	}
 
 	this->connected = false;
+	this->ClearStatements();
 
 	switch (this->engine)
 	{
@@ -377,14 +714,6 @@ Database_Result Database::RawQuery(const char* query, bool tx_control)
 				}
 			}
 
-			if (this->in_transaction && !tx_control)
-			{
-				using namespace std;
-
-				if (strncmp(query, "SELECT", 6) != 0)
-					this->transaction_log.emplace_back(std::string(query));
-			}
-
 			num_fields = mysql_field_count(this->impl->mysql_handle);
 
 			if ((mresult = mysql_store_result(this->impl->mysql_handle)) == 0)
@@ -392,7 +721,7 @@ Database_Result Database::RawQuery(const char* query, bool tx_control)
 				if (num_fields == 0)
 				{
 					result.affected_rows = mysql_affected_rows(this->impl->mysql_handle);
-					return result;
+					break;
 				}
 				else
 				{
@@ -410,39 +739,30 @@ Database_Result Database::RawQuery(const char* query, bool tx_control)
 				}
 			}
 
-			result.resize(mysql_num_rows(mresult));
-			int i = 0;
+			std::vector<std::string> columns(num_fields);
+
+			for (int i = 0; i < num_fields; ++i)
+			{
+				columns[i] = fields[i].name;
+			}
+
+			result.SetColumns(std::move(columns));
+
 			for (MYSQL_ROW row = mysql_fetch_row(mresult); row != 0; row = mysql_fetch_row(mresult))
 			{
-				std::unordered_map<std::string, util::variant> resrow;
+				Database_Value *values = result.AddRow();
+
 				for (int ii = 0; ii < num_fields; ++ii)
 				{
-					util::variant rescell;
 					if (IS_NUM(fields[ii].type))
 					{
-						if (row[ii])
-						{
-							rescell = util::to_int(row[ii]);
-						}
-						else
-						{
-							rescell = 0;
-						}
+						values[ii] = Database_Value(row[ii] ? util::to_int(row[ii]) : 0);
 					}
 					else
 					{
-						if (row[ii])
-						{
-							rescell = row[ii];
-						}
-						else
-						{
-							rescell = "";
-						}
+						values[ii] = Database_Value(std::string(row[ii] ? row[ii] : ""));
 					}
-					resrow[fields[ii].name] = rescell;
 				}
-				result[i++] = resrow;
 			}
 
 			mysql_free_result(mresult);
@@ -465,6 +785,9 @@ Database_Result Database::RawQuery(const char* query, bool tx_control)
 			throw Database_QueryFailed("Unknown database engine");
 	}
 
+	if (this->in_transaction && !tx_control && std::strncmp(query, "SELECT", 6) != 0)
+		this->TransactionWrite(std::string(query, query_length));
+
 	return result;
 }
 
@@ -477,7 +800,24 @@ Database_Result Database::Query(const char *format, ...)
 
 	std::va_list ap;
 	va_start(ap, format);
+	std::string finalquery = this->VFormat(format, ap);
+	va_end(ap);
+
+	return this->RawQuery(finalquery.c_str());
+}
+
+std::string Database::Format(const char *format, ...)
+{
+	std::va_list ap;
+	va_start(ap, format);
+	std::string finalquery = this->VFormat(format, ap);
+	va_end(ap);
+
+	return finalquery;
+}
 
+std::string Database::VFormat(const char *format, std::va_list ap)
+{
 	std::string finalquery;
 	int tempi;
 	char *tempc;
@@ -526,12 +866,10 @@ Database_Result Database::Query(const char *format, ...)
 		}
 	}
 
-	va_end(ap);
-
-	return this->RawQuery(finalquery.c_str());
+	return finalquery;
 }
 
-std::string Database::Escape(const std::string& raw)
+std::string Database::EscapeRaw(const std::string& raw)
 {
 	char *escret;
 	unsigned long esclen;
@@ -557,6 +895,13 @@ std::string Database::Escape(const std::string& raw)
 #endif // DATABASE_SQLITE
 	}
 
+	return result;
+}
+
+std::string Database::Escape(const std::string& raw)
+{
+	std::string result = this->EscapeRaw(raw);
+
 	for (std::string::iterator it = result.begin(); it != result.end(); ++it)
 	{
 		if (*it == '@' || *it == '#' || *it == '$')
@@ -568,6 +913,166 @@ std::string Database::Escape(const std::string& raw)
 	return result;
 }
 
+Database::Statement *Database::Prepare(const std::string &sql, int &error_code)
+{
+	auto it = this->statements.find(sql);
+
+	if (it != this->statements.end())
+		return it->second.get();
+
+	std::unique_ptr<Statement> statement(new Statement(this->engine));
+	error_code = 0;
+
+	switch (this->engine)
+	{
+#ifdef DATABASE_MYSQL
+		case MySQL:
+			if ((statement->mysql_stmt = mysql_stmt_init(this->impl->mysql_handle)) == 0)
+			{
+				error_code = mysql_errno(this->impl->mysql_handle);
+				this->statement_error = mysql_error(this->impl->mysql_handle);
+			}
+			else if (mysql_stmt_prepare(statement->mysql_stmt, sql.c_str(), sql.length()) != 0)
+			{
+				error_code = mysql_stmt_errno(statement->mysql_stmt);
+				this->statement_error = mysql_stmt_error(statement->mysql_stmt);
+			}
+			break;
+#endif // DATABASE_MYSQL
+
+#ifdef DATABASE_SQLITE
+		case SQLite:
+			error_code = sqlite3_prepare_v2(this->impl->sqlite_handle, sql.c_str(), sql.length() + 1, &statement->sqlite_stmt, 0);
+
+			if (error_code != SQLITE_OK)
+				this->statement_error = sqlite3_errmsg(this->impl->sqlite_handle);
+			break;
+#endif // DATABASE_SQLITE
+	}
+
+	if (error_code != 0)
+		return 0;
+
+	return (this->statements[sql] = std::move(statement)).get();
+}
+
+void Database::ClearStatements()
+{
+	this->statements.clear();
+}
+
+Database_Result Database::Execute(const std::string &sql, const Database_Params &params)
+{
+	if (!this->connected)
+	{
+		throw Database_QueryFailed("Not connected to database.");
+	}
+
+#ifdef DATABASE_DEBUG
+	Console::Dbg("%s", this->Render(sql, params).c_str());
+#endif // DATABASE_DEBUG
+
+	Database_Result result;
+	int error_code = 0;
+
+	switch (this->engine)
+	{
+#ifdef DATABASE_MYSQL
+		case MySQL:
+			for (int attempt = 1; ; ++attempt)
+			{
+				Statement *statement = this->Prepare(sql, error_code);
+
+				if (statement)
+				{
+					result.clear();
+					error_code = mysql_run_statement(statement->mysql_stmt, params, result);
+
+					if (error_code == -1)
+						this->statement_error = "Wrong number of parameters for statement.";
+					else if (error_code != 0)
+						this->statement_error = mysql_stmt_error(statement->mysql_stmt);
+					else
+						result.affected_rows = mysql_stmt_affected_rows(statement->mysql_stmt);
+				}
+
+				if ((error_code == CR_SERVER_GONE_ERROR || error_code == CR_SERVER_LOST) && attempt == 1)
+				{
+					// RawQuery reconnects and replays any open transaction, which also frees the dead statements
+					this->RawQuery("SELECT 1", true);
+					continue;
+				}
+
+				break;
+			}
+
+			if (error_code != 0)
+				throw Database_QueryFailed(this->statement_error.c_str());
+
+			break;
+#endif // DATABASE_MYSQL
+
+#ifdef DATABASE_SQLITE
+		case SQLite:
+		{
+			Statement *statement = this->Prepare(sql, error_code);
+
+			if (statement)
+			{
+				error_code = sqlite_run_statement(statement->sqlite_stmt, params, result);
+
+				if (error_code == -1)
+					this->statement_error = "Wrong number of parameters for statement.";
+				else if (error_code != SQLITE_OK)
+					this->statement_error = sqlite3_errmsg(this->impl->sqlite_handle);
+				else if (sqlite3_column_count(statement->sqlite_stmt) == 0)
+					result.affected_rows = sqlite3_changes(this->impl->sqlite_handle);
+
+				sqlite3_reset(statement->sqlite_stmt);
+				sqlite3_clear_bindings(statement->sqlite_stmt);
+			}
+
+			if (error_code != SQLITE_OK)
+				throw Database_QueryFailed(this->statement_error.c_str());
+		}
+		break;
+#endif // DATABASE_SQLITE
+
+		default:
+			throw Database_QueryFailed("Unknown database engine");
+	}
+
+	if (this->in_transaction && sql.compare(0, 6, "SELECT") != 0)
+		this->TransactionWrite(this->Render(sql, params));
+
+	return result;
+}
+
+std::string Database::Render(const std::string &sql, const Database_Params &params)
+{
+	std::string rendered;
+	std::size_t next = 0;
+
+	UTIL_FOREACH(sql, c)
+	{
+		if (c == '?' && next < params.params.size())
+		{
+			const Database_Params::Param &param = params.params[next++];
+
+			if (param.text)
+				rendered += "'" + this->EscapeRaw(param.string) + "'";
+			else
+				rendered += util::to_string(param.number);
+		}
+		else
+		{
+			rendered += c;
+		}
+	}
+
+	return rendered;
+}
+
 void Database::ExecuteFile(const std::string& filename)
 {
 	std::list<std::string> queries;
@@ -616,12 +1121,54 @@ void Database::ExecuteFile(const std::string& filename)
 	this->ExecuteQueries(UTIL_RANGE(queries));
 }
 
+bool Database::Connected() const
+{
+	return this->connected;
+}
+
 bool Database::Pending() const
 {
 	return this->in_transaction;
 }
 
-bool Database::BeginTransaction()
+void Database::TransactionWrite(std::string query)
+{
+	++this->transaction_writes;
+	this->transaction_bytes += query.length();
+
+	if (this->engine == MySQL)
+		this->transaction_log.emplace_back(std::move(query));
+
+	if (this->GroupCommitDue())
+	{
+		this->Commit();
+		this->BeginTransaction(true);
+	}
+}
+
+bool Database::GroupCommitDue() const
+{
+	if (!this->in_transaction || !this->group_transaction)
+		return false;
+
+	if (this->group_max_writes > 0 && this->transaction_writes >= this->group_max_writes)
+		return true;
+
+	if (this->group_max_bytes > 0 && this->transaction_bytes >= this->group_max_bytes)
+		return true;
+
+	if (this->group_max_age > 0.0)
+	{
+		std::chrono::duration<double> age = std::chrono::steady_clock::now() - this->transaction_start;
+
+		if (age.count() >= this->group_max_age)
+			return true;
+	}
+
+	return false;
+}
+
+bool Database::BeginTransaction(bool group)
 {
 	if (this->in_transaction)
 		return false;
@@ -664,6 +1211,10 @@ bool Database::BeginTransaction()
 	}
 
 	this->in_transaction = true;
+	this->group_transaction = group;
+	this->transaction_writes = 0;
+	this->transaction_bytes = 0;
+	this->transaction_start = std::chrono::steady_clock::now();
 
 	return true;
 }
@@ -673,7 +1224,34 @@ void Database::Commit()
 	if (!this->in_transaction)
 		throw Database_Exception("No transaction to commit");
 
-	this->RawQuery("COMMIT", true);
+	if (this->commit_hook)
+		this->commit_hook();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	try
+	{
+		this->RawQuery("COMMIT", true);
+	}
+	catch (Database_Exception &e)
+	{
+		// Left open, every later write would join a transaction that can never commit
+		this->commit_error = e.error();
+		this->Rollback();
+		throw Database_CommitFailed(this->commit_error.c_str());
+	}
+
+	std::chrono::duration<double> latency = std::chrono::steady_clock::now() - start;
+
+	Commit_Stats &stats = this->commit_stats;
+	++stats.commits;
+	stats.last_writes = this->transaction_writes;
+	stats.last_bytes = this->transaction_bytes;
+	stats.max_writes = std::max(stats.max_writes, this->transaction_writes);
+	stats.last_latency = latency.count();
+	stats.max_latency = std::max(stats.max_latency, stats.last_latency);
+	stats.total_latency += stats.last_latency;
+
 	this->in_transaction = false;
 	this->transaction_log.clear();
 }
@@ -683,12 +1261,398 @@ void Database::Rollback()
 	if (!this->in_transaction)
 		throw Database_Exception("No transaction to rollback");
 
-	this->RawQuery("ROLLBACK", true);
 	this->in_transaction = false;
 	this->transaction_log.clear();
+
+	try
+	{
+		this->RawQuery("ROLLBACK", true);
+	}
+	catch (Database_Exception &)
+	{
+		// The server discards the transaction anyway if the connection was lost
+	}
+}
+
+void Database::SetGroupCommit(std::size_t max_writes, std::size_t max_bytes, double max_age)
+{
+	this->group_max_writes = max_writes;
+	this->group_max_bytes = max_bytes;
+	this->group_max_age = max_age;
+}
+
+void Database::SetCommitHook(std::function<void()> hook)
+{
+	this->commit_hook = std::move(hook);
+}
+
+void Database::CommitDue()
+{
+	if (!this->GroupCommitDue())
+		return;
+
+	// Nothing to write, just restart the clock
+	if (this->transaction_writes == 0)
+	{
+		this->transaction_start = std::chrono::steady_clock::now();
+		return;
+	}
+
+	this->Commit();
+	this->BeginTransaction(true);
+}
+
+const Database::Commit_Stats &Database::CommitStats() const
+{
+	return this->commit_stats;
 }
 
 Database::~Database()
 {
 	this->Close();
 }
+
+struct Database_Worker::impl_
+{
+	pthread_t thread;
+	pthread_mutex_t mutex;
+
+	// Signalled when queries are queued or the worker is asked to stop
+	pthread_cond_t wake;
+
+	// Signalled after every batch, for Wait() and Wait(key)
+	pthread_cond_t idle;
+};
+
+Database_Worker::Database_Worker()
+	: impl(new impl_)
+	, running(false)
+	, stopping(false)
+	, busy(false)
+	, group_max_writes(0)
+	, group_max_bytes(0)
+	, group_max_age(0.0)
+	, failures(0)
+{
+	if (pthread_mutex_init(&this->impl->mutex, 0) != 0
+	 || pthread_cond_init(&this->impl->wake, 0) != 0
+	 || pthread_cond_init(&this->impl->idle, 0) != 0)
+		throw std::runtime_error("Failed to initialize database worker");
+}
+
+void Database_Worker::Start(Database::Engine type, const std::string& host, unsigned short port, const std::string& user, const std::string& pass, const std::string& db)
+{
+	if (this->running)
+		return;
+
+	this->db.Connect(type, host, port, user, pass, db);
+	this->stopping = false;
+
+	if (pthread_create(&this->impl->thread, 0, Database_Worker::Run, this) != 0)
+	{
+		this->db.Close();
+		throw std::runtime_error("Failed to create database worker thread");
+	}
+
+	this->running = true;
+}
+
+bool Database_Worker::Running() const
+{
+	return this->running;
+}
+
+void *Database_Worker::Run(void *void_worker)
+{
+	static_cast<Database_Worker *>(void_worker)->Loop();
+	return 0;
+}
+
+void Database_Worker::Loop()
+{
+	std::deque<Job> batch;
+
+	pthread_mutex_lock(&this->impl->mutex);
+
+	while (true)
+	{
+		while (this->queued.empty() && !this->stopping)
+			pthread_cond_wait(&this->impl->wake, &this->impl->mutex);
+
+		if (this->queued.empty())
+			break;
+
+		batch.swap(this->queued);
+		this->busy = true;
+		this->db.SetGroupCommit(this->group_max_writes, this->group_max_bytes, this->group_max_age);
+
+		pthread_mutex_unlock(&this->impl->mutex);
+
+		// Reconnects and retries happen here, away from the thread that queued the queries
+		if (batch.size() > 1)
+			this->db.BeginTransaction(true);
+
+		std::size_t failed = 0;
+		bool commit_failed = false;
+
+		UTIL_FOREACH_REF(batch, job)
+		{
+			if (job.wait)
+				job.wait();
+
+			if (!job.prepared && job.query.empty())
+				continue;
+
+			try
+			{
+				if (job.prepared)
+					job.result = this->db.Execute(job.query, job.params);
+				else
+					job.result = this->db.RawQuery(job.query.c_str());
+			}
+			catch (Database_CommitFailed &e)
+			{
+				// A group commit part way through lost the writes before it, so the batch is given up whole
+				Console::Err("Failed to commit queued queries: %s", e.error());
+				commit_failed = true;
+				break;
+			}
+			catch (Database_Exception &e)
+			{
+				Console::Err("Queued query failed: %s", e.error());
+				job.result.error = true;
+				++failed;
+			}
+		}
+
+		if (!commit_failed && this->db.Pending())
+		{
+			try
+			{
+				this->db.Commit();
+			}
+			catch (Database_CommitFailed &e)
+			{
+				Console::Err("Failed to commit queued queries: %s", e.error());
+				commit_failed = true;
+			}
+		}
+
+		if (commit_failed)
+		{
+			// Callbacks mustn't take the queries for written
+			failed = 0;
+
+			UTIL_FOREACH_REF(batch, job)
+			{
+				job.result.error = true;
+
+				if (job.prepared || !job.query.empty())
+					++failed;
+			}
+		}
+
+		pthread_mutex_lock(&this->impl->mutex);
+
+		UTIL_FOREACH_REF(batch, job)
+		{
+			UTIL_FOREACH_CREF(job.keys, key)
+			{
+				auto it = this->pending_keys.find(key);
+
+				if (it != this->pending_keys.end() && --it->second == 0)
+					this->pending_keys.erase(it);
+			}
+
+			if (job.callback)
+				this->completed.push_back(std::move(job));
+		}
+
+		batch.clear();
+		this->busy = false;
+		this->stats = this->db.CommitStats();
+		this->failures += failed;
+
+		// Wait(key) may be waiting on this batch alone
+		pthread_cond_broadcast(&this->impl->idle);
+	}
+
+	pthread_mutex_unlock(&this->impl->mutex);
+}
+
+void Database_Worker::Push(Job &&job)
+{
+	UTIL_FOREACH_CREF(job.keys, key)
+	{
+		++this->pending_keys[key];
+	}
+
+	this->queued.push_back(std::move(job));
+	pthread_cond_signal(&this->impl->wake);
+}
+
+void Database_Worker::Queue(const std::string& query, Callback callback, std::vector<std::string> keys)
+{
+	if (!this->running)
+		throw Database_QueryFailed("Database worker is not running.");
+
+	Job job;
+	job.query = query;
+	job.prepared = false;
+	job.callback = callback;
+	job.keys = std::move(keys);
+
+	pthread_mutex_lock(&this->impl->mutex);
+	this->Push(std::move(job));
+	pthread_mutex_unlock(&this->impl->mutex);
+}
+
+void Database_Worker::Queue(const std::string& sql, const Database_Params &params, Callback callback, std::vector<std::string> keys)
+{
+	if (!this->running)
+		throw Database_QueryFailed("Database worker is not running.");
+
+	Job job;
+	job.query = sql;
+	job.prepared = true;
+	job.params = params;
+	job.callback = callback;
+	job.keys = std::move(keys);
+
+	pthread_mutex_lock(&this->impl->mutex);
+	this->Push(std::move(job));
+	pthread_mutex_unlock(&this->impl->mutex);
+}
+
+void Database_Worker::QueueCallback(Callback callback)
+{
+	if (!this->running)
+		throw Database_QueryFailed("Database worker is not running.");
+
+	Job job;
+	job.prepared = false;
+	job.callback = callback;
+
+	pthread_mutex_lock(&this->impl->mutex);
+	this->Push(std::move(job));
+	pthread_mutex_unlock(&this->impl->mutex);
+}
+
+void Database_Worker::QueueWait(std::function<void()> wait)
+{
+	if (!this->running)
+		throw Database_QueryFailed("Database worker is not running.");
+
+	Job job;
+	job.prepared = false;
+	job.wait = std::move(wait);
+
+	pthread_mutex_lock(&this->impl->mutex);
+	this->Push(std::move(job));
+	pthread_mutex_unlock(&this->impl->mutex);
+}
+
+std::size_t Database_Worker::Pending()
+{
+	pthread_mutex_lock(&this->impl->mutex);
+	std::size_t pending = this->queued.size() + (this->busy ? 1 : 0);
+	pthread_mutex_unlock(&this->impl->mutex);
+
+	return pending;
+}
+
+void Database_Worker::SetGroupCommit(std::size_t max_writes, std::size_t max_bytes, double max_age)
+{
+	pthread_mutex_lock(&this->impl->mutex);
+	this->group_max_writes = max_writes;
+	this->group_max_bytes = max_bytes;
+	this->group_max_age = max_age;
+	pthread_mutex_unlock(&this->impl->mutex);
+}
+
+Database::Commit_Stats Database_Worker::Stats()
+{
+	pthread_mutex_lock(&this->impl->mutex);
+	Database::Commit_Stats stats = this->stats;
+	pthread_mutex_unlock(&this->impl->mutex);
+
+	return stats;
+}
+
+std::size_t Database_Worker::Failures()
+{
+	pthread_mutex_lock(&this->impl->mutex);
+	std::size_t failures = this->failures;
+	pthread_mutex_unlock(&this->impl->mutex);
+
+	return failures;
+}
+
+void Database_Worker::Wait()
+{
+	if (!this->running)
+		return;
+
+	pthread_mutex_lock(&this->impl->mutex);
+
+	while (!this->queued.empty() || this->busy)
+		pthread_cond_wait(&this->impl->idle, &this->impl->mutex);
+
+	pthread_mutex_unlock(&this->impl->mutex);
+}
+
+void Database_Worker::Wait(const std::string &key)
+{
+	if (!this->running)
+		return;
+
+	pthread_mutex_lock(&this->impl->mutex);
+
+	while (this->pending_keys.find(key) != this->pending_keys.end())
+		pthread_cond_wait(&this->impl->idle, &this->impl->mutex);
+
+	pthread_mutex_unlock(&this->impl->mutex);
+}
+
+void Database_Worker::Poll()
+{
+	if (!this->running)
+		return;
+
+	std::deque<Job> finished;
+
+	pthread_mutex_lock(&this->impl->mutex);
+	finished.swap(this->completed);
+	pthread_mutex_unlock(&this->impl->mutex);
+
+	UTIL_FOREACH_REF(finished, job)
+	{
+		job.callback(job.result);
+	}
+}
+
+void Database_Worker::Stop()
+{
+	if (!this->running)
+		return;
+
+	pthread_mutex_lock(&this->impl->mutex);
+	this->stopping = true;
+	pthread_cond_signal(&this->impl->wake);
+	pthread_mutex_unlock(&this->impl->mutex);
+
+	pthread_join(this->impl->thread, 0);
+
+	this->running = false;
+	this->completed.clear();
+	this->db.Close();
+}
+
+Database_Worker::~Database_Worker()
+{
+	this->Stop();
+
+	pthread_cond_destroy(&this->impl->idle);
+	pthread_cond_destroy(&this->impl->wake);
+	pthread_mutex_destroy(&this->impl->mutex);
+}
@@ -8,6 +8,10 @@
 #endif // DATABASE_MYSQL
 
 #include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <deque>
 #include <exception>
 #include <functional>
 #include <list>
@@ -52,21 +56,136 @@ class Database_QueryFailed : public Database_Exception
 	const char *what() const noexcept { return "Database_QueryFailed"; }
 };
 
+/**
+ * Exception thrown when a transaction failed to commit, everything written since it began is lost
+ */
+class Database_CommitFailed : public Database_Exception
+{
+	public: Database_CommitFailed(const char *e) : Database_Exception(e) {}
+	const char *what() const noexcept { return "Database_CommitFailed"; }
+};
+
+/**
+ * A single field from a Database_Result, kept as the integer or text the driver returned and converted on access
+ */
+class Database_Value
+{
+	protected:
+		std::string text;
+		int number;
+		bool is_number;
+
+	public:
+		Database_Value() : number(0), is_number(false) { }
+		explicit Database_Value(int number) : number(number), is_number(true) { }
+		explicit Database_Value(const std::string &text) : text(text), number(0), is_number(false) { }
+		explicit Database_Value(std::string &&text) : text(std::move(text)), number(0), is_number(false) { }
+
+		bool IsNumber() const { return this->is_number; }
+
+		int GetInt() const;
+		double GetFloat() const;
+		std::string GetString() const;
+		bool GetBool() const;
+
+		operator int() const { return this->GetInt(); }
+		operator double() const { return this->GetFloat(); }
+		operator std::string() const { return this->GetString(); }
+		operator bool() const { return this->GetBool(); }
+};
+
+/**
+ * Column names and the values of every row of a Database_Result, stored row after row in one array
+ */
+struct Database_Result_Data
+{
+	std::vector<std::string> columns;
+	std::unordered_map<std::string, std::size_t> index;
+	std::vector<Database_Value> values;
+};
+
+/**
+ * One row of a Database_Result, sharing the storage of the result it came from
+ */
+class Database_Row
+{
+	protected:
+		std::shared_ptr<const Database_Result_Data> data;
+		std::size_t offset;
+
+	public:
+		Database_Row(const std::shared_ptr<const Database_Result_Data> &data, std::size_t offset)
+			: data(data)
+			, offset(offset)
+		{ }
+
+		std::size_t Columns() const { return this->data->columns.size(); }
+
+		/**
+		 * Returns the column's position in the row, or -1 if there's no such column
+		 */
+		int Index(const std::string &column) const;
+
+		/**
+		 * Returns the value in a column by position
+		 */
+		const Database_Value &At(std::size_t i) const { return this->data->values[this->offset + i]; }
+
+		/**
+		 * Returns the value in a named column, or an empty value if there's no such column
+		 */
+		const Database_Value &operator [](const std::string &column) const;
+};
+
 /**
  * Result from a Database Query containing the SELECTed rows, and/or affected row counts and error information
  */
-class Database_Result : public std::vector<std::unordered_map<std::string, util::variant>>
+class Database_Result
 {
+	public:
+		typedef std::vector<Database_Row>::const_iterator iterator;
+		typedef std::vector<Database_Row>::const_iterator const_iterator;
+
 	protected:
+		std::shared_ptr<Database_Result_Data> data;
+		std::vector<Database_Row> rows;
+
 		int affected_rows;
 		bool error;
 
 	public:
 		Database_Result()
-			: affected_rows(0)
+			: data(std::make_shared<Database_Result_Data>())
+			, affected_rows(0)
 			, error(false)
 		{ }
 
+		/**
+		 * Sets the column names, before any rows are added
+		 */
+		void SetColumns(std::vector<std::string> columns);
+
+		/**
+		 * Appends a row and returns its values to be filled in, one per column
+		 */
+		Database_Value *AddRow();
+
+		/**
+		 * Removes all rows and columns, and resets the affected row count and error state
+		 */
+		void clear();
+
+		const std::vector<std::string> &Columns() const { return this->data->columns; }
+
+		iterator begin() const { return this->rows.begin(); }
+		iterator end() const { return this->rows.end(); }
+
+		std::size_t size() const { return this->rows.size(); }
+		bool empty() const { return this->rows.empty(); }
+
+		const Database_Row &front() const { return this->rows.front(); }
+		const Database_Row &operator [](std::size_t i) const { return this->rows[i]; }
+
 		/**
 		 * Returns the number of affected rows from an UPDATE or INSERT query
 		 */
@@ -78,6 +197,36 @@ class Database_Result : public std::vector<std::unordered_map<std::string, util:
 		bool Error();
 
 	friend class Database;
+	friend class Database_Worker;
+};
+
+/**
+ * Typed values bound in order to the ? placeholders of a prepared statement
+ */
+class Database_Params
+{
+	public:
+		struct Param
+		{
+			bool text;
+			int number;
+			std::string string;
+
+			bool operator ==(const Param &rhs) const
+			{
+				return this->text == rhs.text && this->number == rhs.number && this->string == rhs.string;
+			}
+		};
+
+		std::vector<Param> params;
+
+		Database_Params &Add(int);
+		Database_Params &Add(const std::string &);
+		Database_Params &Add(const char *);
+		Database_Params &Add(const Database_Params &);
+
+		bool operator ==(const Database_Params &rhs) const { return this->params == rhs.params; }
+		bool operator !=(const Database_Params &rhs) const { return !(*this == rhs); }
 };
 
 /**
@@ -92,11 +241,61 @@ class Database
 			SQLite
 		};
 
+		/**
+		 * Timings and sizes of the commits made on a connection
+		 */
+		struct Commit_Stats
+		{
+			int commits;
+
+			// Writes and bytes of SQL in the most recent / largest commit
+			std::size_t last_writes;
+			std::size_t last_bytes;
+			std::size_t max_writes;
+
+			// Seconds spent waiting on COMMIT
+			double last_latency;
+			double max_latency;
+			double total_latency;
+
+			Commit_Stats()
+				: commits(0)
+				, last_writes(0)
+				, last_bytes(0)
+				, max_writes(0)
+				, last_latency(0.0)
+				, max_latency(0.0)
+				, total_latency(0.0)
+			{ }
+		};
+
 	protected:
 		struct impl_;
 
 		std::unique_ptr<impl_> impl;
 
+		struct Statement;
+
+		// Prepared statements keyed by their SQL text, freed when the connection closes
+		std::unordered_map<std::string, std::unique_ptr<Statement>> statements;
+
+		// Copy of the last statement error, as the statement may be freed before it's read
+		std::string statement_error;
+
+		// Copy of the last commit error, as the rollback that follows overwrites the driver's
+		std::string commit_error;
+
+		/**
+		 * Returns a cached statement or prepares a new one, 0 on failure
+		 */
+		Statement *Prepare(const std::string &sql, int &error_code);
+		void ClearStatements();
+
+		/**
+		 * Escapes a string without altering Query replacement tokens
+		 */
+		std::string EscapeRaw(const std::string &raw);
+
 		bool connected;
 		Engine engine;
 
@@ -104,8 +303,27 @@ class Database
 		unsigned int port;
 
 		bool in_transaction;
+
+		// Writes made in the open transaction, replayed after a reconnect (MySQL only)
 		std::list<std::string> transaction_log;
 
+		std::size_t transaction_writes;
+		std::size_t transaction_bytes;
+		std::chrono::steady_clock::time_point transaction_start;
+
+		// A group transaction is committed and reopened once it reaches any of these limits, zero means no limit
+		bool group_transaction;
+		std::size_t group_max_writes;
+		std::size_t group_max_bytes;
+		double group_max_age;
+
+		Commit_Stats commit_stats;
+
+		std::function<void()> commit_hook;
+
+		void TransactionWrite(std::string query);
+		bool GroupCommitDue() const;
+
 	public:
 		struct Bulk_Query_Context
 		{
@@ -158,6 +376,25 @@ class Database
 		 */
 		Database_Result Query(const char *format, ...);
 
+		/**
+		 * Builds a query the same way Query() does without executing it
+		 */
+		std::string Format(const char *format, ...);
+		std::string VFormat(const char *format, std::va_list ap);
+
+		/**
+		 * Executes a statement with ? placeholders, preparing it the first time it's used on this connection.
+		 * The SQL should be a fixed string from the call site so the statement can be reused.
+		 * @throw Database_QueryFailed
+		 * @throw Database_OpenFailed
+		 */
+		Database_Result Execute(const std::string &sql, const Database_Params &params = Database_Params());
+
+		/**
+		 * Substitutes escaped parameter values in to a statement's SQL text
+		 */
+		std::string Render(const std::string &sql, const Database_Params &params);
+
 		/**
 		 * Escapes a piece of text (including Query replacement tokens)
 		 */
@@ -190,11 +427,44 @@ class Database
 		 */
 		void ExecuteFile(const std::string& filename);
 
+		bool Connected() const;
+
 		bool Pending() const;
-		bool BeginTransaction();
+
+		/**
+		 * Starts a transaction. A group transaction may be committed and reopened part way through
+		 * according to the limits set by SetGroupCommit(), bounding the replay log.
+		 */
+		bool BeginTransaction(bool group = false);
+
+		/**
+		 * Commits the open transaction. If that fails the transaction is rolled back and closed.
+		 * @throw Database_CommitFailed
+		 */
 		void Commit();
+
+		/**
+		 * Rolls back the open transaction, which is closed even if the rollback fails
+		 */
 		void Rollback();
 
+		/**
+		 * Sets the write count, byte and age limits of group transactions, zero for no limit
+		 */
+		void SetGroupCommit(std::size_t max_writes, std::size_t max_bytes, double max_age);
+
+		/**
+		 * Sets a function to run before every commit, including group commits made part way through a write
+		 */
+		void SetCommitHook(std::function<void()> hook);
+
+		/**
+		 * Commits and reopens a group transaction that has gone past its age limit
+		 */
+		void CommitDue();
+
+		const Commit_Stats &CommitStats() const;
+
 		/**
 		 * Closes the database connection if one is active
 		 */
@@ -206,4 +476,142 @@ class Database
 		Database_Result callbackdata;
 };
 
+/**
+ * Runs queries in order on a background thread with its own connection to the database,
+ * so a slow or reconnecting database server never holds up the thread queueing them
+ */
+class Database_Worker
+{
+	public:
+		/**
+		 * Called from Poll() with the result of a queued query
+		 */
+		typedef std::function<void(Database_Result &)> Callback;
+
+	protected:
+		struct impl_;
+
+		std::unique_ptr<impl_> impl;
+
+		struct Job
+		{
+			std::string query;
+			bool prepared;
+			Database_Params params;
+			Callback callback;
+			Database_Result result;
+
+			// Run on the worker's thread before the query, see QueueWait()
+			std::function<void()> wait;
+
+			// What the query writes to, see Wait(key)
+			std::vector<std::string> keys;
+		};
+
+		Database db;
+
+		// Both guarded by impl->mutex
+		std::deque<Job> queued;
+		std::deque<Job> completed;
+
+		// Number of queued or running jobs with each key, also guarded by impl->mutex
+		std::unordered_map<std::string, std::size_t> pending_keys;
+
+		/**
+		 * Adds a job to the queue and counts its keys, with impl->mutex held
+		 */
+		void Push(Job &&job);
+
+		bool running;
+		bool stopping;
+		bool busy;
+
+		// Also guarded by impl->mutex
+		std::size_t group_max_writes;
+		std::size_t group_max_bytes;
+		double group_max_age;
+		Database::Commit_Stats stats;
+		std::size_t failures;
+
+		static void *Run(void *);
+		void Loop();
+
+	public:
+		Database_Worker();
+
+		/**
+		 * Opens the worker's connection and starts its thread
+		 * @throw Database_OpenFailed
+		 */
+		void Start(Database::Engine type, const std::string& host, unsigned short port, const std::string& user, const std::string& pass, const std::string& db);
+
+		bool Running() const;
+
+		/**
+		 * Queues a query to be run after every query queued before it.
+		 * Each batch of queries the worker picks up is run inside one transaction.
+		 * @param keys Anything identifying the rows written, for Wait(key)
+		 */
+		void Queue(const std::string& query, Callback callback = Callback(), std::vector<std::string> keys = std::vector<std::string>());
+
+		/**
+		 * Queues a prepared statement, see Database::Execute()
+		 */
+		void Queue(const std::string& sql, const Database_Params &params, Callback callback = Callback(), std::vector<std::string> keys = std::vector<std::string>());
+
+		/**
+		 * Queues a callback with no query, called once everything queued before it has been run and committed
+		 */
+		void QueueCallback(Callback callback);
+
+		/**
+		 * Queues a function to be run on the worker's thread before anything queued after it,
+		 * for holding those queries back until something they depend on has happened
+		 */
+		void QueueWait(std::function<void()> wait);
+
+		/**
+		 * Number of queries queued or being run
+		 */
+		std::size_t Pending();
+
+		/**
+		 * Limits for splitting up large batches, see Database::SetGroupCommit()
+		 */
+		void SetGroupCommit(std::size_t max_writes, std::size_t max_bytes, double max_age);
+
+		/**
+		 * Commit statistics of the worker's connection as of the last finished batch
+		 */
+		Database::Commit_Stats Stats();
+
+		/**
+		 * Number of queued queries and commits that have failed since the worker was created
+		 */
+		std::size_t Failures();
+
+		/**
+		 * Blocks until every queued query has been run
+		 */
+		void Wait();
+
+		/**
+		 * Blocks until every query queued with a key has been run and committed, returning straight away if there are none
+		 */
+		void Wait(const std::string &key);
+
+		/**
+		 * Calls the callbacks of finished queries, should be called regularly by the thread queueing them
+		 */
+		void Poll();
+
+		/**
+		 * Runs the remaining queued queries and stops the thread.
+		 * Callbacks of queries finished after the last Poll() are discarded.
+		 */
+		void Stop();
+
+		~Database_Worker();
+};
+
 #endif // DATABASE_HPP_INCLUDED
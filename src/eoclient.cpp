@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <stdexcept>
 
 #include "character.hpp"
@@ -32,13 +33,13 @@ ActionQueue::~ActionQueue()
 
 void EOClient::Initialize()
 {
-	this->upload_fh = 0;
+	this->upload_pos = 0;
+	this->upload_size = 0;
 	this->seq_start = 0;
 	this->upcoming_seq_start = -1;
 	this->seq = 0;
 	this->id = this->server()->world->GeneratePlayerID();
-	this->length = 0;
-	this->packet_state = EOClient::ReadLen1;
+	this->discard_length = 0;
 	this->state = EOClient::Uninitialized;
 	this->player = 0;
 	this->version = 0;
@@ -48,120 +49,133 @@ void EOClient::Initialize()
 
 bool EOClient::NeedTick()
 {
-	return this->upload_fh;
+	return this->upload_data || !this->inbound.empty();
 }
 
 void EOClient::Tick()
 {
-	std::string data;
-	int done = false;
-	int oldlength;
-
-	if (this->upload_fh)
+	if (this->upload_data)
 	{
-		// Send more of the file instead of doing other tasks
-		std::size_t upload_available = std::min(this->upload_size - this->upload_pos, Client::SendBufferRemaining());
-
-		if (upload_available != 0)
+		if (this->upload_pos < this->upload_size)
 		{
-			upload_available = std::fread(&this->send_buffer[this->send_buffer_ppos + 1], 1, upload_available, this->upload_fh);
-
-			// Dynamically rewrite the bytes of the map to enable PK
-			if (this->upload_type == FILE_MAP && this->server()->world->config["GlobalPK"] && !this->server()->world->PKExcept(player->character->mapid))
+			if (this->Threaded())
 			{
-				if (this->upload_pos <= 0x03 && this->upload_pos + upload_available > 0x03)
-					this->send_buffer[this->send_buffer_ppos + 1 + 0x03 - this->upload_pos] = 0xFF;
+				// The network thread owns the send buffer, so the file is queued in chunks instead
+				if (this->SendQueueSize() < 8)
+				{
+					std::size_t length = std::min<std::size_t>(this->upload_size - this->upload_pos, 8192);
+
+					Client::Send(this->upload_data->substr(this->upload_pos, length));
+					this->upload_pos += length;
+				}
+			}
+			else
+			{
+				// Send more of the file instead of doing other tasks
+				std::size_t length = std::min(this->upload_size - this->upload_pos, Client::SendBufferRemaining());
 
-				if (this->upload_pos <= 0x03 && this->upload_pos + upload_available > 0x04)
-					this->send_buffer[this->send_buffer_ppos + 1 + 0x04 - this->upload_pos] = 0x01;
+				if (length != 0)
+				{
+					Client::Buffer(this->upload_data->data() + this->upload_pos, length);
+					this->upload_pos += length;
 
-				if (this->upload_pos <= 0x1F && this->upload_pos + upload_available > 0x1F)
-					this->send_buffer[this->send_buffer_ppos + 1 + 0x1F - this->upload_pos] = 0x04;
+					this->UpdateEvents();
+				}
 			}
-
-			this->upload_pos += upload_available;
-			this->send_buffer_ppos += upload_available;
-			this->send_buffer_used += upload_available;
 		}
-		else if (this->upload_pos == this->upload_size && this->SendBufferRemaining() == this->send_buffer.length())
+		else if (this->Threaded() || this->send_buffer2_used <= Client::SendBufferRemaining())
 		{
 			using std::swap;
 
-			std::fclose(this->upload_fh);
-			this->upload_fh = 0;
+			this->upload_data.reset();
 			this->upload_pos = 0;
 			this->upload_size = 0;
 
-			// Place our temporary buffer back as the real one
-			swap(this->send_buffer, this->send_buffer2);
-			swap(this->send_buffer_gpos, this->send_buffer2_gpos);
-			swap(this->send_buffer_ppos, this->send_buffer2_ppos);
-			swap(this->send_buffer_used, this->send_buffer2_used);
+			// Release anything that was sent while the file was uploading
+			std::string deferred(this->send_buffer2_used, '\0');
+
+			if (!deferred.empty())
+			{
+				// send_buffer2_gpos points at the byte before the oldest one
+				std::size_t start = (this->send_buffer2_gpos + 1) & (this->send_buffer2.length() - 1);
+				std::size_t first = std::min(deferred.length(), this->send_buffer2.length() - start);
+
+				std::memcpy(&deferred[0], &this->send_buffer2[start], first);
+				std::memcpy(&deferred[first], &this->send_buffer2[0], deferred.length() - first);
+			}
 
-			// We're not using this anymore...
 			std::string empty;
 			swap(this->send_buffer2, empty);
+			this->send_buffer2_used = 0;
+
+			if (!deferred.empty())
+				Client::Send(deferred);
 		}
 	}
 	else
 	{
-		data = this->Recv((this->packet_state == EOClient::ReadData) ? this->length : 1);
+		// Without a network thread the packets have to be split out here
+		if (!this->Threaded())
+			this->Received();
+
+		std::string packet;
+		int limit = this->server()->world->hot_config.packets_per_tick;
+
+		int handled = 0;
 
-		while (data.length() > 0 && !done)
+		// Anything left keeps NeedTick() true, so it's picked up next tick
+		for (; handled < limit && this->inbound.pop(packet); ++handled)
+			this->Execute(packet);
+
+		// The network thread stops splitting packets out while the queue is full
+		if (handled > 0)
+			this->ResumeReceive();
+	}
+}
+
+void EOClient::Received()
+{
+	unsigned char raw_length[2];
+
+	// Pull every complete packet out of the buffer at once, stopping early if the queue is full
+	while (this->inbound.size() < this->inbound.capacity())
+	{
+		if (this->discard_length > 0)
 		{
-			switch (this->packet_state)
-			{
-				case EOClient::ReadLen1:
-					this->raw_length[0] = data[0];
-					data[0] = '\0';
-					data.erase(0, 1);
-					this->packet_state = EOClient::ReadLen2;
-
-					if (data.length() == 0)
-					{
-						break;
-					}
-
-				case EOClient::ReadLen2:
-					this->raw_length[1] = data[0];
-					data[0] = '\0';
-					data.erase(0, 1);
-					this->length = PacketProcessor::Number(this->raw_length[0], this->raw_length[1]);
-					this->packet_state = EOClient::ReadData;
-
-					if (data.length() == 0)
-					{
-						break;
-					}
-
-				case EOClient::ReadData:
-					oldlength = this->data.length();
-					this->data += data.substr(0, this->length);
-					std::fill(data.begin(), data.begin() + std::min<std::size_t>(data.length(), this->length), '\0');
-					data.erase(0, this->length);
-					this->length -= this->data.length() - oldlength;
-
-					if (this->length == 0)
-					{
-						this->Execute(this->data);
-
-						std::fill(UTIL_RANGE(this->data), '\0');
-						this->data.erase();
-						this->packet_state = EOClient::ReadLen1;
-
-						done = true;
-					}
-					break;
-
-				default:
-					// If the code ever gets here, something is broken, so we just reset the client's state.
-					std::fill(UTIL_RANGE(data), '\0');
-					std::fill(UTIL_RANGE(this->data), '\0');
-					data.erase();
-					this->data.erase();
-					this->packet_state = EOClient::ReadLen1;
-			}
+			std::size_t discard = std::min(this->discard_length, this->recv_buffer_used);
+
+			if (discard == 0)
+				break;
+
+			this->Discard(discard);
+			this->discard_length -= discard;
+			continue;
 		}
+
+		if (this->Peek(reinterpret_cast<char *>(raw_length), 2) < 2)
+			break;
+
+		std::size_t length = PacketProcessor::Number(raw_length[0], raw_length[1]);
+
+		// Packets too big for the buffer could never be completed, so they are thrown away
+		if (length + 2 > this->recv_buffer.length())
+		{
+			this->Discard(2);
+			this->discard_length = length;
+			continue;
+		}
+
+		if (this->recv_buffer_used < length + 2)
+			break;
+
+		this->Discard(2);
+
+		std::string packet = this->Recv(length);
+
+		if (packet.length() >= 2)
+			this->inbound.push(this->processor.Decode(packet));
+
+		std::fill(UTIL_RANGE(packet), '\0');
 	}
 }
 
@@ -228,7 +242,7 @@ void EOClient::Execute(const std::string &data)
 	if (!this->Connected())
 		return;
 
-	PacketReader reader(processor.Decode(data));
+	PacketReader reader(data);
 
 	if (reader.Family() == PACKET_INTERNAL)
 	{
@@ -288,44 +302,27 @@ bool EOClient::Upload(FileType type, int id, InitReply init_reply)
 
 bool EOClient::Upload(FileType type, const std::string &filename, InitReply init_reply)
 {
-	using std::swap;
-
-	if (this->upload_fh)
+	if (this->upload_data)
 		throw std::runtime_error("Already uploading file");
 
-	this->upload_fh = std::fopen(filename.c_str(), "rb");
+	// Maps are sent with PK enabled in their header when GlobalPK is on
+	bool pk = type == FILE_MAP && this->player && this->player->character
+	 && this->server()->world->config["GlobalPK"] && !this->server()->world->PKExcept(this->player->character->mapid);
 
-	if (!this->upload_fh)
-		return false;
+	this->upload_data = this->server()->upload_cache.Get(filename, pk);
 
-	if (std::fseek(this->upload_fh, 0, SEEK_END) != 0)
-	{
-		std::fclose(this->upload_fh);
+	if (!this->upload_data)
 		return false;
-	}
 
-	this->upload_type = type;
 	this->upload_pos = 0;
-	this->upload_size = std::ftell(this->upload_fh);
-
-	std::fseek(this->upload_fh, 0, SEEK_SET);
-
-	std::size_t temp_buffer_size = this->send_buffer.size();
-
-	// Allocate a power-of-two buffer size large enough to hold the file
-	while (temp_buffer_size < this->upload_size + 6)
-		temp_buffer_size *= 2;
+	this->upload_size = this->upload_data->length();
 
-	this->send_buffer2.resize(temp_buffer_size);
+	// Only needs to hold packets sent during the upload, the file itself is streamed from the cache
+	this->send_buffer2.resize(this->send_buffer.size());
 	this->send_buffer2_gpos = 0;
 	this->send_buffer2_ppos = 0;
 	this->send_buffer2_used = 0;
 
-	swap(this->send_buffer, this->send_buffer2);
-	swap(this->send_buffer_gpos, this->send_buffer2_gpos);
-	swap(this->send_buffer_ppos, this->send_buffer2_ppos);
-	swap(this->send_buffer_used, this->send_buffer2_used);
-
 	// Build the file upload header packet
 	PacketBuilder builder(PACKET_F_INIT, PACKET_A_INIT, 2);
 	builder.AddChar(init_reply);
@@ -337,14 +334,25 @@ bool EOClient::Upload(FileType type, const std::string &filename, InitReply init
 
 	Client::Send(builder);
 
+	// Make sure the upload keeps getting ticked even if the client stays quiet
+	this->server()->Wake(this);
+
 	return true;
 }
 
 void EOClient::Send(const PacketBuilder &builder)
 {
-	std::string data= this->processor.Encode(builder);
+	this->SendEncoded(this->processor.Encode(builder));
+}
 
-	if (this->upload_fh)
+void EOClient::Send(PacketBroadcast &packet)
+{
+	this->SendEncoded(packet.Get(this->processor.EMultiE()));
+}
+
+void EOClient::SendEncoded(const std::string &data)
+{
+	if (this->upload_data)
 	{
 		if (data.length() > this->send_buffer2.length() - this->send_buffer2_used)
 		{
@@ -354,29 +362,30 @@ void EOClient::Send(const PacketBuilder &builder)
 
 		const std::size_t mask = this->send_buffer2.length() - 1;
 
-		for (std::size_t i = 0; i < data.length(); ++i)
-		{
-			this->send_buffer2_ppos = (this->send_buffer2_ppos + 1) & mask;
-			this->send_buffer2[this->send_buffer2_ppos] = data[i];
-		}
+		// send_buffer2_ppos points at the last byte written
+		std::size_t start = (this->send_buffer2_ppos + 1) & mask;
+		std::size_t first = std::min(data.length(), this->send_buffer2.length() - start);
+
+		std::memcpy(&this->send_buffer2[start], data.data(), first);
+		std::memcpy(&this->send_buffer2[0], data.data() + first, data.length() - first);
 
+		this->send_buffer2_ppos = (this->send_buffer2_ppos + data.length()) & mask;
 		this->send_buffer2_used += data.length();
 	}
 	else
 	{
-		Client::Send(this->processor.Encode(builder));
+		Client::Send(data);
 	}
 }
 
 EOClient::~EOClient()
 {
-	if (this->upload_fh)
-	{
-		std::fclose(this->upload_fh);
-	}
+	this->server()->world->hash_pool.Cancel(this);
 
 	if (this->player)
 	{
 		this->player->Logout();
 	}
+
+	this->server()->world->ReleasePlayerID(this->id);
 }
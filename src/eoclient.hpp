@@ -5,12 +5,13 @@
 
 #include <array>
 #include <cstddef>
-#include <cstdio>
+#include <memory>
 #include <queue>
 #include <string>
 #include <utility>
 
 #include "socket.hpp"
+#include "util/spsc_queue.hpp"
 
 #include "fwd/character.hpp"
 #include "fwd/player.hpp"
@@ -56,13 +57,6 @@ class ActionQueue
 class EOClient : public Client
 {
 	public:
-		enum PacketState
-		{
-			ReadLen1,
-			ReadLen2,
-			ReadData
-		};
-
 		enum ClientState
 		{
 			Uninitialized,
@@ -75,8 +69,7 @@ class EOClient : public Client
 		void Initialize();
 		EOClient();
 
-		FileType upload_type;
-		std::FILE *upload_fh;
+		std::shared_ptr<const std::string> upload_data;
 		std::size_t upload_pos;
 		std::size_t upload_size;
 
@@ -89,6 +82,11 @@ class EOClient : public Client
 		int upcoming_seq_start;
 		int seq;
 
+		/**
+		 * Sends an already encoded packet, holding it back while a file upload is in progress
+		 */
+		void SendEncoded(const std::string &data);
+
 	public:
 		EOServer *server() { return static_cast<EOServer *>(Client::server); };
 		int version;
@@ -101,25 +99,35 @@ class EOClient : public Client
 
 		ActionQueue queue;
 
-		PacketState packet_state;
-		unsigned char raw_length[2];
-		unsigned int length;
-		std::string data;
+		/**
+		 * Bytes left to skip of an oversized packet
+		 */
+		std::size_t discard_length;
+
+		/**
+		 * Decoded packets waiting to be executed by the main thread
+		 */
+		util::spsc_queue<std::string> inbound;
 
 		PacketProcessor processor;
 
-		EOClient(EOServer *server_) : Client(server_)
+		EOClient(EOServer *server_) : Client(server_), inbound(64)
 		{
 			this->Initialize();
 		}
 
-		EOClient(const Socket &sock, EOServer *server_) : Client(sock, server_)
+		EOClient(const Socket &sock, EOServer *server_) : Client(sock, server_), inbound(64)
 		{
 			this->Initialize();
 		}
 
 		virtual bool NeedTick();
 
+		/**
+		 * Splits the receive buffer in to packets and decodes them on to the inbound queue
+		 */
+		virtual void Received();
+
 		void Tick();
 
 		void InitNewSequence();
@@ -135,6 +143,7 @@ class EOClient : public Client
 		bool Upload(FileType type, int id, InitReply init_reply);
 		bool Upload(FileType type, const std::string &filename, InitReply init_reply);
 		void Send(const PacketBuilder &packet);
+		void Send(PacketBroadcast &packet);
 
 		~EOClient();
 };
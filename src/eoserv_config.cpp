@@ -74,6 +74,8 @@ void eoserv_config_validate_config(Config& config)
 	eoserv_config_default(config, "Port"               , 8078);
 	eoserv_config_default(config, "MaxConnections"     , 300);
 	eoserv_config_default(config, "ListenBacklog"      , 50);
+	eoserv_config_default(config, "SocketBackend"      , "epoll");
+	eoserv_config_default(config, "NetworkThreads"     , 0);
 	eoserv_config_default(config, "MaxPlayers"         , 200);
 	eoserv_config_default(config, "MaxConnectionsPerIP", 3);
 	eoserv_config_default(config, "IPReconnectLimit"   , 10);
@@ -84,9 +86,14 @@ void eoserv_config_validate_config(Config& config)
 	eoserv_config_default(config, "MaxVersion"         , 0);
 	eoserv_config_default(config, "OldVersionCompat"   , false);
 	eoserv_config_default(config, "TimedSave"          , "5m");
+	eoserv_config_default(config, "AsyncSave"          , true);
+	eoserv_config_default(config, "Journal"            , "./journal.bin");
+	eoserv_config_default(config, "JournalInterval"    , "1s");
 	eoserv_config_default(config, "IgnoreHDID"         , false);
+	eoserv_config_default(config, "BanRefresh"         , "5m");
 	eoserv_config_default(config, "ServerLanguage"     , "./lang/en.ini");
 	eoserv_config_default(config, "PacketQueueMax"     , 40);
+	eoserv_config_default(config, "PacketsPerTick"     , 64);
 	eoserv_config_default(config, "PingRate"           , 60.0);
 	eoserv_config_default(config, "EnforceSequence"    , true);
 	eoserv_config_default(config, "EnforceTimestamps"  , true);
@@ -94,12 +101,23 @@ void eoserv_config_validate_config(Config& config)
 	eoserv_config_default(config, "PasswordSalt"       , "ChangeMe");
 	eoserv_config_default(config, "SeoseCompat"        , "ChangeMe");
 	eoserv_config_default(config, "SeoseCompatKey"     , "D4q9_f30da%#q02#)8");
+	eoserv_config_default(config, "HashThreads"        , 1);
 	eoserv_config_default(config, "DBType"             , "mysql");
 	eoserv_config_default(config, "DBHost"             , "localhost");
 	eoserv_config_default(config, "DBUser"             , "eoserv");
 	eoserv_config_default(config, "DBPass"             , "eoserv");
 	eoserv_config_default(config, "DBName"             , "eoserv");
 	eoserv_config_default(config, "DBPort"             , 0);
+	eoserv_config_default(config, "ReadConnection"     , true);
+	eoserv_config_default(config, "DBReadHost"         , "");
+	eoserv_config_default(config, "DBReadUser"         , "");
+	eoserv_config_default(config, "DBReadPass"         , "");
+	eoserv_config_default(config, "DBReadName"         , "");
+	eoserv_config_default(config, "DBReadPort"         , 0);
+	eoserv_config_default(config, "CommitWrites"       , 1000);
+	eoserv_config_default(config, "CommitBytes"        , 1048576);
+	eoserv_config_default(config, "CommitInterval"     , "30s");
+	eoserv_config_default(config, "PackedColumns"      , false);
 	eoserv_config_default(config, "Maps"               , 278);
 	eoserv_config_default(config, "QuestDir"           , "./data/quests/");
     eoserv_config_default(config, "Quests"             , 0);
@@ -134,10 +152,13 @@ void eoserv_config_validate_config(Config& config)
 	eoserv_config_default(config, "GuildMaxWidth"      , 180);
 	eoserv_config_default(config, "GlobalPK"           , false);
 	eoserv_config_default(config, "PKExcept"           , "");
-	eoserv_config_default(config, "NPCChaseMode"       , 0);
+	eoserv_config_default(config, "NPCChaseMode"       , 1);
 	eoserv_config_default(config, "NPCChaseDistance"   , 18);
 	eoserv_config_default(config, "NPCBoredTimer"      , 30);
 	eoserv_config_default(config, "NPCAdjustMaxDam"    , 3);
+	eoserv_config_default(config, "NPCIdleDistance"    , 30);
+	eoserv_config_default(config, "NPCPathBudget"      , 20000);
+	eoserv_config_default(config, "NPCSpells"          , false);
 	eoserv_config_default(config, "BoardMaxPosts"      , 20);
 	eoserv_config_default(config, "BoardMaxUserPosts"  , 6);
 	eoserv_config_default(config, "BoardMaxRecentPosts", 2);
@@ -317,6 +338,8 @@ void eoserv_config_validate_admin(Config& config)
 	eoserv_config_default(config, "rehash"        , 4);
 	eoserv_config_default(config, "repub"         , 4);
 	eoserv_config_default(config, "request"       , 4);
+	eoserv_config_default(config, "dbstats"       , 3);
+	eoserv_config_default(config, "columnbench"   , 4);
 	eoserv_config_default(config, "sitem"         , 3);
 	eoserv_config_default(config, "ditem"         , 3);
 	eoserv_config_default(config, "snpc"          , 3);
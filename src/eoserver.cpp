@@ -52,7 +52,7 @@ void server_pump_queue(void *server_void)
 
 		std::size_t size = client->queue.queue.size();
 
-		if (size > std::size_t(int(server->world->config["PacketQueueMax"])))
+		if (size > server->world->hot_config.packet_queue_max)
 		{
             #ifdef DEBUG_EXCEPTIONS
 			Console::Wrn("Client was disconnected for filling up the action queue: %s", static_cast<std::string>(client->GetRemoteAddr()).c_str());
@@ -128,6 +128,20 @@ void EOServer::Initialize(std::array<std::string, 6> dbinfo, const Config &eoser
 
 	this->world->server = this;
 
+	Server::Backend backend = Server::ParseBackend(this->world->config["SocketBackend"]);
+
+	if (this->SetBackend(backend) != backend)
+	{
+		Console::Wrn("SocketBackend '%s' is not supported on this platform, falling back", std::string(this->world->config["SocketBackend"]).c_str());
+	}
+
+	int io_threads = int(this->world->config["NetworkThreads"]);
+
+	if (this->SetIOThreads(io_threads) != io_threads)
+	{
+		Console::Wrn("NetworkThreads requires the epoll socket backend, networking will be done on the main thread");
+	}
+
 	if (this->world->config["SLN"])
 	{
 		this->sln = new SLN(this);
@@ -233,6 +247,8 @@ void EOServer::Tick()
 	this->BuryTheDead();
 
 	this->world->timer.Tick();
+	this->world->db_worker.Poll();
+	this->world->hash_pool.Poll();
 }
 
 EOServer::~EOServer()
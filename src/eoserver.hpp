@@ -6,6 +6,7 @@
 #include <array>
 #include <string>
 
+#include "filecache.hpp"
 #include "socket.hpp"
 
 #include "fwd/config.hpp"
@@ -33,6 +34,11 @@ class EOServer : public Server
 		double start;
 		SLN *sln;
 
+		/**
+		 * Map and pub files being uploaded to clients
+		 */
+		FileCache upload_cache;
+
 		EOServer(IPAddress addr, unsigned short port, std::array<std::string, 6> dbinfo, const Config &eoserv_config, const Config &admin_config) : Server(addr, port)
 		{
 			this->Initialize(dbinfo, eoserv_config, admin_config);
@@ -0,0 +1,83 @@
+#include "filecache.hpp"
+
+#include <cstdio>
+#include <utility>
+
+#include <sys/stat.h>
+
+#include "util.hpp"
+
+static std::shared_ptr<const std::string> filecache_read(const std::string &filename, std::size_t size)
+{
+	std::FILE *fh = std::fopen(filename.c_str(), "rb");
+
+	if (!fh)
+		return std::shared_ptr<const std::string>();
+
+	std::shared_ptr<std::string> data = std::make_shared<std::string>(size, '\0');
+	std::size_t read = size ? std::fread(&(*data)[0], 1, size, fh) : 0;
+
+	std::fclose(fh);
+
+	if (read != size)
+		return std::shared_ptr<const std::string>();
+
+	return data;
+}
+
+std::shared_ptr<const std::string> FileCache::Get(const std::string &filename, bool pk)
+{
+	struct stat st;
+
+	if (stat(filename.c_str(), &st) != 0)
+	{
+		this->files.erase(filename);
+		return std::shared_ptr<const std::string>();
+	}
+
+	auto it = this->files.find(filename);
+
+	if (it == this->files.end() || it->second.mtime != st.st_mtime || it->second.size != static_cast<long long>(st.st_size))
+	{
+		Entry entry;
+		entry.mtime = st.st_mtime;
+		entry.size = st.st_size;
+		entry.data = filecache_read(filename, st.st_size);
+
+		if (!entry.data)
+		{
+			this->files.erase(filename);
+			return std::shared_ptr<const std::string>();
+		}
+
+		it = this->files.insert(std::make_pair(filename, Entry())).first;
+		it->second = entry;
+	}
+
+	Entry &entry = it->second;
+
+	if (!pk)
+		return entry.data;
+
+	if (!entry.pk_data)
+	{
+		static const std::pair<std::size_t, char> pk_bytes[] = {{0x03, char(0xFF)}, {0x04, 0x01}, {0x1F, 0x04}};
+
+		std::shared_ptr<std::string> pk_data = std::make_shared<std::string>(*entry.data);
+
+		UTIL_FOREACH_CREF(pk_bytes, pk_byte)
+		{
+			if (pk_byte.first < pk_data->length())
+				(*pk_data)[pk_byte.first] = pk_byte.second;
+		}
+
+		entry.pk_data = pk_data;
+	}
+
+	return entry.pk_data;
+}
+
+void FileCache::Clear()
+{
+	this->files.clear();
+}
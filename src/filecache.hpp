@@ -0,0 +1,49 @@
+#ifndef FILECACHE_HPP_INCLUDED
+#define FILECACHE_HPP_INCLUDED
+
+#include "fwd/filecache.hpp"
+
+#include <ctime>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Shared in-memory copies of the files sent to clients (maps and pub files).
+ * Every client uploading the same file streams from the same image.
+ */
+class FileCache
+{
+	protected:
+		struct Entry
+		{
+			std::time_t mtime;
+			long long size;
+
+			std::shared_ptr<const std::string> data;
+
+			/**
+			 * Copy of data with the map header rewritten to enable PK, created on first use
+			 */
+			std::shared_ptr<const std::string> pk_data;
+		};
+
+		std::unordered_map<std::string, Entry> files;
+
+	public:
+		/**
+		 * Returns the contents of a file.
+		 * The file is only read again if its size or modification time has changed.
+		 * @param filename File to read.
+		 * @param pk Returns the map file with its header patched to enable PK.
+		 * @return 0 if the file could not be read.
+		 */
+		std::shared_ptr<const std::string> Get(const std::string &filename, bool pk = false);
+
+		/**
+		 * Drops all cached files. Clients already uploading keep their copy.
+		 */
+		void Clear();
+};
+
+#endif // FILECACHE_HPP_INCLUDED
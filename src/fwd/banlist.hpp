@@ -0,0 +1,6 @@
+#ifndef FWD_BANLIST_HPP_INCLUDED
+#define FWD_BANLIST_HPP_INCLUDED
+
+class BanList;
+
+#endif
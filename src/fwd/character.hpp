@@ -6,6 +6,7 @@ class Character;
 struct Character_Item;
 struct Character_Spell;
 struct Character_Achievements;
+struct Character_SaveState;
 
 enum AdminLevel : unsigned char
 {
@@ -4,5 +4,11 @@
 class Database;
 
 class Database_Result;
+class Database_Row;
+class Database_Value;
+
+class Database_Params;
+
+class Database_Worker;
 
 #endif
@@ -0,0 +1,6 @@
+#ifndef FWD_FILECACHE_HPP_INCLUDED
+#define FWD_FILECACHE_HPP_INCLUDED
+
+class FileCache;
+
+#endif
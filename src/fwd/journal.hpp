@@ -0,0 +1,6 @@
+#ifndef FWD_JOURNAL_HPP_INCLUDED
+#define FWD_JOURNAL_HPP_INCLUDED
+
+class Journal;
+
+#endif
@@ -9,6 +9,7 @@ struct NPC_Shop_Trade_Item;
 struct NPC_Shop_Craft_Ingredient;
 struct NPC_Shop_Craft_Item;
 struct NPC_Citizenship;
+struct NPC_Prototype;
 struct NPC_Marriage;
 
 enum InnUnsubscribeReply : unsigned char
@@ -103,14 +103,16 @@ std::shared_ptr<Guild> GuildManager::GetGuild(std::string tag)
 	}
 	else
 	{
-		Database_Result res = this->world->db.Query("SELECT `tag`, `name`, `description`, `created`, `ranks`, `bank` FROM `guilds` WHERE `tag` = '$'", tag.c_str());
+		this->world->WaitForQueued("guild:" + tag);
+
+		Database_Result res = this->world->db.Execute("SELECT `tag`, `name`, `description`, `created`, `ranks`, `bank` FROM `guilds` WHERE `tag` = ?", Database_Params().Add(tag));
 
 		if (res.empty())
 		{
 			return std::shared_ptr<Guild>();
 		}
 
-		std::unordered_map<std::string, util::variant> row = res.front();
+		Database_Row row = res.front();
 		std::shared_ptr<Guild> guild(new Guild(this));
 		guild->tag = static_cast<std::string>(row["tag"]);
 		guild->name = static_cast<std::string>(row["name"]);
@@ -119,7 +121,7 @@ std::shared_ptr<Guild> GuildManager::GetGuild(std::string tag)
 		guild->ranks = RankUnserialize(static_cast<std::string>(row["ranks"]));
 		guild->bank = static_cast<int>(row["bank"]);
 
-		res = this->world->db.Query("SELECT `name`, `guild_rank` FROM `characters` WHERE `guild` = '$' ORDER BY `guild_rank` ASC, `name` ASC", tag.c_str());
+		res = this->world->db.Execute("SELECT `name`, `guild_rank` FROM `characters` WHERE `guild` = ? ORDER BY `guild_rank` ASC, `name` ASC", Database_Params().Add(tag));
 
 		UTIL_FOREACH_REF(res, row)
 		{
@@ -146,14 +148,25 @@ std::shared_ptr<Guild> GuildManager::GetGuildName(std::string name)
 		}
 	}
 
-	Database_Result res = this->world->db.Query("SELECT `tag`, `name`, `description`, `created`, `ranks`, `bank` FROM `guilds` WHERE `name` = '$'", name.c_str());
+	// Names are never changed by queued saves, so the tag can be found before waiting on them
+	Database_Result res = this->world->db.Execute("SELECT `tag` FROM `guilds` WHERE `name` = ?", Database_Params().Add(name));
+
+	if (res.empty())
+	{
+		return std::shared_ptr<Guild>();
+	}
+
+	std::string tag = res.front()["tag"];
+	this->world->WaitForQueued("guild:" + tag);
+
+	res = this->world->db.Execute("SELECT `tag`, `name`, `description`, `created`, `ranks`, `bank` FROM `guilds` WHERE `tag` = ?", Database_Params().Add(tag));
 
 	if (res.empty())
 	{
 		return std::shared_ptr<Guild>();
 	}
 
-	std::unordered_map<std::string, util::variant> row = res.front();
+	Database_Row row = res.front();
 	std::shared_ptr<Guild> guild(new Guild(this));
 	guild->tag = static_cast<std::string>(row["tag"]);
 	guild->name = static_cast<std::string>(row["name"]);
@@ -162,7 +175,7 @@ std::shared_ptr<Guild> GuildManager::GetGuildName(std::string name)
 	guild->ranks = RankUnserialize(static_cast<std::string>(row["ranks"]));
 	guild->bank = static_cast<int>(row["bank"]);
 
-	res = this->world->db.Query("SELECT `name`, `guild_rank` FROM `characters` WHERE `guild` = '$' ORDER BY `guild_rank` ASC, `name` ASC", static_cast<std::string>(row["tag"]).c_str());
+	res = this->world->db.Execute("SELECT `name`, `guild_rank` FROM `characters` WHERE `guild` = ? ORDER BY `guild_rank` ASC, `name` ASC", Database_Params().Add(static_cast<std::string>(row["tag"])));
 
 	UTIL_FOREACH_REF(res, row)
 	{
@@ -364,6 +377,7 @@ void Guild::DelMember(std::string kicked, Character *kicker, bool alert)
 		}
 	}
 
+	this->manager->world->WaitForQueued("character:" + kicked);
 	this->manager->world->db.Query("UPDATE `characters` SET `guild` = NULL, `guild_rank` = NULL WHERE `name` = '$'", kicked.c_str());
 }
 
@@ -484,7 +498,8 @@ void Guild::Save()
 {
 	if (this->needs_save)
 	{
-		this->manager->world->db.Query("UPDATE `guilds` SET `description` = '$', `ranks` = '$', `bank` = # WHERE tag = '$'", this->description.c_str(), RankSerialize(this->ranks).c_str(), this->bank, this->tag.c_str());
+		this->manager->world->QueueExecute("UPDATE `guilds` SET `description` = ?, `ranks` = ?, `bank` = ? WHERE tag = ?",
+			Database_Params().Add(this->description).Add(RankSerialize(this->ranks)).Add(this->bank).Add(this->tag), {"guild:" + this->tag});
 		this->needs_save = false;
 	}
 }
@@ -507,6 +522,7 @@ Guild::~Guild()
 	}
 	else
 	{
+		this->manager->world->WaitForQueued("guild:" + this->tag);
 		this->manager->world->db.Query("UPDATE `characters` SET `guild` = NULL, `guild_rank` = NULL WHERE `guild` = '$'", this->tag.c_str());
 		this->manager->world->db.Query("DELETE FROM `guilds` WHERE tag = '$'", this->tag.c_str());
 	}
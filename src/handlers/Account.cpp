@@ -1,6 +1,7 @@
 #include "handlers.hpp"
 
 #include <algorithm>
+#include <memory>
 #include <stdexcept>
 
 #include "../util.hpp"
@@ -61,6 +62,10 @@ namespace Handlers
         std::string email = reader.GetBreakString();
         std::string computer = reader.GetBreakString();
 
+        // Ignore repeated requests while the last one is being hashed
+        if (client->server()->world->hash_pool.Pending(client))
+            return;
+
         if (username.length() < std::size_t(int(client->server()->world->config["AccountMinLength"]))
         || username.length() > std::size_t(int(client->server()->world->config["AccountMaxLength"]))
         || password.str().length() < std::size_t(int(client->server()->world->config["PasswordMinLength"]))
@@ -89,34 +94,51 @@ namespace Handlers
         if (client->server()->world->config["SeoseCompat"])
             password = std::move(seose_str_hash(password.str(), client->server()->world->config["SeoseCompatKey"]));
 
-        PacketBuilder reply(PACKET_ACCOUNT, PACKET_REPLY, 4);
-
         if (!Player::ValidName(username))
         {
+            PacketBuilder reply(PACKET_ACCOUNT, PACKET_REPLY, 4);
             reply.AddShort(ACCOUNT_NOT_APPROVED);
             reply.AddString("NO");
+            client->Send(reply);
+            return;
         }
         else if (client->server()->world->PlayerExists(username))
         {
+            PacketBuilder reply(PACKET_ACCOUNT, PACKET_REPLY, 4);
             reply.AddShort(ACCOUNT_EXISTS);
             reply.AddString("NO");
+            client->Send(reply);
+            return;
         }
-        else
+
+        client->server()->world->HashPassword(client, username, std::move(password), [=](util::secure_string &&password)
         {
-            username = util::lowercase(username);
+            if (!client->Connected())
+                return;
 
-            client->server()->world->CreatePlayer(username, std::move(password), fullname, location, email, computer, util::to_string(hdid), static_cast<std::string>(client->GetRemoteAddr()));
-            reply.AddShort(ACCOUNT_CREATED);
-            reply.AddString("OK");
+            PacketBuilder reply(PACKET_ACCOUNT, PACKET_REPLY, 4);
 
-            #ifdef GUI
-            Chat::Info("New account: " + std::string(username.c_str()) ,255,255,255);
-            #else
-            Console::Out("New account: %s", username.c_str());
-            #endif
-        }
+            // Someone else may have taken the name while the password was being hashed
+            if (client->server()->world->PlayerExists(username))
+            {
+                reply.AddShort(ACCOUNT_EXISTS);
+                reply.AddString("NO");
+            }
+            else
+            {
+                client->server()->world->CreatePlayer(username, std::move(password), fullname, location, email, computer, util::to_string(hdid), static_cast<std::string>(client->GetRemoteAddr()));
+                reply.AddShort(ACCOUNT_CREATED);
+                reply.AddString("OK");
+
+                #ifdef GUI
+                Chat::Info("New account: " + std::string(username.c_str()) ,255,255,255);
+                #else
+                Console::Out("New account: %s", username.c_str());
+                #endif
+            }
 
-        client->Send(reply);
+            client->Send(reply);
+        });
     }
 
     void Account_Agree(Player *player, PacketReader &reader)
@@ -125,6 +147,12 @@ namespace Handlers
         util::secure_string oldpassword(std::move(reader.GetBreakString()));
         util::secure_string newpassword(std::move(reader.GetBreakString()));
 
+        EOClient *client = player->client;
+
+        // Ignore repeated requests while the last one is being hashed
+        if (player->world->hash_pool.Pending(client))
+            return;
+
         if (username.length() < std::size_t(int(player->world->config["AccountMinLength"]))
         || username.length() > std::size_t(int(player->world->config["AccountMaxLength"]))
         || oldpassword.str().length() < std::size_t(int(player->world->config["PasswordMinLength"]))
@@ -154,8 +182,14 @@ namespace Handlers
         if (player->world->config["SeoseCompat"])
         newpassword = std::move(seose_str_hash(newpassword.str(), player->world->config["SeoseCompatKey"]));
 
+        // Both passwords are hashed on the pool, the old one first to check it
+        player->world->HashPassword(client, username, std::move(oldpassword), [client, username, newpassword](util::secure_string &&oldpassword)
         {
-            std::unique_ptr<Player> changepass(player->world->Login(username, std::move(oldpassword)));
+            if (!client->Connected() || !client->player)
+                return;
+
+            Player *player = client->player;
+            std::shared_ptr<Player> changepass(player->world->Login(username, std::move(oldpassword)));
 
             if (!changepass)
             {
@@ -166,14 +200,22 @@ namespace Handlers
                 return;
             }
 
-            changepass->ChangePass(std::move(newpassword));
-        }
+            util::secure_string password(newpassword);
 
-        PacketBuilder reply(PACKET_ACCOUNT, PACKET_REPLY, 4);
-        reply.AddShort(ACCOUNT_CHANGED);
-        reply.AddString("OK");
+            player->world->HashPassword(client, username, std::move(password), [client, changepass](util::secure_string &&newpassword)
+            {
+                changepass->ChangePass(std::move(newpassword));
+
+                if (!client->Connected() || !client->player)
+                    return;
+
+                PacketBuilder reply(PACKET_ACCOUNT, PACKET_REPLY, 4);
+                reply.AddShort(ACCOUNT_CHANGED);
+                reply.AddString("OK");
 
-        player->Send(reply);
+                client->player->Send(reply);
+            });
+        });
     }
 
     PACKET_HANDLER_REGISTER(PACKET_ACCOUNT)
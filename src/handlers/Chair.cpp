@@ -130,6 +130,8 @@ namespace Handlers
 
             character->x = x;
             character->y = y;
+            character->map->GridUpdate(character);
+            character->map->UpdateView(character);
 
             PacketBuilder reply(PACKET_CHAIR, PACKET_PLAYER, 6);
             reply.AddShort(character->player->id);
@@ -161,6 +163,9 @@ namespace Handlers
                 break;
             }
 
+            character->map->GridUpdate(character);
+            character->map->UpdateView(character);
+
             PacketBuilder reply(PACKET_CHAIR, PACKET_CLOSE, 4);
             reply.AddShort(character->player->id);
             reply.AddChar(character->x);
@@ -71,7 +71,7 @@ namespace Handlers
             player->AddCharacter(name, gender, hairstyle, haircolor, race);
             reply.ReserveMore(5 + player->characters.size() * 34);
 
-            Database_Result players = player->world->db.Query("SELECT COUNT(1) AS `count` FROM `characters`");
+            Database_Result players = player->world->ReadDB().Query("SELECT COUNT(1) AS `count` FROM `characters`");
 
             #ifdef GUI
             Chat::Info("New character: " + name + " " + "(" + player->username.c_str() + ")",255,255,255);
@@ -14,9 +14,9 @@ namespace Handlers
         hpgain = character->maxhp - character->hp;
         tpgain = character->maxtp - character->tp;
 
-        if (character->npc_type == ENF::Inn && character->npc->citizenship)
+        if (character->npc_type == ENF::Inn && character->npc->prototype->citizenship)
         {
-            std::string loc = character->npc->citizenship->home;
+            std::string loc = character->npc->prototype->citizenship->home;
 
             if (hpgain > 0 || tpgain > 0)
             {
@@ -32,9 +32,9 @@ namespace Handlers
     {
         (void)reader;
 
-        if (character->npc_type == ENF::Inn && character->npc->citizenship)
+        if (character->npc_type == ENF::Inn && character->npc->prototype->citizenship)
         {
-            std::string loc = character->npc->citizenship->home;
+            std::string loc = character->npc->prototype->citizenship->home;
 
             int cost = (character->world->home_config[(loc) + ".innsleepcost"]);
 
@@ -88,7 +88,7 @@ namespace Handlers
 
             for (int i = 0; i < 3; ++i)
             {
-                if (util::lowercase(answers[i]) != util::lowercase(character->npc->citizenship->answers[i]))
+                if (util::lowercase(answers[i]) != util::lowercase(character->npc->prototype->citizenship->answers[i]))
                 {
                     ++questions_wrong;
                 }
@@ -96,7 +96,7 @@ namespace Handlers
 
             if (questions_wrong == 0)
             {
-                character->home = character->npc->citizenship->home;
+                character->home = character->npc->prototype->citizenship->home;
             }
 
             PacketBuilder reply(PACKET_CITIZEN, PACKET_REPLY, 1);
@@ -114,7 +114,7 @@ namespace Handlers
         {
             PacketBuilder reply(PACKET_CITIZEN, PACKET_REMOVE, 1);
 
-            if (character->home == character->npc->citizenship->home || character->world->config["CitizenUnsubscribeAnywhere"])
+            if (character->home == character->npc->prototype->citizenship->home || character->world->config["CitizenUnsubscribeAnywhere"])
             {
                 character->home = "";
                 reply.AddChar(UNSUBSCRIBE_UNSUBSCRIBED);
@@ -134,12 +134,12 @@ namespace Handlers
 
         UTIL_FOREACH(character->map->npcs, npc)
         {
-            if (npc->index == id && npc->Data().type == ENF::Inn && npc->citizenship)
+            if (npc->index == id && npc->Data().type == ENF::Inn && npc->prototype->citizenship)
             {
                 character->npc = npc;
                 character->npc_type = ENF::Inn;
 
-                PacketBuilder reply(PACKET_CITIZEN, PACKET_OPEN, 9 + npc->citizenship->questions[0].length() + npc->citizenship->questions[1].length() + npc->citizenship->questions[2].length());
+                PacketBuilder reply(PACKET_CITIZEN, PACKET_OPEN, 9 + npc->prototype->citizenship->questions[0].length() + npc->prototype->citizenship->questions[1].length() + npc->prototype->citizenship->questions[2].length());
 
                 Home* home = character->world->GetHome(character);
 
@@ -163,9 +163,9 @@ namespace Handlers
 
                 reply.AddShort(0);
                 reply.AddByte(255);
-                reply.AddBreakString(npc->citizenship->questions[0]);
-                reply.AddBreakString(npc->citizenship->questions[1]);
-                reply.AddString(npc->citizenship->questions[2]);
+                reply.AddBreakString(npc->prototype->citizenship->questions[0]);
+                reply.AddBreakString(npc->prototype->citizenship->questions[1]);
+                reply.AddString(npc->prototype->citizenship->questions[2]);
 
                 character->Send(reply);
 
@@ -40,15 +40,12 @@ namespace Handlers
         if (message.empty())
             return;
 
-        for (int i = 0; i < int(character->world->cursefilter_config["Amount"]); i++)
+        UTIL_FOREACH(character->world->curse_filters, filter)
         {
-            std::string curseword = std::string(character->world->cursefilter_config[util::to_string(i+1) + ".Message"]);
-            std::string replacement = std::string(character->world->cursefilter_config[util::to_string(i+1) + ".Replacement"]);
-
-            size_t cursefilter = message.find(curseword);
+            size_t cursefilter = message.find(filter.message);
 
             if (cursefilter != string::npos)
-                message.replace(message.find(curseword), curseword.length(), replacement);
+                message.replace(cursefilter, filter.message.length(), filter.replacement);
         }
 
         if (character->world->chatlogs_config["LogPublic"])
@@ -1274,6 +1271,7 @@ namespace Handlers
                                                     return;
                                                 }
 
+                                                victim->world->WaitForQueued("character:" + victim->SourceName());
                                                 victim->world->db.Query("UPDATE `characters` SET `name` = '$' WHERE `name` = '$'", name.c_str(), victim->SourceName().c_str());
                                                 victim->SourceName() = name;
 
@@ -1300,6 +1298,7 @@ namespace Handlers
                                                 return;
                                             }
 
+                                            character->world->WaitForQueued("character:" + character->SourceName());
                                             character->world->db.Query("UPDATE `characters` SET `name` = '$' WHERE `name` = '$'", name.c_str(), character->SourceName().c_str());
                                             character->SourceName() = name;
 
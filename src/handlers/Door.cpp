@@ -53,8 +53,8 @@ namespace Handlers
                 int resreb = row["rebirth"];
 
                 std::string restitle = row["title"];
-                std::string reshome = row["home"] ? row["home"] : "None";
-                std::string respartner = row["partner"] ? row["partner"] : "None";
+                std::string reshome = row["home"] ? row["home"].GetString() : "None";
+                std::string respartner = row["partner"] ? row["partner"].GetString() : "None";
 
                 ECF_Data& resclass = character->world->ecf->Get(util::to_int(row["class"]));
 
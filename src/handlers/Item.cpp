@@ -676,7 +676,7 @@ namespace Handlers
 
         int distance = util::path_length(x, y, character->x, character->y);
 
-        if (distance > static_cast<int>(character->world->config["DropDistance"]))
+        if (distance > character->world->hot_config.drop_distance)
             return;
 
         if (!character->map->Walkable(x, y))
@@ -689,7 +689,7 @@ namespace Handlers
             if (item)
             {
                 item->owner = character->player->id;
-                item->unprotecttime = Timer::GetTime() + static_cast<double>(character->world->config["ProtectPlayerDrop"]);
+                item->unprotecttime = Timer::GetTime() + character->world->hot_config.protect_player_drop;
 
                 character->DelItem(id, amount);
 
@@ -764,7 +764,7 @@ namespace Handlers
         {
             int distance = util::path_length(item->x, item->y, character->x, character->y);
 
-            if (distance > static_cast<int>(character->world->config["DropDistance"]))
+            if (distance > character->world->hot_config.drop_distance)
                 return;
 
             int blueflag = int(character->world->ctf_config["BlueFlag"]);
@@ -36,8 +36,6 @@ namespace Handlers
     {
         if (character->trading) return;
 
-        using namespace std::placeholders;
-
         reader.GetChar();
         reader.GetChar();
         short track = reader.GetShort();
@@ -60,7 +58,12 @@ namespace Handlers
 
         PacketBuilder builder(PACKET_JUKEBOX, PACKET_USE, 2);
         builder.AddShort(track + 1);
-        std::for_each(UTIL_CRANGE(character->map->characters), std::bind(&Character::Send, _1, builder));
+        PacketBroadcast packet(builder);
+
+        UTIL_FOREACH(character->map->characters, mapchar)
+        {
+            mapchar->Send(packet);
+        }
     }
 
     void Jukebox_Use(Character *character, PacketReader &reader)
@@ -101,6 +101,7 @@ namespace Handlers
                             }
                             else
                             {
+                                character->world->WaitForQueued("character:" + partner);
                                 character->world->db.Query("UPDATE `characters` SET `partner` = ''  WHERE `name` = '$'", partner.c_str());
                             }
 
@@ -15,56 +15,11 @@
 
 namespace Handlers
 {
-    void Login_Request(EOClient *client, PacketReader &reader)
+    // Picks up Login_Request on the main thread once the password's been hashed
+    static void Login_Hashed(EOClient *client, const std::string &username, util::secure_string &&password)
     {
-        std::string username = reader.GetBreakString();
-        util::secure_string password(std::move(reader.GetBreakString()));
-
-        if (username.length() > std::size_t(int(client->server()->world->config["AccountMaxLength"]))
-         || password.str().length() > std::size_t(int(client->server()->world->config["PasswordMaxLength"])))
-        {
-            return;
-        }
-
-        username = util::lowercase(username);
-
-        if (client->server()->world->config["SeoseCompat"])
-            password = std::move(seose_str_hash(password.str(), client->server()->world->config["SeoseCompatKey"]));
-
-        if (client->server()->world->CheckBan(&username, 0, 0) != -1)
-        {
-            PacketBuilder reply(PACKET_F_INIT, PACKET_A_INIT, 2);
-            reply.AddByte(INIT_BANNED);
-            reply.AddByte(INIT_BAN_PERM);
-            client->Send(reply);
-            client->Close();
-            return;
-        }
-
-        if (username.length() < std::size_t(int(client->server()->world->config["AccountMinLength"])))
-        {
-            PacketBuilder reply(PACKET_LOGIN, PACKET_REPLY, 2);
-            reply.AddShort(LOGIN_WRONG_USER);
-            client->Send(reply);
-            return;
-        }
-
-        if (password.str().length() < std::size_t(int(client->server()->world->config["PasswordMinLength"])))
-        {
-            PacketBuilder reply(PACKET_LOGIN, PACKET_REPLY, 2);
-            reply.AddShort(LOGIN_WRONG_USERPASS);
-            client->Send(reply);
-            return;
-        }
-
-        if (client->server()->world->characters.size() >= static_cast<std::size_t>(static_cast<int>(client->server()->world->config["MaxPlayers"])))
-        {
-            PacketBuilder reply(PACKET_LOGIN, PACKET_REPLY, 2);
-            reply.AddShort(LOGIN_BUSY);
-            client->Send(reply);
-            client->Close();
+        if (!client->Connected())
             return;
-        }
 
         LoginReply login_reply = client->server()->world->LoginCheck(username, std::move(password));
 
@@ -154,6 +109,67 @@ namespace Handlers
         client->Send(reply);
     }
 
+    void Login_Request(EOClient *client, PacketReader &reader)
+    {
+        std::string username = reader.GetBreakString();
+        util::secure_string password(std::move(reader.GetBreakString()));
+
+        // Ignore repeated requests while the last one is being hashed
+        if (client->server()->world->hash_pool.Pending(client))
+            return;
+
+        if (username.length() > std::size_t(int(client->server()->world->config["AccountMaxLength"]))
+         || password.str().length() > std::size_t(int(client->server()->world->config["PasswordMaxLength"])))
+        {
+            return;
+        }
+
+        username = util::lowercase(username);
+
+        if (client->server()->world->config["SeoseCompat"])
+            password = std::move(seose_str_hash(password.str(), client->server()->world->config["SeoseCompatKey"]));
+
+        if (client->server()->world->CheckBan(&username, 0, 0) != -1)
+        {
+            PacketBuilder reply(PACKET_F_INIT, PACKET_A_INIT, 2);
+            reply.AddByte(INIT_BANNED);
+            reply.AddByte(INIT_BAN_PERM);
+            client->Send(reply);
+            client->Close();
+            return;
+        }
+
+        if (username.length() < std::size_t(int(client->server()->world->config["AccountMinLength"])))
+        {
+            PacketBuilder reply(PACKET_LOGIN, PACKET_REPLY, 2);
+            reply.AddShort(LOGIN_WRONG_USER);
+            client->Send(reply);
+            return;
+        }
+
+        if (password.str().length() < std::size_t(int(client->server()->world->config["PasswordMinLength"])))
+        {
+            PacketBuilder reply(PACKET_LOGIN, PACKET_REPLY, 2);
+            reply.AddShort(LOGIN_WRONG_USERPASS);
+            client->Send(reply);
+            return;
+        }
+
+        if (client->server()->world->characters.size() >= static_cast<std::size_t>(static_cast<int>(client->server()->world->config["MaxPlayers"])))
+        {
+            PacketBuilder reply(PACKET_LOGIN, PACKET_REPLY, 2);
+            reply.AddShort(LOGIN_BUSY);
+            client->Send(reply);
+            client->Close();
+            return;
+        }
+
+        client->server()->world->HashPassword(client, username, std::move(password), [client, username](util::secure_string &&password)
+        {
+            Login_Hashed(client, username, std::move(password));
+        });
+    }
+
     PACKET_HANDLER_REGISTER(PACKET_LOGIN)
         Register(PACKET_REQUEST, Login_Request, Menu, 1.0);
     PACKET_HANDLER_REGISTER_END()
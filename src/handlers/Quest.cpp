@@ -102,7 +102,7 @@ namespace Handlers
                     builder.AddShort(446); // Quest ID
                     builder.AddBreakString(util::ucfirst(npc->name) + "'s Information");
                     builder.AddShort(1);
-                    builder.AddBreakString("Owner: " + util::ucfirst(npc->owner->SourceName()) + ", level: " + util::to_string(npc->level) + " (" + util::to_string(npc->rebirth) + "), experience: " + util::to_string(npc->exp) + "/" + util::to_string(character->world->exp_table[npc->level + 1]) + + ", health points: " + util::to_string(npc->hp) + "/" + util::to_string(npc->Data().hp) + ", technique points: " + util::to_string(npc->tp) + "/" + util::to_string(npc->maxtp) + ", damage: " + util::to_string(npc->Data().mindam + npc->mindam) + "-" + util::to_string(npc->Data().maxdam + int(character->world->config["NPCAdjustMaxDam"]) + npc->maxdam));
+                    builder.AddBreakString("Owner: " + util::ucfirst(npc->owner->SourceName()) + ", level: " + util::to_string(npc->level) + " (" + util::to_string(npc->rebirth) + "), experience: " + util::to_string(npc->exp) + "/" + util::to_string(character->world->exp_table[npc->level + 1]) + + ", health points: " + util::to_string(npc->hp) + "/" + util::to_string(npc->Data().hp) + ", technique points: " + util::to_string(npc->tp) + "/" + util::to_string(npc->maxtp) + ", damage: " + util::to_string(npc->Data().mindam + npc->mindam) + "-" + util::to_string(npc->Data().maxdam + character->world->hot_config.npc_adjust_max_dam + npc->maxdam));
 
                     if (character->HasPet && npc->owner == character)
                     {
@@ -331,6 +331,8 @@ namespace Handlers
                                 {
                                     if (victim->HasPet && victim->pet->id == victim->transfer_petid)
                                     {
+                                        victim->world->WaitForQueued("character:" + victim->SourceName());
+                                        victim->world->WaitForQueued("character:" + character->SourceName());
                                         Database_Result res = victim->world->db.Query("SELECT `npcid` FROM `pets` WHERE `owner_name` = '$' AND `npcid` = #", character->SourceName().c_str(), victim->pet->id);
 
                                         if (res.empty())
@@ -16,15 +16,15 @@ namespace Handlers
 
         if (character->npc_type == ENF::Shop)
         {
-            UTIL_FOREACH(character->npc->shop_craft, checkitem)
+            UTIL_FOREACH_CREF(character->npc->prototype->shop_craft, checkitem)
             {
-                if (checkitem->id == item)
+                if (checkitem.id == item)
                 {
                     bool hasitems = true;
 
-                    UTIL_FOREACH(checkitem->ingredients, ingredient)
+                    UTIL_FOREACH_CREF(checkitem.ingredients, ingredient)
                     {
-                        if (character->HasItem(ingredient->id) < ingredient->amount)
+                        if (character->HasItem(ingredient.id) < ingredient.amount)
                         {
                             hasitems = false;
                         }
@@ -32,17 +32,17 @@ namespace Handlers
 
                     if (hasitems)
                     {
-                        PacketBuilder reply(PACKET_SHOP, PACKET_CREATE, 4 + checkitem->ingredients.size() * 6);
+                        PacketBuilder reply(PACKET_SHOP, PACKET_CREATE, 4 + checkitem.ingredients.size() * 6);
                         reply.AddShort(item);
                         reply.AddChar(character->weight);
                         reply.AddChar(character->maxweight);
-                        UTIL_FOREACH(checkitem->ingredients, ingredient)
+                        UTIL_FOREACH_CREF(checkitem.ingredients, ingredient)
                         {
-                            character->DelItem(ingredient->id, ingredient->amount);
-                            reply.AddShort(ingredient->id);
-                            reply.AddInt(character->HasItem(ingredient->id));
+                            character->DelItem(ingredient.id, ingredient.amount);
+                            reply.AddShort(ingredient.id);
+                            reply.AddInt(character->HasItem(ingredient.id));
                         }
-                        character->AddItem(checkitem->id, 1);
+                        character->AddItem(checkitem.id, 1);
                         character->Send(reply);
                     }
                 }
@@ -62,13 +62,13 @@ namespace Handlers
 
         if (character->npc_type == ENF::Shop)
         {
-            UTIL_FOREACH(character->npc->shop_trade, checkitem)
+            UTIL_FOREACH_CREF(character->npc->prototype->shop_trade, checkitem)
             {
-                int cost = amount * checkitem->buy;
+                int cost = amount * checkitem.buy;
 
                 if (cost <= 0) return;
 
-                if (checkitem->id == item && checkitem->buy != 0 && character->HasItem(1) >= cost)
+                if (checkitem.id == item && checkitem.buy != 0 && character->HasItem(1) >= cost)
                 {
                     character->DelItem(1, cost);
                     character->AddItem(item, amount);
@@ -97,12 +97,12 @@ namespace Handlers
 
         if (character->npc_type == ENF::Shop)
         {
-            UTIL_FOREACH(character->npc->shop_trade, checkitem)
+            UTIL_FOREACH_CREF(character->npc->prototype->shop_trade, checkitem)
             {
-                if (checkitem->id == item && checkitem->sell != 0 && character->HasItem(item) >= amount)
+                if (checkitem.id == item && checkitem.sell != 0 && character->HasItem(item) >= amount)
                 {
                     character->DelItem(item, amount);
-                    character->AddItem(1, amount * checkitem->sell);
+                    character->AddItem(1, amount * checkitem.sell);
 
                     PacketBuilder reply(PACKET_SHOP, PACKET_SELL, 12);
                     reply.AddInt(character->HasItem(item));
@@ -124,35 +124,35 @@ namespace Handlers
 
         UTIL_FOREACH(character->map->npcs, npc)
         {
-            if (npc->index == id && (npc->shop_trade.size() > 0 || npc->shop_craft.size() > 0))
+            if (npc->index == id && (npc->prototype->shop_trade.size() > 0 || npc->prototype->shop_craft.size() > 0))
             {
                 character->npc = npc;
                 character->npc_type = ENF::Shop;
 
                 PacketBuilder reply(PACKET_SHOP, PACKET_OPEN,
-                    5 + npc->shop_name.length() + npc->shop_trade.size() * 9 + npc->shop_craft.size() * 14);
+                    5 + npc->prototype->shop_name.length() + npc->prototype->shop_trade.size() * 9 + npc->prototype->shop_craft.size() * 14);
                 reply.AddShort(npc->id);
-                reply.AddBreakString(npc->shop_name.c_str());
+                reply.AddBreakString(npc->prototype->shop_name.c_str());
 
-                UTIL_FOREACH(npc->shop_trade, item)
+                UTIL_FOREACH_CREF(npc->prototype->shop_trade, item)
                 {
-                    reply.AddShort(item->id);
-                    reply.AddThree(item->buy);
-                    reply.AddThree(item->sell);
+                    reply.AddShort(item.id);
+                    reply.AddThree(item.buy);
+                    reply.AddThree(item.sell);
                     reply.AddChar(static_cast<int>(character->world->config["MaxShopBuy"]));
                 }
                 reply.AddByte(255);
 
-                UTIL_FOREACH(npc->shop_craft, item)
+                UTIL_FOREACH_CREF(npc->prototype->shop_craft, item)
                 {
                     std::size_t i = 0;
 
-                    reply.AddShort(item->id);
+                    reply.AddShort(item.id);
 
-                    for (; i < item->ingredients.size(); ++i)
+                    for (; i < item.ingredients.size(); ++i)
                     {
-                        reply.AddShort(item->ingredients[i]->id);
-                        reply.AddChar(item->ingredients[i]->amount);
+                        reply.AddShort(item.ingredients[i].id);
+                        reply.AddChar(item.ingredients[i].amount);
                     }
 
                     for (; i < 4; ++i)
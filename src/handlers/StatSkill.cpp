@@ -13,31 +13,31 @@ namespace Handlers
 
         UTIL_FOREACH(character->map->npcs, npc)
         {
-            if (npc->index == id && npc->skill_learn.size() > 0)
+            if (npc->index == id && npc->prototype->skill_learn.size() > 0)
             {
                 character->npc = npc;
                 character->npc_type = ENF::Skills;
 
-                PacketBuilder reply(PACKET_STATSKILL, PACKET_OPEN, 2 + npc->skill_name.length() + npc->skill_name.size() * 28);
+                PacketBuilder reply(PACKET_STATSKILL, PACKET_OPEN, 2 + npc->prototype->skill_name.length() + npc->prototype->skill_name.size() * 28);
                 reply.AddShort(npc->id);
-                reply.AddBreakString(npc->skill_name.c_str());
+                reply.AddBreakString(npc->prototype->skill_name.c_str());
 
-                UTIL_FOREACH(npc->skill_learn, skill)
+                UTIL_FOREACH_CREF(npc->prototype->skill_learn, skill)
                 {
-                    reply.AddShort(skill->id);
-                    reply.AddChar(skill->levelreq);
-                    reply.AddChar(skill->classreq);
-                    reply.AddInt(skill->cost);
-                    reply.AddShort(skill->skillreq[0]);
-                    reply.AddShort(skill->skillreq[1]);
-                    reply.AddShort(skill->skillreq[2]);
-                    reply.AddShort(skill->skillreq[3]);
-                    reply.AddShort(skill->strreq);
-                    reply.AddShort(skill->wisreq);
-                    reply.AddShort(skill->intreq);
-                    reply.AddShort(skill->agireq);
-                    reply.AddShort(skill->conreq);
-                    reply.AddShort(skill->chareq);
+                    reply.AddShort(skill.id);
+                    reply.AddChar(skill.levelreq);
+                    reply.AddChar(skill.classreq);
+                    reply.AddInt(skill.cost);
+                    reply.AddShort(skill.skillreq[0]);
+                    reply.AddShort(skill.skillreq[1]);
+                    reply.AddShort(skill.skillreq[2]);
+                    reply.AddShort(skill.skillreq[3]);
+                    reply.AddShort(skill.strreq);
+                    reply.AddShort(skill.wisreq);
+                    reply.AddShort(skill.intreq);
+                    reply.AddShort(skill.agireq);
+                    reply.AddShort(skill.conreq);
+                    reply.AddShort(skill.chareq);
                 }
 
                 character->Send(reply);
@@ -59,14 +59,14 @@ namespace Handlers
 
         if (character->npc_type == ENF::Skills)
         {
-            UTIL_FOREACH(character->npc->skill_learn, spell)
+            UTIL_FOREACH_CREF(character->npc->prototype->skill_learn, spell)
             {
-                if (spell->id == spell_id)
+                if (spell.id == spell_id)
                 {
-                    if (character->level < spell->levelreq || character->HasItem(1) < spell->cost
-                    || character->display_str < spell->strreq || character->display_intl < spell->intreq
-                    || character->display_wis < spell->wisreq || character->display_agi < spell->agireq
-                    || character->display_con < spell->conreq || character->display_cha < spell->chareq)
+                    if (character->level < spell.levelreq || character->HasItem(1) < spell.cost
+                    || character->display_str < spell.strreq || character->display_intl < spell.intreq
+                    || character->display_wis < spell.wisreq || character->display_agi < spell.agireq
+                    || character->display_con < spell.conreq || character->display_cha < spell.chareq)
                     {
                         PacketBuilder reply(PACKET_STATSKILL, PACKET_REPLY, 4);
                         reply.AddShort(SKILLMASTER_WRONG_CLASS);
@@ -75,7 +75,7 @@ namespace Handlers
                         return;
                     }
 
-                    if (spell->classreq != 0 && character->clas != spell->classreq)
+                    if (spell.classreq != 0 && character->clas != spell.classreq)
                     {
                         PacketBuilder reply(PACKET_STATSKILL, PACKET_REPLY, 4);
                         reply.AddShort(SKILLMASTER_WRONG_CLASS);
@@ -84,7 +84,7 @@ namespace Handlers
                         return;
                     }
 
-                    UTIL_FOREACH(spell->skillreq, req)
+                    UTIL_FOREACH(spell.skillreq, req)
                     {
                         if (req != 0 && !character->HasSpell(req))
                         {
@@ -96,7 +96,7 @@ namespace Handlers
                         }
                     }
 
-                    character->DelItem(1, spell->cost);
+                    character->DelItem(1, spell.cost);
                     character->AddSpell(spell_id);
 
                     PacketBuilder reply(PACKET_STATSKILL, PACKET_TAKE, 6);
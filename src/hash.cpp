@@ -1,5 +1,14 @@
 #include "hash.hpp"
 
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+
+#include "util.hpp"
+
 extern "C"
 {
 #include "sha256.h"
@@ -23,3 +32,210 @@ std::string sha256(const std::string& str)
 
 	return std::string(cdigest, 64);
 }
+
+struct Hash_Pool::impl_
+{
+	std::vector<pthread_t> threads;
+	pthread_mutex_t mutex;
+
+	// Signalled when a job is queued or the threads are asked to stop
+	pthread_cond_t wake;
+};
+
+Hash_Pool::Hash_Pool()
+	: impl(new impl_)
+	, stopping(false)
+{
+	if (pthread_mutex_init(&this->impl->mutex, 0) != 0
+	 || pthread_cond_init(&this->impl->wake, 0) != 0)
+		throw std::runtime_error("Failed to initialize hash pool");
+}
+
+void Hash_Pool::Start(std::size_t threads)
+{
+	this->Stop();
+
+	this->stopping = false;
+
+	for (std::size_t i = 0; i < threads; ++i)
+	{
+		pthread_t thread;
+
+		if (pthread_create(&thread, 0, Hash_Pool::Run, this) != 0)
+		{
+			this->Stop();
+			throw std::runtime_error("Failed to create hash pool thread");
+		}
+
+		this->impl->threads.push_back(thread);
+	}
+}
+
+bool Hash_Pool::Running() const
+{
+	return !this->impl->threads.empty();
+}
+
+void *Hash_Pool::Run(void *void_pool)
+{
+	static_cast<Hash_Pool *>(void_pool)->Loop();
+	return 0;
+}
+
+void Hash_Pool::Loop()
+{
+	pthread_mutex_lock(&this->impl->mutex);
+
+	while (true)
+	{
+		while (this->queued.empty() && !this->stopping)
+			pthread_cond_wait(&this->impl->wake, &this->impl->mutex);
+
+		if (this->queued.empty())
+			break;
+
+		// Jobs are moved between lists by splicing, so it stays valid while unlocked
+		auto job = this->queued.begin();
+		this->running.splice(this->running.end(), this->queued, job);
+
+		pthread_mutex_unlock(&this->impl->mutex);
+
+		job->function(job->password);
+
+		pthread_mutex_lock(&this->impl->mutex);
+
+		if (job->cancelled)
+			this->discarded.splice(this->discarded.end(), this->running, job);
+		else
+			this->completed.splice(this->completed.end(), this->running, job);
+	}
+
+	pthread_mutex_unlock(&this->impl->mutex);
+}
+
+void Hash_Pool::Queue(const void *owner, util::secure_string &&password, Function function, Callback callback)
+{
+	if (!this->Running())
+	{
+		function(password);
+		callback(std::move(password));
+		return;
+	}
+
+	std::list<Job> job(1);
+	job.front().owner = owner;
+	job.front().password = std::move(password);
+	job.front().function = std::move(function);
+	job.front().callback = std::move(callback);
+
+	pthread_mutex_lock(&this->impl->mutex);
+	this->queued.splice(this->queued.end(), job);
+	pthread_cond_signal(&this->impl->wake);
+	pthread_mutex_unlock(&this->impl->mutex);
+}
+
+void Hash_Pool::Cancel(const void *owner)
+{
+	// Destroyed after unlocking, in case a callback's captures lead back here
+	std::list<Job> removed;
+
+	pthread_mutex_lock(&this->impl->mutex);
+
+	for (std::list<Job> *jobs : {&this->queued, &this->completed})
+	{
+		for (auto it = jobs->begin(); it != jobs->end(); )
+		{
+			auto next = std::next(it);
+
+			if (it->owner == owner)
+				removed.splice(removed.end(), *jobs, it);
+
+			it = next;
+		}
+	}
+
+	UTIL_FOREACH_REF(this->running, job)
+	{
+		if (job.owner == owner)
+			job.cancelled = true;
+	}
+
+	pthread_mutex_unlock(&this->impl->mutex);
+}
+
+bool Hash_Pool::Pending(const void *owner)
+{
+	bool pending = false;
+
+	pthread_mutex_lock(&this->impl->mutex);
+
+	for (std::list<Job> *jobs : {&this->queued, &this->running, &this->completed})
+	{
+		UTIL_FOREACH_CREF(*jobs, job)
+		{
+			if (job.owner == owner && !job.cancelled)
+				pending = true;
+		}
+	}
+
+	pthread_mutex_unlock(&this->impl->mutex);
+
+	return pending;
+}
+
+void Hash_Pool::Poll()
+{
+	std::list<Job> discarded;
+
+	pthread_mutex_lock(&this->impl->mutex);
+	discarded.swap(this->discarded);
+	pthread_mutex_unlock(&this->impl->mutex);
+
+	discarded.clear();
+
+	// Taken one at a time, so a callback can still Cancel() the jobs after it
+	while (true)
+	{
+		std::list<Job> job;
+
+		pthread_mutex_lock(&this->impl->mutex);
+
+		if (!this->completed.empty())
+			job.splice(job.end(), this->completed, this->completed.begin());
+
+		pthread_mutex_unlock(&this->impl->mutex);
+
+		if (job.empty())
+			break;
+
+		job.front().callback(std::move(job.front().password));
+	}
+}
+
+void Hash_Pool::Stop()
+{
+	if (!this->Running())
+		return;
+
+	pthread_mutex_lock(&this->impl->mutex);
+	this->stopping = true;
+	pthread_cond_broadcast(&this->impl->wake);
+	pthread_mutex_unlock(&this->impl->mutex);
+
+	UTIL_FOREACH(this->impl->threads, thread)
+	{
+		pthread_join(thread, 0);
+	}
+
+	this->impl->threads.clear();
+	this->completed.clear();
+	this->discarded.clear();
+}
+
+Hash_Pool::~Hash_Pool()
+{
+	this->Stop();
+
+	pthread_cond_destroy(&this->impl->wake);
+	pthread_mutex_destroy(&this->impl->mutex);
+}
@@ -1,11 +1,102 @@
 #ifndef HASH_HPP_INCLUDED
 #define HASH_HPP_INCLUDED
 
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
 #include <string>
 
+#include "util/secure_string.hpp"
+
 /**
  * Convert a string to the hex representation of it's sha256 hash
  */
 std::string sha256(const std::string&);
 
+/**
+ * Pool of threads for hashing passwords away from the thread handling clients
+ */
+class Hash_Pool
+{
+	public:
+		/**
+		 * Replaces a password with its hash, run on one of the pool's threads
+		 */
+		typedef std::function<void(util::secure_string &)> Function;
+
+		/**
+		 * Called from Poll() with the hashed password
+		 */
+		typedef std::function<void(util::secure_string &&)> Callback;
+
+	protected:
+		struct impl_;
+
+		std::unique_ptr<impl_> impl;
+
+		struct Job
+		{
+			const void *owner;
+			bool cancelled;
+			util::secure_string password;
+			Function function;
+			Callback callback;
+
+			Job() : owner(0), cancelled(false), password(std::string()) { }
+		};
+
+		// All guarded by impl->mutex
+		std::list<Job> queued;
+		std::list<Job> running;
+		std::list<Job> completed;
+
+		// Cancelled while running, kept for Poll() to destroy as their callbacks may own game objects
+		std::list<Job> discarded;
+
+		bool stopping;
+
+		static void *Run(void *);
+		void Loop();
+
+	public:
+		Hash_Pool();
+
+		/**
+		 * Starts the pool's threads, with no threads every job is run straight away by Queue()
+		 * @throw std::runtime_error
+		 */
+		void Start(std::size_t threads);
+
+		bool Running() const;
+
+		/**
+		 * Hashes a password on the pool, calling callback from the next Poll() after it's done
+		 * @param owner Anything identifying what the callback refers to, for Cancel()
+		 */
+		void Queue(const void *owner, util::secure_string &&password, Function function, Callback callback);
+
+		/**
+		 * Drops every job queued by an owner, so its callbacks are never called
+		 */
+		void Cancel(const void *owner);
+
+		/**
+		 * Whether an owner has a job that hasn't had its callback called yet
+		 */
+		bool Pending(const void *owner);
+
+		/**
+		 * Calls the callbacks of finished jobs, should be called regularly by the thread queueing them
+		 */
+		void Poll();
+
+		/**
+		 * Finishes any queued jobs and stops the threads, discarding their callbacks
+		 */
+		void Stop();
+
+		~Hash_Pool();
+};
+
 #endif
@@ -0,0 +1,489 @@
+#include "journal.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include <pthread.h>
+
+#include "platform.h"
+
+#ifdef WIN32
+#include <io.h>
+#else // WIN32
+#include <unistd.h>
+#endif // WIN32
+
+#include "console.hpp"
+#include "util.hpp"
+
+struct Journal::impl_
+{
+	pthread_t thread;
+	pthread_mutex_t mutex;
+
+	// Signalled when frames are flushed or the writer is asked to stop
+	pthread_cond_t wake;
+
+	// Signalled when every flushed frame has been written
+	pthread_cond_t idle;
+};
+
+// Frames are a 4 byte length and 4 byte checksum followed by that many bytes of records
+static const std::size_t journal_frame_header = 8;
+
+// Anything larger is assumed to be a corrupt length
+static const std::size_t journal_frame_max = 64 * 1024 * 1024;
+
+static void journal_put(std::string &data, unsigned int value, std::size_t bytes)
+{
+	for (std::size_t i = 0; i < bytes; ++i)
+		data += char((value >> (i * 8)) & 0xFF);
+}
+
+static unsigned int journal_get(const std::string &data, std::size_t pos, std::size_t bytes)
+{
+	unsigned int value = 0;
+
+	for (std::size_t i = 0; i < bytes; ++i)
+		value |= (unsigned int)(unsigned char)data[pos + i] << (i * 8);
+
+	return value;
+}
+
+// FNV-1a, enough to tell a frame that was cut off by a crash from a whole one
+static unsigned int journal_checksum(const std::string &data)
+{
+	unsigned int hash = 2166136261u;
+
+	UTIL_FOREACH(data, c)
+	{
+		hash ^= (unsigned char)c;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static bool journal_sync(std::FILE *file)
+{
+	if (std::fflush(file) != 0)
+		return false;
+
+#ifdef WIN32
+	return _commit(_fileno(file)) == 0;
+#else // WIN32
+	return fsync(fileno(file)) == 0;
+#endif // WIN32
+}
+
+static bool journal_exists(const std::string &filename)
+{
+	std::FILE *file = std::fopen(filename.c_str(), "rb");
+
+	if (!file)
+		return false;
+
+	std::fclose(file);
+	return true;
+}
+
+static bool journal_append_file(const std::string &from, const std::string &to)
+{
+	std::FILE *in = std::fopen(from.c_str(), "rb");
+
+	if (!in)
+		return false;
+
+	std::FILE *out = std::fopen(to.c_str(), "ab");
+
+	if (!out)
+	{
+		std::fclose(in);
+		return false;
+	}
+
+	char buf[4096];
+	std::size_t read;
+	bool ok = true;
+
+	while (ok && (read = std::fread(buf, 1, sizeof(buf), in)) > 0)
+		ok = std::fwrite(buf, 1, read, out) == read;
+
+	ok = ok && !std::ferror(in) && journal_sync(out);
+
+	std::fclose(in);
+	std::fclose(out);
+
+	return ok;
+}
+
+// Parses the records of one frame, returning false if any are malformed
+static bool journal_parse(const std::string &payload, std::vector<Journal::Record> &records)
+{
+	std::size_t pos = 0;
+
+	while (pos < payload.length())
+	{
+		Journal::Record record;
+
+		if (payload.length() - pos < 2)
+			return false;
+
+		record.type = Journal::RecordType((unsigned char)payload[pos]);
+		std::size_t name_length = (unsigned char)payload[pos + 1];
+		pos += 2;
+
+		if (payload.length() - pos < name_length + 2)
+			return false;
+
+		record.name = payload.substr(pos, name_length);
+		pos += name_length;
+
+		std::size_t count = journal_get(payload, pos, 2);
+		pos += 2;
+
+		if (payload.length() - pos < count * 4)
+			return false;
+
+		record.values.reserve(count);
+
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			record.values.push_back(int(journal_get(payload, pos, 4)));
+			pos += 4;
+		}
+
+		records.push_back(std::move(record));
+	}
+
+	return true;
+}
+
+Journal::Journal()
+	: impl(new impl_)
+	, file(0)
+	, flushed(0)
+	, written(0)
+	, running(false)
+	, stopping(false)
+	, busy(false)
+	, failed(false)
+{
+	if (pthread_mutex_init(&this->impl->mutex, 0) != 0
+	 || pthread_cond_init(&this->impl->wake, 0) != 0
+	 || pthread_cond_init(&this->impl->idle, 0) != 0)
+		throw std::runtime_error("Failed to initialize journal");
+}
+
+void Journal::Open(const std::string &filename)
+{
+	if (this->running)
+		this->Close();
+
+	this->file = std::fopen(filename.c_str(), "wb");
+
+	if (!this->file)
+		throw std::runtime_error("Failed to open journal " + filename);
+
+	this->filename = filename;
+	this->stopping = false;
+	this->failed = false;
+
+	if (pthread_create(&this->impl->thread, 0, Journal::Run, this) != 0)
+	{
+		std::fclose(this->file);
+		this->file = 0;
+		throw std::runtime_error("Failed to create journal thread");
+	}
+
+	this->running = true;
+}
+
+bool Journal::IsOpen() const
+{
+	return this->running;
+}
+
+void *Journal::Run(void *void_journal)
+{
+	static_cast<Journal *>(void_journal)->Loop();
+	return 0;
+}
+
+void Journal::Loop()
+{
+	std::deque<std::string> batch;
+
+	pthread_mutex_lock(&this->impl->mutex);
+
+	while (true)
+	{
+		while (this->frames.empty() && !this->stopping)
+			pthread_cond_wait(&this->impl->wake, &this->impl->mutex);
+
+		if (this->frames.empty())
+			break;
+
+		batch.swap(this->frames);
+		std::size_t batch_size = batch.size();
+		this->busy = true;
+
+		pthread_mutex_unlock(&this->impl->mutex);
+
+		bool ok = true;
+
+		UTIL_FOREACH_CREF(batch, frame)
+		{
+			ok = ok && std::fwrite(frame.data(), 1, frame.length(), this->file) == frame.length();
+		}
+
+		ok = ok && journal_sync(this->file);
+
+		batch.clear();
+
+		if (!ok && !this->failed)
+			Console::Err("Failed to write to journal %s", this->filename.c_str());
+
+		this->failed = this->failed || !ok;
+
+		pthread_mutex_lock(&this->impl->mutex);
+
+		// Counted even if writing failed, as nothing waiting on them could ever be let through otherwise
+		this->written += batch_size;
+		this->busy = false;
+
+		pthread_cond_broadcast(&this->impl->idle);
+	}
+
+	pthread_mutex_unlock(&this->impl->mutex);
+}
+
+void Journal::WaitIdle()
+{
+	while (!this->frames.empty() || this->busy)
+		pthread_cond_wait(&this->impl->idle, &this->impl->mutex);
+}
+
+void Journal::WaitWritten(std::size_t frames)
+{
+	pthread_mutex_lock(&this->impl->mutex);
+
+	while (this->written < frames && this->running)
+		pthread_cond_wait(&this->impl->idle, &this->impl->mutex);
+
+	pthread_mutex_unlock(&this->impl->mutex);
+}
+
+void Journal::Append(const Record &record)
+{
+	if (!this->running)
+		return;
+
+	std::size_t name_length = std::min<std::size_t>(record.name.length(), 255);
+	std::size_t count = std::min<std::size_t>(record.values.size(), 65535);
+
+	this->buffer += char(record.type);
+	this->buffer += char(name_length);
+	this->buffer.append(record.name, 0, name_length);
+	journal_put(this->buffer, count, 2);
+
+	for (std::size_t i = 0; i < count; ++i)
+		journal_put(this->buffer, (unsigned int)record.values[i], 4);
+}
+
+std::size_t Journal::Flush()
+{
+	if (!this->running || this->buffer.empty())
+		return this->flushed;
+
+	std::string frame;
+	frame.reserve(journal_frame_header + this->buffer.length());
+	journal_put(frame, this->buffer.length(), 4);
+	journal_put(frame, journal_checksum(this->buffer), 4);
+	frame += this->buffer;
+
+	this->buffer.clear();
+
+	pthread_mutex_lock(&this->impl->mutex);
+	this->frames.push_back(std::move(frame));
+	pthread_cond_signal(&this->impl->wake);
+	pthread_mutex_unlock(&this->impl->mutex);
+
+	return ++this->flushed;
+}
+
+void Journal::Sync()
+{
+	if (!this->running)
+		return;
+
+	this->Flush();
+
+	pthread_mutex_lock(&this->impl->mutex);
+	this->WaitIdle();
+	pthread_mutex_unlock(&this->impl->mutex);
+}
+
+bool Journal::Rotate()
+{
+	if (!this->running)
+		return false;
+
+	this->Flush();
+
+	std::string old_filename = this->filename + ".old";
+
+	// The writer thread can't pick up another frame until the mutex is released
+	pthread_mutex_lock(&this->impl->mutex);
+	this->WaitIdle();
+
+	std::fclose(this->file);
+
+	bool existed = journal_exists(old_filename);
+	bool moved;
+
+	if (existed)
+		moved = journal_append_file(this->filename, old_filename);
+	else
+		moved = std::rename(this->filename.c_str(), old_filename.c_str()) == 0;
+
+	if (moved)
+	{
+		this->file = std::fopen(this->filename.c_str(), "wb");
+	}
+	else
+	{
+		Console::Err("Failed to rotate journal %s", this->filename.c_str());
+		this->file = std::fopen(this->filename.c_str(), "ab");
+	}
+
+	if (!this->file)
+	{
+		Console::Err("Failed to reopen journal %s, journalling has stopped", this->filename.c_str());
+
+		// Nothing can be written from here on, so stop the writer without touching the file again
+		this->stopping = true;
+		pthread_cond_signal(&this->impl->wake);
+		pthread_mutex_unlock(&this->impl->mutex);
+
+		pthread_join(this->impl->thread, 0);
+		this->running = false;
+
+		return existed;
+	}
+
+	pthread_mutex_unlock(&this->impl->mutex);
+
+	return existed;
+}
+
+void Journal::Checkpoint()
+{
+	if (this->filename.empty())
+		return;
+
+	std::remove((this->filename + ".old").c_str());
+}
+
+void Journal::Close()
+{
+	if (!this->running)
+		return;
+
+	this->Flush();
+
+	pthread_mutex_lock(&this->impl->mutex);
+	this->stopping = true;
+	pthread_cond_signal(&this->impl->wake);
+	pthread_mutex_unlock(&this->impl->mutex);
+
+	pthread_join(this->impl->thread, 0);
+
+	this->running = false;
+
+	if (this->file)
+	{
+		std::fclose(this->file);
+		this->file = 0;
+	}
+}
+
+void Journal::Discard()
+{
+	this->Close();
+	this->buffer.clear();
+
+	if (!this->filename.empty())
+		Journal::Remove(this->filename);
+}
+
+std::size_t Journal::Read(const std::string &filename, std::function<void(const Record &)> callback)
+{
+	std::size_t count = 0;
+	std::string filenames[2] = {filename + ".old", filename};
+
+	UTIL_FOREACH_CREF(filenames, name)
+	{
+		std::FILE *file = std::fopen(name.c_str(), "rb");
+
+		if (!file)
+			continue;
+
+		std::string header(journal_frame_header, '\0');
+		std::string payload;
+		std::vector<Record> records;
+
+		while (true)
+		{
+			std::size_t read = std::fread(&header[0], 1, journal_frame_header, file);
+
+			if (read == 0)
+				break;
+
+			std::size_t length = journal_get(header, 0, 4);
+			bool intact = (read == journal_frame_header && length <= journal_frame_max);
+
+			if (intact)
+			{
+				payload.resize(length);
+				intact = std::fread(&payload[0], 1, length, file) == length
+				      && journal_checksum(payload) == journal_get(header, 4, 4);
+			}
+
+			records.clear();
+
+			if (!intact || !journal_parse(payload, records))
+			{
+				Console::Wrn("Journal %s ends with an incomplete frame, ignoring the rest of it", name.c_str());
+				break;
+			}
+
+			UTIL_FOREACH_CREF(records, record)
+			{
+				callback(record);
+			}
+
+			count += records.size();
+		}
+
+		std::fclose(file);
+	}
+
+	return count;
+}
+
+void Journal::Remove(const std::string &filename)
+{
+	std::remove(filename.c_str());
+	std::remove((filename + ".old").c_str());
+}
+
+Journal::~Journal()
+{
+	this->Close();
+
+	pthread_cond_destroy(&this->impl->idle);
+	pthread_cond_destroy(&this->impl->wake);
+	pthread_mutex_destroy(&this->impl->mutex);
+}
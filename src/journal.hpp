@@ -0,0 +1,150 @@
+#ifndef JOURNAL_HPP_INCLUDED
+#define JOURNAL_HPP_INCLUDED
+
+#include "fwd/journal.hpp"
+
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Append-only log of changes made to characters since they were last saved,
+ * replayed against the database after a crash.
+ *
+ * Records are buffered by Append() and written out by a background thread,
+ * one frame per Flush() and one fsync per batch of frames. The current file
+ * is closed off to <filename>.old by Rotate() and removed by Checkpoint()
+ * once the saves made at that point have been committed.
+ */
+class Journal
+{
+	public:
+		enum RecordType : unsigned char
+		{
+			// map, x, y, direction
+			Position = 1,
+
+			// level, exp, statpoints, skillpoints
+			Progress = 2,
+
+			// goldbank
+			GoldBank = 3,
+
+			// pairs of (item id, amount), an amount of 0 removes the item
+			Inventory = 4,
+			Bank = 5,
+
+			// the item id in each of the 15 paperdoll slots
+			Paperdoll = 6
+		};
+
+		struct Record
+		{
+			RecordType type;
+			std::string name;
+			std::vector<int> values;
+		};
+
+	protected:
+		struct impl_;
+
+		std::unique_ptr<impl_> impl;
+
+		std::string filename;
+
+		// Written to by the writer thread only, closed and reopened by Rotate() while it's idle
+		std::FILE *file;
+
+		// Records appended since the last Flush()
+		std::string buffer;
+
+		// Number of frames handed to the writer thread, only touched by the thread calling Flush()
+		std::size_t flushed;
+
+		// Guarded by impl->mutex
+		std::deque<std::string> frames;
+		std::size_t written;
+		bool running;
+		bool stopping;
+		bool busy;
+
+		// Only touched by the writer thread, so a failing disk is reported once
+		bool failed;
+
+		static void *Run(void *);
+		void Loop();
+
+		// Blocks until every flushed frame has been written, with impl->mutex held
+		void WaitIdle();
+
+	public:
+		Journal();
+
+		/**
+		 * Truncates or creates the journal file and starts the writer thread
+		 * @throw std::runtime_error
+		 */
+		void Open(const std::string &filename);
+
+		bool IsOpen() const;
+
+		void Append(const Record &record);
+
+		/**
+		 * Hands the records appended so far to the writer thread as one frame
+		 * @return Number of frames flushed so far, for WaitWritten()
+		 */
+		std::size_t Flush();
+
+		/**
+		 * Blocks until the first frames frames flushed are on disk, or the writer has stopped.
+		 * Safe to call from any thread.
+		 */
+		void WaitWritten(std::size_t frames);
+
+		/**
+		 * Flushes and blocks until everything appended is on disk
+		 */
+		void Sync();
+
+		/**
+		 * Syncs and moves the current file's contents to <filename>.old, appending them
+		 * if it still exists from an earlier rotation that was never checkpointed
+		 * @return true if <filename>.old already existed
+		 */
+		bool Rotate();
+
+		/**
+		 * Removes <filename>.old, to be called once every save made before the last Rotate() is committed
+		 */
+		void Checkpoint();
+
+		/**
+		 * Syncs and stops the writer thread, leaving the files in place
+		 */
+		void Close();
+
+		/**
+		 * Closes the journal and removes its files
+		 */
+		void Discard();
+
+		/**
+		 * Reads every intact record from <filename>.old and then <filename>, oldest first.
+		 * Reading a file stops at the first frame that was only partly written.
+		 * @return Number of records read
+		 */
+		static std::size_t Read(const std::string &filename, std::function<void(const Record &)> callback);
+
+		/**
+		 * Removes <filename> and <filename>.old
+		 */
+		static void Remove(const std::string &filename);
+
+		~Journal();
+};
+
+#endif // JOURNAL_HPP_INCLUDED
@@ -386,6 +386,11 @@ Map::Map(int id, World *world)
 	this->jukebox_protect = 0.0;
 	this->arena = 0;
 	this->evacuate_lock = false;
+	this->width = 0;
+	this->height = 0;
+	this->acting_npc = 0;
+
+	this->ResetGrid();
 
 	this->LoadArena();
 
@@ -570,6 +575,13 @@ bool Map::Load()
     this->effect = PacketProcessor::Number(buf[0]);
 
 	this->tiles.resize(this->height * this->width);
+	this->player_walkable.assign(this->tiles.size(), true);
+	this->npc_walkable.assign(this->tiles.size(), true);
+	this->warp_tiles.assign(this->tiles.size(), false);
+	this->warps.clear();
+
+	this->ResetGrid();
+	this->flow_fields.clear();
 
 	SAFE_SEEK(fh, 0x2A, SEEK_SET);
 	SAFE_READ(buf, sizeof(char), 3, fh);
@@ -630,7 +642,12 @@ bool Map::Load()
 				continue;
 			}
 
-			this->GetTile(xloc, yloc).tilespec = static_cast<Map_Tile::TileSpec>(spec);
+			Map_Tile &tile = this->GetTile(xloc, yloc);
+			int index = yloc * this->width + xloc;
+
+			tile.tilespec = static_cast<Map_Tile::TileSpec>(spec);
+			this->player_walkable[index] = tile.Walkable(false);
+			this->npc_walkable[index] = tile.Walkable(true) && !this->warp_tiles[index];
 
 			if (spec == Map_Tile::Chest)
 			{
@@ -669,16 +686,11 @@ bool Map::Load()
 				continue;
 			}
 
-			try
-			{
-				this->GetTile(xloc, yloc).warp = newwarp;
-			}
-			catch (...)
-			{
-				std::fclose(fh);
-				safe_fail(__LINE__);
-				return false;
-			}
+			int index = yloc * this->width + xloc;
+
+			this->warps[index] = newwarp;
+			this->warp_tiles[index] = true;
+			this->npc_walkable[index] = false;
 		}
 	}
 
@@ -710,7 +722,7 @@ bool Map::Load()
 			}
 
 			NPC *newnpc = new NPC(this, npc_id, x, y, spawntype, spawntime, index++);
-			this->npcs.push_back(newnpc);
+			this->AddNPC(newnpc);
 
 			newnpc->Spawn();
 		}
@@ -790,45 +802,49 @@ void Map::Unload()
 	}
 
 	this->npcs.clear();
+	this->npc_indexes.clear();
 
 	this->chests.clear();
 	this->tiles.clear();
+	this->player_walkable.clear();
+	this->npc_walkable.clear();
+	this->warp_tiles.clear();
+	this->warps.clear();
+
+	this->ResetGrid();
+	this->flow_fields.clear();
 }
 
 int Map::GenerateItemID() const
 {
-	int lowest_free_id = 1;
-
-	restart_loop:
+	return this->item_uids.lowest();
+}
 
-	UTIL_FOREACH(this->items, item)
-	{
-		if (item->uid == lowest_free_id)
-		{
-			lowest_free_id = item->uid + 1;
-			goto restart_loop;
-		}
-	}
+unsigned char Map::GenerateNPCIndex() const
+{
+	return std::min<std::size_t>(this->npc_indexes.lowest(), 255);
+}
 
-	return lowest_free_id;
+void Map::AddNPC(NPC *npc)
+{
+	this->npcs.push_back(npc);
+	this->npc_indexes.take(npc->index);
 }
 
-unsigned char Map::GenerateNPCIndex() const
+void Map::RemoveNPC(NPC *npc)
 {
-	unsigned char lowest_free_id = 1;
+	auto it = std::find(UTIL_RANGE(this->npcs), npc);
 
-	restart_loop:
+	if (it == this->npcs.end())
+		return;
 
-	UTIL_FOREACH(this->npcs, npc)
-	{
-		if (npc->index == lowest_free_id)
-		{
-			lowest_free_id = npc->index + 1;
-			goto restart_loop;
-		}
-	}
+	this->npcs.erase(it);
+	this->GridRemove(npc);
+	this->UnscheduleNPC(npc);
 
-	return lowest_free_id;
+	// Maps loaded with more than 256 NPCs reuse indexes, so only free one nobody else has
+	if (std::find_if(UTIL_RANGE(this->npcs), [&](NPC *other) { return other->index == npc->index; }) == this->npcs.end())
+		this->npc_indexes.release(npc->index);
 }
 
 void Map::Immune()
@@ -926,7 +942,13 @@ void Map::DrainTP(Character *from)
 void Map::Enter(Character *character, WarpAnimation animation)
 {
 	this->characters.push_back(character);
+
+	if (this->characters.size() == 1)
+		this->WakeNPCs();
+
 	character->map = this;
+	this->GridUpdate(character);
+	this->UpdateView(character);
 	character->last_walk = Timer::GetTime();
 	character->attacks = 0;
 	character->CancelSpell();
@@ -1027,6 +1049,11 @@ void Map::Leave(Character *character, WarpAnimation animation, bool silent)
 	}
 
     this->characters.erase(std::remove(UTIL_RANGE(this->characters), character), this->characters.end());
+	this->GridRemove(character);
+	this->ClearView(character);
+
+	if (this->characters.empty())
+		this->SleepNPCs();
 
 	character->map = 0;
 }
@@ -1039,17 +1066,17 @@ void Map::Msg(Character *from, std::string message, bool echo)
 	builder.AddShort(from->player->id);
 	builder.AddString(message);
 
-	UTIL_FOREACH(this->characters, character)
-	{
-		if (!from->InRange(character))
- 			continue;
+	PacketBroadcast packet(builder);
 
-        character->AddChatLog("", from->SourceName(), message);
+	from->AddChatLog("", from->SourceName(), message);
 
-		if (!echo && character == from)
-			continue;
+	if (echo)
+		from->Send(packet);
 
-		character->Send(builder);
+	UTIL_FOREACH(from->in_view, character)
+	{
+        character->AddChatLog("", from->SourceName(), message);
+		character->Send(packet);
 	}
 }
 
@@ -1072,7 +1099,7 @@ void Map::Msg(NPC *from, std::string message)
 
 bool Map::Walk(Character *from, Direction direction, bool admin)
 {
-	int seedistance = this->world->config["SeeDistance"];
+	int seedistance = this->world->hot_config.see_distance;
 
 	unsigned char target_x = from->x;
 	unsigned char target_y = from->y;
@@ -1120,21 +1147,12 @@ bool Map::Walk(Character *from, Direction direction, bool admin)
 		if (!this->Walkable(target_x, target_y))
 			return false;
 
-		if (this->Occupied(target_x, target_y, PlayerOnly) && (from->last_walk + double(this->world->config["GhostTimer"]) > Timer::GetTime()))
+		if (this->Occupied(target_x, target_y, PlayerOnly) && (from->last_walk + this->world->hot_config.ghost_timer > Timer::GetTime()))
 			return false;
 	}
 
 	const Map_Warp& warp = this->GetWarp(target_x, target_y);
 
-	if (!admin)
-	{
-		if (!this->Walkable(target_x, target_y))
-			return false;
-
-		if (this->Occupied(target_x, target_y, PlayerOnly) && (from->last_walk + double(this->world->config["GhostTimer"]) > Timer::GetTime()))
-			return false;
-	}
-
 	if (warp)
 	{
 		if (from->level >= warp.levelreq && (warp.spec == Map_Warp::NoDoor || warp.open))
@@ -1166,6 +1184,7 @@ bool Map::Walk(Character *from, Direction direction, bool admin)
 
 	from->x = target_x;
 	from->y = target_y;
+	this->GridUpdate(from);
 
 	int newx;
 	int newy;
@@ -1236,25 +1255,10 @@ bool Map::Walk(Character *from, Direction direction, bool admin)
         break;
 	}
 
-	UTIL_FOREACH(this->characters, checkchar)
-	{
-		if (checkchar == from)
-			continue;
-
-		for (std::size_t i = 0; i < oldcoords.size(); ++i)
-		{
-			if (checkchar->x == oldcoords[i].first && checkchar->y == oldcoords[i].second)
-			{
-				oldchars.push_back(checkchar);
-			}
-			else if (checkchar->x == newcoords[i].first && checkchar->y == newcoords[i].second)
-			{
-				adj_chars.push_back(checkchar);
-			}
-		}
-	}
+	this->UpdateView(from, &adj_chars, &oldchars);
 
-	UTIL_FOREACH(this->npcs, checknpc)
+	// Both the old and new edges of the view are exactly one step further than seedistance
+	UTIL_FOREACH(this->NPCsInRange(from->x, from->y, std::min(seedistance + 1, 255)), checknpc)
 	{
 		if (!checknpc->alive)
 			continue;
@@ -1423,17 +1427,14 @@ bool Map::Walk(Character *from, Direction direction, bool admin)
 	builder.AddChar(from->x);
 	builder.AddChar(from->y);
 
-	UTIL_FOREACH(this->characters, character)
-	{
-		if (character == from || !from->InRange(character))
-		{
-			continue;
-		}
+	PacketBroadcast packet(builder);
 
+	UTIL_FOREACH(from->in_view, character)
+	{
 		if (!from->hidden)
-            character->player->client->Send(builder);
-        else if ((from->hidden && character->admin >= static_cast<int>(this->world->admin_config["seehide"])) || from == character)
-            character->player->client->Send(builder);
+            character->player->client->Send(packet);
+        else if (character->admin >= static_cast<int>(this->world->admin_config["seehide"]))
+            character->player->client->Send(packet);
 	}
 
 	builder.Reset(2 + newitems.size() * 9);
@@ -1481,7 +1482,7 @@ bool Map::Walk(Character *from, Direction direction, bool admin)
 
 bool Map::Walk(NPC *from, Direction direction)
 {
-	int seedistance = this->world->config["SeeDistance"];
+	int seedistance = this->world->hot_config.see_distance;
 
 	unsigned char target_x = from->x;
 	unsigned char target_y = from->y;
@@ -1537,6 +1538,7 @@ bool Map::Walk(NPC *from, Direction direction)
 
 	from->x = target_x;
 	from->y = target_y;
+	this->GridUpdate(from);
 
 	int newx;
 	int newy;
@@ -1606,7 +1608,7 @@ bool Map::Walk(NPC *from, Direction direction)
 
 	from->direction = direction;
 
-	UTIL_FOREACH(this->characters, checkchar)
+	UTIL_FOREACH(this->CharactersInRange(from->x, from->y, std::min(seedistance + 1, 255)), checkchar)
 	{
 		for (std::size_t i = 0; i < oldcoords.size(); ++i)
 		{
@@ -1735,15 +1737,14 @@ void Map::Attack(Character *from, Direction direction)
 	builder.AddShort(from->player->id);
 	builder.AddChar(direction);
 
-	UTIL_FOREACH(this->characters, character)
-	{
-		if (character == from || !from->InRange(character))
-			continue;
+	PacketBroadcast packet(builder);
 
+	UTIL_FOREACH(from->in_view, character)
+	{
 		if (!from->hidden)
-		    character->player->client->Send(builder);
-        else if ((from->hidden && character->admin >= static_cast<int>(this->world->admin_config["seehide"])) || from == character)
-            character->player->client->Send(builder);
+		    character->player->client->Send(packet);
+        else if (character->admin >= static_cast<int>(this->world->admin_config["seehide"]))
+            character->player->client->Send(packet);
 	}
 
 	if (is_instrument)
@@ -2549,14 +2550,11 @@ void Map::Face(Character *from, Direction direction)
 	builder.AddShort(from->player->id);
 	builder.AddChar(direction);
 
-	UTIL_FOREACH(this->characters, character)
-	{
-		if (character == from || !from->InRange(character))
-		{
-			continue;
-		}
+	PacketBroadcast packet(builder);
 
-		character->Send(builder);
+	UTIL_FOREACH(from->in_view, character)
+	{
+		character->Send(packet);
 	}
 }
 
@@ -2573,14 +2571,11 @@ void Map::Sit(Character *from, SitState sit_type)
 	builder.AddChar(from->direction);
 	builder.AddChar(0);
 
-	UTIL_FOREACH(this->characters, character)
-	{
-		if (character == from || !from->InRange(character))
-		{
-			continue;
-		}
+	PacketBroadcast packet(builder);
 
-		character->Send(builder);
+	UTIL_FOREACH(from->in_view, character)
+	{
+		character->Send(packet);
 	}
 }
 
@@ -2595,14 +2590,11 @@ void Map::Stand(Character *from)
 	builder.AddChar(from->x);
 	builder.AddChar(from->y);
 
-	UTIL_FOREACH(this->characters, character)
-	{
-		if (character == from || !from->InRange(character))
-		{
-			continue;
-		}
+	PacketBroadcast packet(builder);
 
-		character->Send(builder);
+	UTIL_FOREACH(from->in_view, character)
+	{
+		character->Send(packet);
 	}
 }
 
@@ -2612,17 +2604,17 @@ void Map::Emote(Character *from, enum Emote emote, bool echo)
 	builder.AddShort(from->player->id);
 	builder.AddChar(emote);
 
-	UTIL_FOREACH(this->characters, character)
-	{
-		if (!echo && (character == from || !from->InRange(character)))
-		{
-			continue;
-		}
+	PacketBroadcast packet(builder);
+
+	if (echo)
+		from->player->client->Send(packet);
 
+	UTIL_FOREACH(from->in_view, character)
+	{
 		if (!from->hidden)
-            character->player->client->Send(builder);
-        else if ((from->hidden && character->admin >= static_cast<int>(this->world->admin_config["seehide"])) || from == character)
-            character->player->client->Send(builder);
+            character->player->client->Send(packet);
+        else if (character->admin >= static_cast<int>(this->world->admin_config["seehide"]))
+            character->player->client->Send(packet);
 	}
 }
 
@@ -2633,9 +2625,11 @@ bool Map::Occupied(unsigned char x, unsigned char y, Map::OccupiedTarget target)
 		return false;
 	}
 
+	const Map_Grid_Cell &cell = this->grid[this->GridCell(x, y)];
+
 	if (target != Map::NPCOnly)
 	{
-		UTIL_FOREACH(this->characters, character)
+		UTIL_FOREACH(cell.characters, character)
 		{
 			if (character->x == x && character->y == y && character->CanInteractCombat())
 			{
@@ -2646,7 +2640,7 @@ bool Map::Occupied(unsigned char x, unsigned char y, Map::OccupiedTarget target)
 
 	if (target != Map::PlayerOnly)
 	{
-		UTIL_FOREACH(this->npcs, npc)
+		UTIL_FOREACH(cell.npcs, npc)
 		{
 			if (npc->alive && npc->x == x && npc->y == y)
 			{
@@ -2670,8 +2664,12 @@ bool Map::OpenDoor(Character *from, unsigned char x, unsigned char y)
 		return false;
 	}
 
-	if (Map_Warp& warp = this->GetWarp(x, y))
+	auto warp_it = this->warps.find(y * this->width + x);
+
+	if (warp_it != this->warps.end() && warp_it->second)
 	{
+		Map_Warp& warp = warp_it->second;
+
 		if (warp.spec == Map_Warp::NoDoor || warp.open)
 		{
 			return false;
@@ -2718,8 +2716,12 @@ void Map::CloseDoor(unsigned char x, unsigned char y)
 	if (!this->InBounds(x, y))
 		return;
 
-	if (Map_Warp& warp = this->GetWarp(x, y))
+	auto warp_it = this->warps.find(y * this->width + x);
+
+	if (warp_it != this->warps.end() && warp_it->second)
 	{
+		Map_Warp& warp = warp_it->second;
+
 		if (warp.spec == Map_Warp::NoDoor || !warp.open)
 		{
 			return;
@@ -3419,6 +3421,8 @@ std::shared_ptr<Map_Item> Map::AddItem(short id, int amount, unsigned char x, un
 	}
 
 	this->items.push_back(newitem);
+	this->item_uids.take(newitem->uid);
+
 	return newitem;
 }
 
@@ -3475,6 +3479,8 @@ std::list<std::shared_ptr<Map_Item>>::iterator Map::DelItem(std::list<std::share
 		character->Send(builder);
 	}
 
+	this->item_uids.release((*it)->uid);
+
 	return this->items.erase(it);
 }
 
@@ -3537,10 +3543,15 @@ bool Map::InBounds(unsigned char x, unsigned char y) const
 
 bool Map::Walkable(unsigned char x, unsigned char y, bool npc) const
 {
-	if (!InBounds(x, y) || !this->GetTile(x, y).Walkable(npc))
+	if (!InBounds(x, y))
 		return false;
 
-	if (this->world->config["GhostArena"] && this->GetTile(x, y).tilespec == Map_Tile::Arena && this->Occupied(x, y, PlayerAndNPC))
+	int index = y * this->width + x;
+
+	if (!(npc ? this->npc_walkable[index] : this->player_walkable[index]))
+		return false;
+
+	if (this->tiles[index].tilespec == Map_Tile::Arena && this->world->config["GhostArena"] && this->Occupied(x, y, PlayerAndNPC))
 		return false;
 
 	return true;
@@ -3570,24 +3581,169 @@ Map_Tile::TileSpec Map::GetSpec(unsigned char x, unsigned char y) const
 	return this->GetTile(x, y).tilespec;
 }
 
-Map_Warp& Map::GetWarp(unsigned char x, unsigned char y)
+const Map_Warp& Map::GetWarp(unsigned char x, unsigned char y) const
 {
-	return this->GetTile(x, y).warp;
+	static const Map_Warp no_warp;
+
+	if (!InBounds(x, y))
+		throw std::out_of_range("Map tile out of range");
+
+	int index = y * this->width + x;
+
+	if (!this->warp_tiles[index])
+		return no_warp;
+
+	return this->warps.find(index)->second;
 }
 
-const Map_Warp& Map::GetWarp(unsigned char x, unsigned char y) const
+void Map::ResetGrid()
+{
+	this->grid_width = std::max((this->width + GridCellSize - 1) / GridCellSize, 1);
+	this->grid_height = std::max((this->height + GridCellSize - 1) / GridCellSize, 1);
+
+	this->grid.clear();
+	this->grid.resize(this->grid_width * this->grid_height);
+}
+
+int Map::GridCell(int x, int y) const
+{
+	int cx = std::min(std::max(x, 0) / GridCellSize, this->grid_width - 1);
+	int cy = std::min(std::max(y, 0) / GridCellSize, this->grid_height - 1);
+
+	return cy * this->grid_width + cx;
+}
+
+void Map::GridUpdate(Character *character)
+{
+	int cell = this->GridCell(character->x, character->y);
+
+	if (character->grid_cell == cell)
+		return;
+
+	this->GridRemove(character);
+	this->grid[cell].characters.push_back(character);
+	character->grid_cell = cell;
+}
+
+void Map::GridUpdate(NPC *npc)
+{
+	int cell = this->GridCell(npc->x, npc->y);
+
+	if (npc->grid_cell == cell)
+		return;
+
+	this->GridRemove(npc);
+	this->grid[cell].npcs.push_back(npc);
+	npc->grid_cell = cell;
+}
+
+void Map::GridRemove(Character *character)
+{
+	if (character->grid_cell >= 0 && std::size_t(character->grid_cell) < this->grid.size())
+	{
+		std::vector<Character *> &characters = this->grid[character->grid_cell].characters;
+		auto it = std::find(UTIL_RANGE(characters), character);
+
+		if (it != characters.end())
+		{
+			*it = characters.back();
+			characters.pop_back();
+		}
+	}
+
+	character->grid_cell = -1;
+}
+
+void Map::GridRemove(NPC *npc)
+{
+	if (npc->grid_cell >= 0 && std::size_t(npc->grid_cell) < this->grid.size())
+	{
+		std::vector<NPC *> &npcs = this->grid[npc->grid_cell].npcs;
+		auto it = std::find(UTIL_RANGE(npcs), npc);
+
+		if (it != npcs.end())
+		{
+			*it = npcs.back();
+			npcs.pop_back();
+		}
+	}
+
+	npc->grid_cell = -1;
+}
+
+static void map_view_erase(std::vector<Character *> &view, Character *character)
+{
+	auto it = std::find(UTIL_RANGE(view), character);
+
+	if (it != view.end())
+	{
+		*it = view.back();
+		view.pop_back();
+	}
+}
+
+void Map::UpdateView(Character *character, std::vector<Character *> *entered, std::vector<Character *> *left)
+{
+	int seedistance = this->world->hot_config.see_distance;
+
+	for (std::size_t i = 0; i < character->in_view.size(); )
+	{
+		Character *other = character->in_view[i];
+
+		if (util::path_length(character->x, character->y, other->x, other->y) <= seedistance)
+		{
+			++i;
+			continue;
+		}
+
+		character->in_view[i] = character->in_view.back();
+		character->in_view.pop_back();
+		map_view_erase(other->in_view, character);
+
+		if (left)
+			left->push_back(other);
+	}
+
+	UTIL_FOREACH(this->CharactersInRange(character->x, character->y, std::min(seedistance, 255)), other)
+	{
+		if (other == character || std::find(UTIL_RANGE(character->in_view), other) != character->in_view.end())
+			continue;
+
+		character->in_view.push_back(other);
+		other->in_view.push_back(character);
+
+		if (entered)
+			entered->push_back(other);
+	}
+}
+
+void Map::ClearView(Character *character)
 {
-	return this->GetTile(x, y).warp;
+	UTIL_FOREACH(character->in_view, other)
+	{
+		map_view_erase(other->in_view, character);
+	}
+
+	character->in_view.clear();
 }
 
 std::vector<Character *> Map::CharactersInRange(unsigned char x, unsigned char y, unsigned char range)
 {
 	std::vector<Character *> characters;
 
-	UTIL_FOREACH(this->characters, character)
+	int first = this->GridCell(int(x) - range, int(y) - range);
+	int last = this->GridCell(int(x) + range, int(y) + range);
+
+	for (int cy = first / this->grid_width; cy <= last / this->grid_width; ++cy)
 	{
-		if (util::path_length(character->x, character->y, x, y) <= range)
-			characters.push_back(character);
+		for (int cx = first % this->grid_width; cx <= last % this->grid_width; ++cx)
+		{
+			UTIL_FOREACH(this->grid[cy * this->grid_width + cx].characters, character)
+			{
+				if (util::path_length(character->x, character->y, x, y) <= range)
+					characters.push_back(character);
+			}
+		}
 	}
 
 	return characters;
@@ -3597,15 +3753,219 @@ std::vector<NPC *> Map::NPCsInRange(unsigned char x, unsigned char y, unsigned c
 {
 	std::vector<NPC *> npcs;
 
-	UTIL_FOREACH(this->npcs, npc)
+	int first = this->GridCell(int(x) - range, int(y) - range);
+	int last = this->GridCell(int(x) + range, int(y) + range);
+
+	for (int cy = first / this->grid_width; cy <= last / this->grid_width; ++cy)
 	{
-		if (util::path_length(npc->x, npc->y, x, y) <= range)
-			npcs.push_back(npc);
+		for (int cx = first % this->grid_width; cx <= last % this->grid_width; ++cx)
+		{
+			UTIL_FOREACH(this->grid[cy * this->grid_width + cx].npcs, npc)
+			{
+				if (util::path_length(npc->x, npc->y, x, y) <= range)
+					npcs.push_back(npc);
+			}
+		}
 	}
 
 	return npcs;
 }
 
+// Flow fields kept per map, enough for every player on a busy map being chased at once
+static const std::size_t map_flow_field_cache = 16;
+
+const Map_Flow_Field *Map::FlowField(unsigned char x, unsigned char y)
+{
+	for (auto it = this->flow_fields.begin(); it != this->flow_fields.end(); ++it)
+	{
+		if (it->target_x == x && it->target_y == y)
+		{
+			this->flow_fields.splice(this->flow_fields.begin(), this->flow_fields, it);
+			return &this->flow_fields.front();
+		}
+	}
+
+	// Anything chasing further away than this gives up anyway
+	int range = std::max(this->world->hot_config.npc_chase_distance, 1);
+
+	Map_Flow_Field field;
+	field.target_x = x;
+	field.target_y = y;
+	field.left = std::max(int(x) - range, 0);
+	field.top = std::max(int(y) - range, 0);
+	field.width = std::min(int(x) + range + 1, int(this->width)) - field.left;
+	field.height = std::min(int(y) + range + 1, int(this->height)) - field.top;
+
+	if (field.width <= 0 || field.height <= 0 || field.width * field.height > this->world->npc_path_budget)
+		return 0;
+
+	this->world->npc_path_budget -= field.width * field.height;
+
+	field.distance.assign(field.width * field.height, Map_Flow_Field::Unreached);
+
+	std::vector<int> queue;
+	queue.reserve(field.width * field.height);
+
+	field.distance[(y - field.top) * field.width + (x - field.left)] = 0;
+	queue.push_back((y - field.top) * field.width + (x - field.left));
+
+	static const int offset_x[4] = {0, -1, 0, 1};
+	static const int offset_y[4] = {1, 0, -1, 0};
+
+	for (std::size_t i = 0; i < queue.size(); ++i)
+	{
+		int cell = queue[i];
+		int cx = cell % field.width;
+		int cy = cell / field.width;
+		unsigned short next = field.distance[cell] + 1;
+
+		for (int d = 0; d < 4; ++d)
+		{
+			int nx = cx + offset_x[d];
+			int ny = cy + offset_y[d];
+
+			if (nx < 0 || ny < 0 || nx >= field.width || ny >= field.height)
+				continue;
+
+			int neighbour = ny * field.width + nx;
+
+			if (field.distance[neighbour] != Map_Flow_Field::Unreached
+			 || !this->npc_walkable[(field.top + ny) * this->width + field.left + nx])
+				continue;
+
+			field.distance[neighbour] = next;
+			queue.push_back(neighbour);
+		}
+	}
+
+	if (this->flow_fields.size() >= map_flow_field_cache)
+		this->flow_fields.pop_back();
+
+	this->flow_fields.push_front(std::move(field));
+
+	return &this->flow_fields.front();
+}
+
+int Map::PathDirections(unsigned char from_x, unsigned char from_y, unsigned char to_x, unsigned char to_y, std::array<Direction, 4> &directions)
+{
+	if (!this->InBounds(to_x, to_y))
+		return 0;
+
+	const Map_Flow_Field *field = this->FlowField(to_x, to_y);
+
+	if (!field)
+		return 0;
+
+	unsigned short distance = field->Distance(from_x, from_y);
+
+	if (distance == Map_Flow_Field::Unreached || distance == 0)
+		return 0;
+
+	static const Direction step_direction[4] = {DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_UP, DIRECTION_RIGHT};
+	static const int offset_x[4] = {0, -1, 0, 1};
+	static const int offset_y[4] = {1, 0, -1, 0};
+
+	int count = 0;
+
+	for (int d = 0; d < 4; ++d)
+	{
+		if (field->Distance(from_x + offset_x[d], from_y + offset_y[d]) < distance)
+			directions[count++] = step_direction[d];
+	}
+
+	return count;
+}
+
+// How often an NPC with nobody within NPCIdleDistance checks again
+static const double map_npc_idle_recheck = 1.0;
+
+void Map::ScheduleNPC(NPC *npc)
+{
+	this->ScheduleNPC(npc, npc->last_act + npc->act_speed);
+}
+
+void Map::ScheduleNPC(NPC *npc, double due)
+{
+	this->UnscheduleNPC(npc);
+
+	if (!npc->alive || this->characters.empty())
+		return;
+
+	npc->schedule_entry = this->npc_schedule.insert(std::make_pair(due, npc));
+	npc->scheduled = true;
+}
+
+void Map::UnscheduleNPC(NPC *npc)
+{
+	if (npc == this->acting_npc)
+		this->acting_npc = 0;
+
+	if (!npc->scheduled)
+		return;
+
+	this->npc_schedule.erase(npc->schedule_entry);
+	npc->scheduled = false;
+}
+
+void Map::ActNPCs(double current_time)
+{
+	int idle_distance = std::min(this->world->hot_config.npc_idle_distance, 255);
+
+	while (!this->npc_schedule.empty() && this->npc_schedule.begin()->first < current_time)
+	{
+		NPC *npc = this->npc_schedule.begin()->second;
+
+		this->npc_schedule.erase(this->npc_schedule.begin());
+		npc->scheduled = false;
+
+		if (!npc->alive)
+			continue;
+
+		if (idle_distance > 0 && !npc->pet && this->CharactersInRange(npc->x, npc->y, idle_distance).empty())
+		{
+			this->ScheduleNPC(npc, current_time + map_npc_idle_recheck);
+			continue;
+		}
+
+		// An NPC that's been idle carries on from now instead of making up for every act it missed
+		if (npc->last_act + npc->act_speed * 2 < current_time)
+			npc->last_act = current_time - npc->act_speed;
+
+		this->acting_npc = npc;
+		npc->Act();
+
+		// Act() may have deleted the NPC or taken it off the map
+		if (this->acting_npc)
+			this->ScheduleNPC(npc, std::max(npc->last_act + npc->act_speed, current_time));
+
+		this->acting_npc = 0;
+	}
+}
+
+void Map::WakeNPCs()
+{
+	double current_time = Timer::GetTime();
+
+	UTIL_FOREACH(this->npcs, npc)
+	{
+		if (!npc->alive)
+			continue;
+
+		npc->last_act = current_time - npc->act_speed + util::rand(0.0, npc->act_speed);
+		this->ScheduleNPC(npc);
+	}
+}
+
+void Map::SleepNPCs()
+{
+	UTIL_FOREACH_CREF(this->npc_schedule, entry)
+	{
+		entry.second->scheduled = false;
+	}
+
+	this->npc_schedule.clear();
+}
+
 void Map::Effect(MapEffect effect, unsigned char param)
 {
 	PacketBuilder builder(PACKET_EFFECT, PACKET_USE, 2);
@@ -3675,6 +4035,12 @@ bool Map::Reload()
 
 	this->characters = temp;
 
+	UTIL_FOREACH(temp, character)
+	{
+		character->grid_cell = -1;
+		this->GridUpdate(character);
+	}
+
 	UTIL_FOREACH(temp, character)
 	{
 		character->player->client->Upload(FILE_MAP, character->mapid, INIT_MAP_MUTATION);
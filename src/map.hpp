@@ -3,9 +3,12 @@
 
 #include "fwd/map.hpp"
 
+#include <array>
 #include <list>
+#include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "fwd/arena.hpp"
@@ -13,6 +16,8 @@
 #include "fwd/npc.hpp"
 #include "fwd/world.hpp"
 
+#include "util/id_pool.hpp"
+
 /**
  * Object representing an item on the floor of a map
  */
@@ -61,7 +66,7 @@ struct Map_Warp
 };
 
 /**
- * Object representing one tile on a map
+ * Object representing one tile on a map, warps are kept separately by Map
  */
 struct Map_Tile
 {
@@ -109,17 +114,13 @@ struct Map_Tile
 
 	TileSpec tilespec;
 
-	Map_Warp warp;
-
 	Map_Tile() : tilespec(Map_Tile::None) { }
 
+	/**
+	 * Whether the tile spec allows walking, NPCs are also kept off warps by Map::Walkable()
+	 */
 	bool Walkable(bool npc = false) const
 	{
-		if (this->warp && npc)
-		{
-			return false;
-		}
-
 		switch (this->tilespec)
 		{
 			case Wall:
@@ -205,6 +206,36 @@ struct Map_Chest
 	void Update(Map *map, Character *exclude = 0) const;
 };
 
+/**
+ * One square of tiles in a map's spatial index
+ */
+struct Map_Grid_Cell
+{
+	std::vector<Character *> characters;
+	std::vector<NPC *> npcs;
+};
+
+/**
+ * Walking distance to one tile from every tile in a box around it, going around walls.
+ * Built by a breadth-first search out from the target, so it serves everything heading there.
+ */
+struct Map_Flow_Field
+{
+	static const unsigned short Unreached = 0xFFFF;
+
+	unsigned char target_x, target_y;
+	int left, top, width, height;
+	std::vector<unsigned short> distance;
+
+	unsigned short Distance(int x, int y) const
+	{
+		if (x < this->left || y < this->top || x >= this->left + this->width || y >= this->top + this->height)
+			return Unreached;
+
+		return this->distance[(y - this->top) * this->width + (x - this->left)];
+	}
+};
+
 /**
  * Contains all information about a map, holds reference to contained Characters and manages NPCs on it
  */
@@ -214,6 +245,45 @@ class Map
 		bool Load();
 		void Unload();
 
+		/**
+		 * Characters and NPCs bucketed by position, so range and occupancy
+		 * checks only look at the cells around a tile
+		 */
+		std::vector<Map_Grid_Cell> grid;
+		int grid_width;
+		int grid_height;
+
+		void ResetGrid();
+		int GridCell(int x, int y) const;
+
+		/**
+		 * Living NPCs keyed on when they're next due to act. Only kept while
+		 * there's a character on the map, NPCs on an empty map don't act at all.
+		 */
+		std::multimap<double, NPC *> npc_schedule;
+
+		// The NPC ActNPCs() is calling Act() on, cleared if it's removed from the schedule meanwhile
+		NPC *acting_npc;
+
+		// Most recently used first, dropped when the map is loaded or unloaded
+		std::list<Map_Flow_Field> flow_fields;
+
+		/**
+		 * Returns the flow field for a target tile, building it if it isn't cached.
+		 * Returns 0 if building it would go over what's left of World::npc_path_budget.
+		 */
+		const Map_Flow_Field *FlowField(unsigned char x, unsigned char y);
+
+		/**
+		 * Schedules every living NPC, spread out over their first act, when the first character arrives
+		 */
+		void WakeNPCs();
+
+		/**
+		 * Empties the schedule when the last character leaves
+		 */
+		void SleepNPCs();
+
 	public:
 		World *world;
 		short id;
@@ -230,7 +300,21 @@ class Map
 		std::vector<NPC *> npcs;
 		std::vector<std::shared_ptr<Map_Chest>> chests;
 		std::list<std::shared_ptr<Map_Item>> items;
+
+		// Indexes of the NPCs in npcs and UIDs of the items in items
+		util::id_pool npc_indexes;
+		util::id_pool item_uids;
+
 		std::vector<Map_Tile> tiles;
+
+		// Built from tiles and warps by Load(), indexed the same way as tiles
+		std::vector<bool> player_walkable;
+		std::vector<bool> npc_walkable;
+		std::vector<bool> warp_tiles;
+
+		// Keyed by the tile's index in tiles
+		std::unordered_map<int, Map_Warp> warps;
+
 		bool exists;
 		double jukebox_protect;
 		std::string jukebox_player;
@@ -244,6 +328,16 @@ class Map
 		int GenerateItemID() const;
 		unsigned char GenerateNPCIndex() const;
 
+		/**
+		 * Adds an NPC to npcs, reserving its index
+		 */
+		void AddNPC(NPC *npc);
+
+		/**
+		 * Takes an NPC off the map without deleting it, freeing its index
+		 */
+		void RemoveNPC(NPC *npc);
+
 		void Enter(Character *, WarpAnimation animation = WARP_ANIMATION_NONE);
 		void Leave(Character *, WarpAnimation animation = WARP_ANIMATION_NONE, bool silent = false);
 
@@ -286,12 +380,60 @@ class Map
 		Map_Tile& GetTile(unsigned char x, unsigned char y);
 		const Map_Tile& GetTile(unsigned char x, unsigned char y) const;
 		Map_Tile::TileSpec GetSpec(unsigned char x, unsigned char y) const;
-		Map_Warp& GetWarp(unsigned char x, unsigned char y);
 		const Map_Warp& GetWarp(unsigned char x, unsigned char y) const;
 
+		/**
+		 * Size of a spatial index cell in tiles
+		 */
+		static const int GridCellSize = 8;
+
+		/**
+		 * Re-indexes an entity after its position changes. Must be called
+		 * whenever the x/y of a character or NPC on this map is modified.
+		 */
+		void GridUpdate(Character *character);
+		void GridUpdate(NPC *npc);
+
+		void GridRemove(Character *character);
+		void GridRemove(NPC *npc);
+
+		/**
+		 * Brings a character's in_view set up to date with its position.
+		 * Visibility is symmetric, so the other characters' sets are updated too.
+		 * @param entered If set, receives the characters that came into view.
+		 * @param left If set, receives the characters that went out of view.
+		 */
+		void UpdateView(Character *character, std::vector<Character *> *entered = 0, std::vector<Character *> *left = 0);
+		void ClearView(Character *character);
+
 		std::vector<Character *> CharactersInRange(unsigned char x, unsigned char y, unsigned char range);
 		std::vector<NPC *> NPCsInRange(unsigned char x, unsigned char y, unsigned char range);
 
+		/**
+		 * Finds the directions that take an NPC one step closer to a tile along a route around walls.
+		 * Doesn't account for anything standing in the way.
+		 * @return Number of directions written, 0 if there's no route within range or no path budget left
+		 */
+		int PathDirections(unsigned char from_x, unsigned char from_y, unsigned char to_x, unsigned char to_y, std::array<Direction, 4> &directions);
+
+		/**
+		 * Schedules an NPC to act at last_act + act_speed, or at due, replacing any earlier entry.
+		 * Does nothing if the NPC is dead or there's nobody on the map.
+		 * Must be called whenever an NPC spawns.
+		 */
+		void ScheduleNPC(NPC *npc);
+		void ScheduleNPC(NPC *npc, double due);
+
+		/**
+		 * Must be called before an NPC is deleted or taken off the map while alive
+		 */
+		void UnscheduleNPC(NPC *npc);
+
+		/**
+		 * Calls Act() on every NPC that's due by current_time
+		 */
+		void ActNPCs(double current_time);
+
 		void Effect(MapEffect effect, unsigned char param);
 
 		bool Evacuate();
@@ -1,6 +1,7 @@
 #include "npc.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstdio>
 #include <set>
@@ -59,6 +60,8 @@ NPC::NPC(Map *map, short id, unsigned char x, unsigned char y, unsigned char spa
 {
     this->marriage = 0;
 	this->map = map;
+	this->grid_cell = -1;
+	this->scheduled = false;
 	this->temporary = temporary;
 	this->index = index;
 	this->id = id;
@@ -101,26 +104,19 @@ NPC::NPC(Map *map, short id, unsigned char x, unsigned char y, unsigned char spa
 	}
 
 	this->parent = 0;
-	this->citizenship = 0;
 
 	this->pet = pet;
     this->attack_command = !pet;
 
-	if (!pet)
-	{
-	    this->LoadShopDrop();
-	}
+	this->LoadShopDrop();
 }
 
-void NPC::LoadShopDrop()
+NPC_Prototype::NPC_Prototype(World *world, short id)
 {
-	this->drops.clear();
-	this->shop_trade.clear();
-	this->shop_craft.clear();
-	this->skill_learn.clear();
+	const ENF_Data &data = world->enf->Get(id);
 
-	Config::iterator drops = map->world->drops_config.find(util::to_string(this->id));
-	if (drops != map->world->drops_config.end())
+	Config::iterator drops = world->drops_config.find(util::to_string(id));
+	if (drops != world->drops_config.end())
 	{
 		std::vector<std::string> parts = util::explode(',', static_cast<std::string>((*drops).second));
 
@@ -136,34 +132,32 @@ void NPC::LoadShopDrop()
 
 			for (std::size_t i = 0; i < parts.size(); i += 4)
 			{
-				NPC_Drop *drop(new NPC_Drop);
+				NPC_Drop &drop = this->drops[i/4];
 
-				drop->id = util::to_int(parts[i]);
-				drop->min = util::to_int(parts[i+1]);
-				drop->max = util::to_int(parts[i+2]);
-				drop->chance = util::to_float(parts[i+3]);
-
-				this->drops[i/4] = drop;
+				drop.id = util::to_int(parts[i]);
+				drop.min = util::to_int(parts[i+1]);
+				drop.max = util::to_int(parts[i+2]);
+				drop.chance = util::to_float(parts[i+3]);
 			}
 		}
 	}
 
 	short shop_vend_id;
 
-	if (int(map->world->shops_config["Version"]) < 2)
+	if (int(world->shops_config["Version"]) < 2)
 	{
-		shop_vend_id = this->id;
+		shop_vend_id = id;
 	}
 	else
 	{
-		shop_vend_id = this->Data().vendor_id;
+		shop_vend_id = data.vendor_id;
 	}
 
-	if (this->Data().type == ENF::Type::Shop && shop_vend_id > 0)
+	if (data.type == ENF::Type::Shop && shop_vend_id > 0)
 	{
-		this->shop_name = static_cast<std::string>(map->world->shops_config[util::to_string(shop_vend_id) + ".name"]);
-		Config::iterator shops = map->world->shops_config.find(util::to_string(shop_vend_id) + ".trade");
-		if (shops != map->world->shops_config.end())
+		this->shop_name = static_cast<std::string>(world->shops_config[util::to_string(shop_vend_id) + ".name"]);
+		Config::iterator shops = world->shops_config.find(util::to_string(shop_vend_id) + ".trade");
+		if (shops != world->shops_config.end())
 		{
 			std::vector<std::string> parts = util::explode(',', static_cast<std::string>((*shops).second));
 
@@ -179,23 +173,21 @@ void NPC::LoadShopDrop()
 
 				for (std::size_t i = 0; i < parts.size(); i += 3)
 				{
-					NPC_Shop_Trade_Item *item(new NPC_Shop_Trade_Item);
-					item->id = util::to_int(parts[i]);
-					item->buy = util::to_int(parts[i+1]);
-					item->sell = util::to_int(parts[i+2]);
+					NPC_Shop_Trade_Item &item = this->shop_trade[i/3];
+					item.id = util::to_int(parts[i]);
+					item.buy = util::to_int(parts[i+1]);
+					item.sell = util::to_int(parts[i+2]);
 
-					if (item->buy != 0 && item->sell != 0 && item->sell > item->buy)
+					if (item.buy != 0 && item.sell != 0 && item.sell > item.buy)
 					{
-						Console::Wrn("item #%i (vendor #%i) has a higher sell price than buy price.", item->id, shop_vend_id);
+						Console::Wrn("item #%i (vendor #%i) has a higher sell price than buy price.", item.id, shop_vend_id);
 					}
-
-					this->shop_trade[i/3] = item;
 				}
 			}
 		}
 
-		shops = this->map->world->shops_config.find(util::to_string(shop_vend_id) + ".craft");
-		if (shops != this->map->world->shops_config.end())
+		shops = world->shops_config.find(util::to_string(shop_vend_id) + ".craft");
+		if (shops != world->shops_config.end())
 		{
 			std::vector<std::string> parts = util::explode(',', static_cast<std::string>((*shops).second));
 
@@ -211,23 +203,16 @@ void NPC::LoadShopDrop()
 
 				for (std::size_t i = 0; i < parts.size(); i += 9)
 				{
-					NPC_Shop_Craft_Item *item = new NPC_Shop_Craft_Item;
-					std::vector<NPC_Shop_Craft_Ingredient *> ingredients;
-					ingredients.resize(4);
+					NPC_Shop_Craft_Item &item = this->shop_craft[i/9];
+					item.ingredients.resize(4);
 
-					item->id = util::to_int(parts[i]);
+					item.id = util::to_int(parts[i]);
 
 					for (int ii = 0; ii < 4; ++ii)
 					{
-						NPC_Shop_Craft_Ingredient *ingredient = new NPC_Shop_Craft_Ingredient;
-						ingredient->id = util::to_int(parts[i+1+ii*2]);
-						ingredient->amount = util::to_int(parts[i+2+ii*2]);
-						ingredients[ii] = ingredient;
+						item.ingredients[ii].id = util::to_int(parts[i+1+ii*2]);
+						item.ingredients[ii].amount = util::to_int(parts[i+2+ii*2]);
 					}
-
-					item->ingredients = ingredients;
-
-					this->shop_craft[i/9] = item;
 				}
 			}
 		}
@@ -235,20 +220,20 @@ void NPC::LoadShopDrop()
 
 	short skills_vend_id;
 
-	if (int(map->world->skills_config["Version"]) < 2)
+	if (int(world->skills_config["Version"]) < 2)
 	{
-		skills_vend_id = this->id;
+		skills_vend_id = id;
 	}
 	else
 	{
-		skills_vend_id = this->Data().vendor_id;
+		skills_vend_id = data.vendor_id;
 	}
 
-	if (this->Data().type == ENF::Type::Skills && skills_vend_id > 0)
+	if (data.type == ENF::Type::Skills && skills_vend_id > 0)
 	{
-		this->skill_name = static_cast<std::string>(map->world->skills_config[util::to_string(skills_vend_id) + ".name"]);
-		Config::iterator skills = this->map->world->skills_config.find(util::to_string(skills_vend_id) + ".learn");
-		if (skills != this->map->world->skills_config.end())
+		this->skill_name = static_cast<std::string>(world->skills_config[util::to_string(skills_vend_id) + ".name"]);
+		Config::iterator skills = world->skills_config.find(util::to_string(skills_vend_id) + ".learn");
+		if (skills != world->skills_config.end())
 		{
 			std::vector<std::string> parts = util::explode(',', static_cast<std::string>((*skills).second));
 
@@ -264,26 +249,24 @@ void NPC::LoadShopDrop()
 
 				for (std::size_t i = 0; i < parts.size(); i += 14)
 				{
-					NPC_Learn_Skill *skill = new NPC_Learn_Skill;
-
-					skill->id = util::to_int(parts[i]);
-					skill->cost = util::to_int(parts[i+1]);
-					skill->levelreq = util::to_int(parts[i+2]);
-					skill->classreq = util::to_int(parts[i+3]);
-
-					skill->skillreq[0] = util::to_int(parts[i+4]);
-					skill->skillreq[1] = util::to_int(parts[i+5]);
-					skill->skillreq[2] = util::to_int(parts[i+6]);
-					skill->skillreq[3] = util::to_int(parts[i+7]);
-
-					skill->strreq = util::to_int(parts[i+8]);
-					skill->intreq = util::to_int(parts[i+9]);
-					skill->wisreq = util::to_int(parts[i+10]);
-					skill->agireq = util::to_int(parts[i+11]);
-					skill->conreq = util::to_int(parts[i+12]);
-					skill->chareq = util::to_int(parts[i+13]);
-
-					this->skill_learn[i/14] = skill;
+					NPC_Learn_Skill &skill = this->skill_learn[i/14];
+
+					skill.id = util::to_int(parts[i]);
+					skill.cost = util::to_int(parts[i+1]);
+					skill.levelreq = util::to_int(parts[i+2]);
+					skill.classreq = util::to_int(parts[i+3]);
+
+					skill.skillreq[0] = util::to_int(parts[i+4]);
+					skill.skillreq[1] = util::to_int(parts[i+5]);
+					skill.skillreq[2] = util::to_int(parts[i+6]);
+					skill.skillreq[3] = util::to_int(parts[i+7]);
+
+					skill.strreq = util::to_int(parts[i+8]);
+					skill.intreq = util::to_int(parts[i+9]);
+					skill.wisreq = util::to_int(parts[i+10]);
+					skill.agireq = util::to_int(parts[i+11]);
+					skill.conreq = util::to_int(parts[i+12]);
+					skill.chareq = util::to_int(parts[i+13]);
 				}
 			}
 		}
@@ -291,21 +274,19 @@ void NPC::LoadShopDrop()
 
 	short home_vend_id;
 
-	if (int(map->world->home_config["Version"]) < 2)
+	if (int(world->home_config["Version"]) < 2)
 	{
-		home_vend_id = this->id;
+		home_vend_id = id;
 	}
 	else
 	{
-		home_vend_id = this->Data().vendor_id;
+		home_vend_id = data.vendor_id;
 	}
 
-	this->citizenship = 0;
-
-	if (this->Data().type == ENF::Type::Inn && home_vend_id > 0)
+	if (data.type == ENF::Type::Inn && home_vend_id > 0)
 	{
 		restart_loop:
-		UTIL_FOREACH(this->map->world->home_config, hc)
+		UTIL_FOREACH(world->home_config, hc)
 		{
 			std::vector<std::string> parts = util::explode('.', hc.first);
 
@@ -316,12 +297,12 @@ void NPC::LoadShopDrop()
 
 			if (!this->citizenship && parts[1] == "innkeeper" && util::to_int(hc.second) == home_vend_id)
 			{
-				this->citizenship = new NPC_Citizenship;
+				this->citizenship.reset(new NPC_Citizenship);
 				this->citizenship->home = parts[0];
-				Home* home = this->map->world->GetHome(this->citizenship->home);
+				Home* home = world->GetHome(this->citizenship->home);
 
 				if (home)
-					home->innkeeper_vend = this->Data().vendor_id;
+					home->innkeeper_vend = data.vendor_id;
 				else
 					Console::Wrn("Vendor #%i's innkeeper set on non-existent home: %s", home_vend_id, this->citizenship->home.c_str());
 
@@ -354,6 +335,12 @@ void NPC::LoadShopDrop()
 	}
 }
 
+void NPC::LoadShopDrop()
+{
+	// Pets don't drop, sell or teach anything
+	this->prototype = this->map->world->GetNPCPrototype(this->pet ? 0 : this->id);
+}
+
 const ENF_Data& NPC::Data() const
 {
 	return this->map->world->enf->Get(id);
@@ -428,11 +415,15 @@ void NPC::Spawn(NPC *parent)
 		}
 	}
 
+	this->map->GridUpdate(this);
+
 	this->alive = true;
 	this->hp = this->Data().hp;
 	this->last_act = Timer::GetTime();
 	this->act_speed = speed_table[this->spawn_type];
 
+	this->map->ScheduleNPC(this);
+
 	PacketBuilder builder(PACKET_APPEAR, PACKET_REPLY, 8);
 	builder.AddChar(0);
 	builder.AddByte(255);
@@ -741,7 +732,7 @@ void NPC::Act()
     {
         if (opponent->attacker)
         {
-            if (opponent->attacker->map != this->map || opponent->attacker->nowhere || opponent->last_hit < Timer::GetTime() - static_cast<double>(this->map->world->config["NPCBoredTimer"]))
+            if (opponent->attacker->map != this->map || opponent->attacker->nowhere || opponent->last_hit < Timer::GetTime() - this->map->world->hot_config.npc_bored_timer)
             {
                 if (this->killowner)
                 {
@@ -761,12 +752,12 @@ void NPC::Act()
 
 	// NPCs casting spells
 
-	if (this->map->world->config["NPCSpells"])
+	if (this->map->world->hot_config.npc_spells)
 	{
         if (this->spelltimer == 0)
             this->spelltimer = Timer::GetTime() + 1.50;
 
-        if (this->Data().unka > 0 && Timer::GetTime() > this->spelltimer && this->map->world->config["NPCSpells"])
+        if (this->Data().unka > 0 && Timer::GetTime() > this->spelltimer && this->map->world->hot_config.npc_spells)
         {
             std::vector<Character *> dcheck_chars;
 
@@ -865,33 +856,8 @@ void NPC::Act()
                 {
                     return;
                 }
-                else if (absxdiff > absydiff)
-                {
-                    if (xdiff < 0)
-                    {
-                        this->direction = DIRECTION_RIGHT;
-                    }
-                    else
-                    {
-                        this->direction = DIRECTION_LEFT;
-                    }
-                }
-                else
-                {
-                    if (ydiff < 0)
-                    {
-                        this->direction = DIRECTION_DOWN;
-                    }
-                    else
-                    {
-                        this->direction = DIRECTION_UP;
-                    }
-                }
 
-                if (!this->Walk(this->direction))
-                {
-                    this->Walk(static_cast<Direction>(util::rand(0,3)));
-                }
+                this->WalkTowards(npc->x, npc->y);
 
                 return;
             }
@@ -903,7 +869,7 @@ void NPC::Act()
                 if (this->owner->mapid == int(this->map->world->pvp_config["PVPMap"]) && !this->map->world->pvp)
                     return;
 
-                int amount = util::rand(this->Data().mindam + this->mindam, this->Data().maxdam + static_cast<int>(this->map->world->config["NPCAdjustMaxDam"]) + this->maxdam);
+                int amount = util::rand(this->Data().mindam + this->mindam, this->Data().maxdam + this->map->world->hot_config.npc_adjust_max_dam + this->maxdam);
 
                 if (distance < 2)
                 {
@@ -1011,14 +977,14 @@ void NPC::Act()
     if (this->pet)
         attacker = this->owner;
 
-    unsigned char attacker_distance = static_cast<int>(this->map->world->config["NPCChaseDistance"]);
+    unsigned char attacker_distance = this->map->world->hot_config.npc_chase_distance;
     unsigned short attacker_damage = 0;
 
     if (this->Data().type == ENF::Passive || this->Data().type == ENF::Aggressive)
 	{
 		UTIL_FOREACH(this->damagelist, opponent)
 		{
-			if (opponent->attacker->map != this->map || opponent->attacker->nowhere || opponent->last_hit < Timer::GetTime() - static_cast<double>(this->map->world->config["NPCBoredTimer"]))
+			if (opponent->attacker->map != this->map || opponent->attacker->nowhere || opponent->last_hit < Timer::GetTime() - this->map->world->hot_config.npc_bored_timer)
 			{
                 this->ActAggressive = false;
 				continue;
@@ -1038,7 +1004,7 @@ void NPC::Act()
 		{
 			UTIL_FOREACH(this->parent->damagelist, opponent)
 			{
-				if (opponent->attacker->map != this->map || opponent->attacker->nowhere || opponent->last_hit < Timer::GetTime() - static_cast<double>(this->map->world->config["NPCBoredTimer"]))
+				if (opponent->attacker->map != this->map || opponent->attacker->nowhere || opponent->last_hit < Timer::GetTime() - this->map->world->hot_config.npc_bored_timer)
 				{
                     this->ActAggressive = false;
 					continue;
@@ -1062,7 +1028,7 @@ void NPC::Act()
     {
         Character *closest = 0;
 
-        unsigned char closest_distance = static_cast<int>(this->map->world->config["NPCChaseDistance"]);
+        unsigned char closest_distance = this->map->world->hot_config.npc_chase_distance;
 
         if (attacker)
         {
@@ -1133,33 +1099,7 @@ void NPC::Act()
                             return;
                         }
 
-                        else if (absxdiff > absydiff)
-                        {
-                            if (xdiff < 0)
-                            {
-                                this->direction = DIRECTION_RIGHT;
-                            }
-                            else
-                            {
-                                this->direction = DIRECTION_LEFT;
-                            }
-                        }
-                        else
-                        {
-                            if (ydiff < 0)
-                            {
-                                this->direction = DIRECTION_DOWN;
-                            }
-                            else
-                            {
-                                this->direction = DIRECTION_UP;
-                            }
-                        }
-
-                        if (!this->Walk(this->direction))
-                        {
-                            this->Walk(static_cast<Direction>(util::rand(0,3)));
-                        }
+                        this->WalkTowards(attacker->pet->x, attacker->pet->y);
 
                         return;
                     }
@@ -1189,7 +1129,7 @@ void NPC::Act()
                             }
                         }
 
-                        int amount = util::rand(this->Data().mindam, this->Data().maxdam + static_cast<int>(this->map->world->config["NPCAdjustMaxDam"]));
+                        int amount = util::rand(this->Data().mindam, this->Data().maxdam + this->map->world->hot_config.npc_adjust_max_dam);
 
                         PacketBuilder builder(PACKET_NPC, PACKET_PLAYER);
                         builder.AddByte(255);
@@ -1262,33 +1202,8 @@ void NPC::Act()
 
             return;
         }
-        else if (absxdiff > absydiff )
-        {
-            if (xdiff < 0)
-            {
-                this->direction = DIRECTION_RIGHT;
-            }
-            else
-            {
-                this->direction = DIRECTION_LEFT;
-            }
-        }
-        else
-        {
-            if (ydiff < 0)
-            {
-                this->direction = DIRECTION_DOWN;
-            }
-            else
-            {
-                this->direction = DIRECTION_UP;
-            }
-        }
 
-        if (!this->Walk(this->direction))
-        {
-            this->Walk(static_cast<Direction>(util::rand(0,3)));
-        }
+        this->WalkTowards(attacker->x, attacker->y);
     }
     else
     {
@@ -1343,6 +1258,41 @@ bool NPC::Walk(Direction direction)
 	return this->map->Walk(this, direction);
 }
 
+void NPC::WalkTowards(unsigned char x, unsigned char y)
+{
+	if (this->map->world->hot_config.npc_chase_mode == 1)
+	{
+		std::array<Direction, 4> directions;
+		int count = this->map->PathDirections(this->x, this->y, x, y, directions);
+
+		if (count > 0)
+		{
+			// Start from a random equally short step so NPCs chasing together spread out
+			int first = util::rand(0, count - 1);
+
+			for (int i = 0; i < count; ++i)
+			{
+				if (this->Walk(directions[(first + i) % count]))
+					return;
+			}
+
+			// Someone is standing in the way, stepping aside would only lead further away
+			return;
+		}
+	}
+
+	int xdiff = this->x - x;
+	int ydiff = this->y - y;
+
+	if (std::abs(xdiff) > std::abs(ydiff))
+		this->direction = (xdiff < 0) ? DIRECTION_RIGHT : DIRECTION_LEFT;
+	else
+		this->direction = (ydiff < 0) ? DIRECTION_DOWN : DIRECTION_UP;
+
+	if (!this->Walk(this->direction))
+		this->Walk(static_cast<Direction>(util::rand(0, 3)));
+}
+
 bool NPC::AddItem(short item, int amount)
 {
     if (amount <= 0)
@@ -1648,20 +1598,20 @@ void NPC::Killed(Character *from, int amount, int spell_id, bool npckill)
 
 	this->dead_since = int(Timer::GetTime());
 
-	std::vector<NPC_Drop *> drops;
-	NPC_Drop *drop = 0;
+	std::vector<const NPC_Drop *> drops;
+	const NPC_Drop *drop = 0;
 
-	UTIL_FOREACH(this->drops, checkdrop)
+	UTIL_FOREACH_CREF(this->prototype->drops, checkdrop)
 	{
 	    if (from->boosttimer == 0 && from->boostdrop == 0)
         {
-            if (util::rand(0.0, 100.0) <= checkdrop->chance * droprate)
-                drops.push_back(checkdrop);
+            if (util::rand(0.0, 100.0) <= checkdrop.chance * droprate)
+                drops.push_back(&checkdrop);
         }
         else
         {
-            if (util::rand(0.0, 100.0) <= checkdrop->chance * boosted)
-                drops.push_back(checkdrop);
+            if (util::rand(0.0, 100.0) <= checkdrop.chance * boosted)
+                drops.push_back(&checkdrop);
         }
 	}
 
@@ -1692,9 +1642,10 @@ void NPC::Killed(Character *from, int amount, int spell_id, bool npckill)
 		dropid = drop->id;
 		dropamount = util::rand(drop->min, drop->max);
 
-		std::shared_ptr<Map_Item> newitem(std::make_shared<Map_Item>(dropuid, dropid, dropamount, this->x, this->y, from->player->id, Timer::GetTime() + static_cast<int>(this->map->world->config["ProtectNPCDrop"])));
+		std::shared_ptr<Map_Item> newitem(std::make_shared<Map_Item>(dropuid, dropid, dropamount, this->x, this->y, from->player->id, Timer::GetTime() + this->map->world->hot_config.protect_npc_drop));
 
 		this->map->items.push_back(newitem);
+		this->map->item_uids.take(dropuid);
 
 		switch (sharemode)
 		{
@@ -2223,7 +2174,7 @@ void NPC::Killed(Character *from, int amount, int spell_id, bool npckill)
 
 	if (this->temporary)
 	{
-		this->map->npcs.erase(std::remove(this->map->npcs.begin(), this->map->npcs.end(), this), this->map->npcs.end());
+		this->map->RemoveNPC(this);
 	}
 
     if (from->party)
@@ -2308,7 +2259,7 @@ void NPC::Die(bool show)
 
 	if (this->temporary)
     {
-        this->map->npcs.erase(std::remove(this->map->npcs.begin(), this->map->npcs.end(), this), this->map->npcs.end());
+        this->map->RemoveNPC(this);
 
         delete this;
     }
@@ -2333,11 +2284,11 @@ void NPC::Attack(Character *target)
 
     if (this->pet && this->Data().type == ENF::Quest)
     {
-        amount = util::rand(this->Data().mindam + this->mindam, this->Data().maxdam + static_cast<int>(this->map->world->config["NPCAdjustMaxDam"]) + this->maxdam);
+        amount = util::rand(this->Data().mindam + this->mindam, this->Data().maxdam + this->map->world->hot_config.npc_adjust_max_dam + this->maxdam);
     }
     else
     {
-        amount = util::rand(this->Data().mindam, this->Data().maxdam + static_cast<int>(this->map->world->config["NPCAdjustMaxDam"]));
+        amount = util::rand(this->Data().mindam, this->Data().maxdam + this->map->world->hot_config.npc_adjust_max_dam);
     }
 
     double rand = util::rand(0.0, 1.0);
@@ -2493,6 +2444,9 @@ void NPC::FormulaVars(std::unordered_map<std::string, double> &vars, std::string
 
 NPC::~NPC()
 {
+	this->map->GridRemove(this);
+	this->map->UnscheduleNPC(this);
+
 	UTIL_FOREACH(this->map->characters, character)
 	{
 		if (character->npc == this)
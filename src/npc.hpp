@@ -4,6 +4,8 @@
 #include "fwd/npc.hpp"
 
 #include <list>
+#include <map>
+#include <memory>
 #include <string>
 #include <array>
 #include <unordered_map>
@@ -12,6 +14,7 @@
 #include "fwd/character.hpp"
 #include "fwd/eodata.hpp"
 #include "fwd/map.hpp"
+#include "fwd/world.hpp"
 
 /**
  * Used by the NPC class to store information about an attacker
@@ -59,7 +62,7 @@ struct NPC_Shop_Craft_Ingredient
 struct NPC_Shop_Craft_Item
 {
 	unsigned short id;
-	std::vector<NPC_Shop_Craft_Ingredient *> ingredients;
+	std::vector<NPC_Shop_Craft_Ingredient> ingredients;
 };
 
 /**
@@ -102,6 +105,31 @@ struct NPC_Learn_Skill
 	short strreq, intreq, wisreq, agireq, conreq, chareq;
 };
 
+/**
+ * Drop, shop, skill master and innkeeper data shared by every NPC with the same ENF ID.
+ * Built once per ID by World::LoadNPCPrototypes() and never modified after.
+ */
+struct NPC_Prototype
+{
+	std::vector<NPC_Drop> drops;
+	std::string shop_name;
+	std::string skill_name;
+	std::vector<NPC_Shop_Trade_Item> shop_trade;
+	std::vector<NPC_Shop_Craft_Item> shop_craft;
+	std::vector<NPC_Learn_Skill> skill_learn;
+	std::unique_ptr<NPC_Citizenship> citizenship;
+
+	/**
+	 * Constructs an empty prototype
+	 */
+	NPC_Prototype() { }
+
+	/**
+	 * Reads the prototype of an ENF ID from the world's drops, shops, skills and home configs
+	 */
+	NPC_Prototype(World *world, short id);
+};
+
 /**
  * An instance of an NPC created and managed by a Map
  */
@@ -124,14 +152,8 @@ class NPC
 
 		static void SetSpeedTable(std::array<double, 7> speeds);
 
-		std::vector<NPC_Drop *> drops;
-		std::string shop_name;
-		std::string skill_name;
-		std::vector<NPC_Shop_Trade_Item *> shop_trade;
-		std::vector<NPC_Shop_Craft_Item *> shop_craft;
-		std::vector<NPC_Learn_Skill *> skill_learn;
+		std::shared_ptr<const NPC_Prototype> prototype;
 		std::list<NPC_Opponent *> damagelist;
-		NPC_Citizenship *citizenship;
 		NPC_Marriage *marriage;
 
 		NPC *parent;
@@ -174,8 +196,17 @@ class NPC
         std::list<Character_Item> inventory;
 
 		Map *map;
+		int grid_cell; // Maintained by Map, -1 when not indexed
+
+		// Maintained by Map, schedule_entry is only valid while scheduled is set
+		std::multimap<double, NPC *>::iterator schedule_entry;
+		bool scheduled;
 
 		NPC(Map *map, short id, unsigned char x, unsigned char y, unsigned char spawn_type, short spawn_time, unsigned char index, bool temporary = false, bool pet = false, int spelltimer = 0);
+
+		/**
+		 * Picks up the current prototype of the NPC's ENF ID, after World::LoadNPCPrototypes()
+		 */
 		void LoadShopDrop();
 
 		const ENF_Data& Data() const;
@@ -189,6 +220,11 @@ class NPC
 		void Act();
 
 		bool Walk(Direction);
+
+		/**
+		 * Takes one step towards a tile, around obstacles if NPCChaseMode is 1
+		 */
+		void WalkTowards(unsigned char x, unsigned char y);
 		bool OpenInventory();
 		bool AddItem(short item, int amount);
 		void Effect(Character *from, int effect, int damage);
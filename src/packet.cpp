@@ -167,10 +167,15 @@ std::string PacketProcessor::Decode(const std::string &str)
 
 std::string PacketProcessor::Encode(const std::string &rawstr)
 {
-    if (emulti_e == 0 || ((unsigned char)rawstr[2] == PACKET_A_INIT && (unsigned char)rawstr[3] == PACKET_F_INIT))
+	return PacketProcessor::Encode(rawstr, this->emulti_e);
+}
+
+std::string PacketProcessor::Encode(const std::string &rawstr, unsigned char emulti)
+{
+    if (emulti == 0 || ((unsigned char)rawstr[2] == PACKET_A_INIT && (unsigned char)rawstr[3] == PACKET_F_INIT))
 		return rawstr;
 
-	std::string str = this->DickWinderE(rawstr);
+	std::string str = PacketProcessor::DickWinder(rawstr, emulti);
 	std::string adj_str;
 	int length = str.length();
 	int i = 2;
@@ -691,3 +696,20 @@ PacketBuilder::~PacketBuilder()
 {
 	std::fill(UTIL_RANGE(this->data), '\0');
 }
+
+PacketBroadcast::PacketBroadcast(const PacketBuilder &builder)
+	: raw(builder.Get())
+{ }
+
+const std::string &PacketBroadcast::Get(unsigned char emulti_e)
+{
+	UTIL_FOREACH_CREF(this->encoded, entry)
+	{
+		if (entry.first == emulti_e)
+			return entry.second;
+	}
+
+	this->encoded.push_back(std::make_pair(emulti_e, PacketProcessor::Encode(this->raw, emulti_e)));
+
+	return this->encoded.back().second;
+}
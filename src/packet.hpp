@@ -5,6 +5,8 @@
 
 #include <string>
 #include <array>
+#include <utility>
+#include <vector>
 
 /**
  * Encodes and Decodes packets for a Client.
@@ -53,6 +55,15 @@ class PacketProcessor
 
 		std::string Decode(const std::string &);
 		std::string Encode(const std::string &);
+
+		/**
+		 * Encodes a packet the way a PacketProcessor with the given EMulti would.
+		 * The output depends only on the raw packet and emulti.
+		 */
+		static std::string Encode(const std::string &, unsigned char emulti);
+
+		unsigned char EMultiE() const { return this->emulti_e; }
+
 		static std::string DickWinder(const std::string &, unsigned char emulti);
 		std::string DickWinderE(const std::string &);
 		std::string DickWinderD(const std::string &);
@@ -138,4 +149,24 @@ class PacketBuilder
 		~PacketBuilder();
 };
 
+/**
+ * A packet being sent to many clients.
+ * The packet is serialized once, and encoded once per distinct "EMulti" value
+ * among the recipients instead of once per recipient.
+ */
+class PacketBroadcast
+{
+	protected:
+		std::string raw;
+		std::vector<std::pair<unsigned char, std::string>> encoded;
+
+	public:
+		explicit PacketBroadcast(const PacketBuilder &builder);
+
+		/**
+		 * Returns the packet encoded for a client with the given "EMulti" value
+		 */
+		const std::string &Get(unsigned char emulti_e);
+};
+
 #endif
@@ -163,9 +163,11 @@ void Party::UpdateHP(Character *character)
 	builder.AddShort(character->player->id);
 	builder.AddChar(util::clamp<int>(double(character->hp) / double(character->maxhp) * 100.0, 0, 100));
 
+	PacketBroadcast packet(builder);
+
 	UTIL_FOREACH(this->members, member)
 	{
-		member->Send(builder);
+		member->Send(packet);
 	}
 }
 
@@ -7,7 +7,6 @@
 #include "console.hpp"
 #include "database.hpp"
 #include "eoclient.hpp"
-#include "hash.hpp"
 #include "world.hpp"
 #include "chat.hpp"
 
@@ -15,12 +14,14 @@ Player::Player(std::string username, World *world)
 {
 	this->world = world;
 
+	this->world->WaitForQueued("account:" + username);
+
 	Database_Result res = this->world->db.Query("SELECT `username`, `password` FROM `accounts` WHERE `username` = '$'", username.c_str());
 	if (res.empty())
 	{
 		throw std::runtime_error("Player not found (" + username + ")");
 	}
-	std::unordered_map<std::string, util::variant> row = res.front();
+	Database_Row row = res.front();
 
 	this->login_time = std::time(0);
 
@@ -104,11 +105,6 @@ bool Player::AddCharacter(std::string name, Gender gender, int hairstyle, int ha
 
 void Player::ChangePass(util::secure_string&& password)
 {
-	{
-		util::secure_string password_buffer(std::move(std::string(this->world->config["PasswordSalt"]) + this->username + password.str()));
-		password = sha256(password_buffer.str());
-	}
-
 	this->world->db.Query("UPDATE `accounts` SET `password` = '$' WHERE username = '$'", password.str().c_str(), this->username.c_str());
 }
 
@@ -129,6 +125,11 @@ void Player::Send(const PacketBuilder &builder)
 	this->client->Send(builder);
 }
 
+void Player::Send(PacketBroadcast &packet)
+{
+	this->client->Send(packet);
+}
+
 void Player::Logout()
 {
 	UTIL_FOREACH(this->characters, character)
@@ -144,7 +145,8 @@ void Player::Logout()
 		Console::Dbg("Saving player '%s' (session lasted %i minutes)", this->username.c_str(), int(std::time(0) - this->login_time) / 60);
         #endif
 
-		this->world->db.Query("UPDATE `accounts` SET `lastused` = #, `hdid` = #, `lastip` = '$' WHERE username = '$'", int(std::time(0)), this->client->hdid, static_cast<std::string>(this->client->GetRemoteAddr()).c_str(), this->username.c_str());
+		this->world->QueueExecute("UPDATE `accounts` SET `lastused` = ?, `hdid` = ?, `lastip` = ? WHERE username = ?",
+			Database_Params().Add(int(std::time(0))).Add(this->client->hdid).Add(static_cast<std::string>(this->client->GetRemoteAddr())).Add(this->username), {"account:" + this->username});
 
 		this->client->Close();
 		this->client->player = 0;
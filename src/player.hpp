@@ -33,11 +33,16 @@ class Player
 
 		static bool ValidName(std::string username);
 		bool AddCharacter(std::string name, Gender gender, int hairstyle, int haircolor, Skin race);
+
+		/**
+		 * Stores a password already hashed by World::HashPassword()
+		 */
 		void ChangePass(util::secure_string&& password);
 
         AdminLevel Admin() const;
 
 		void Send(const PacketBuilder &);
+		void Send(PacketBroadcast &);
 
 		void Logout();
 
@@ -809,7 +809,7 @@ bool Quest_Context::DoAction(const EOPlus::Action& action)
             }
 
             NPC *npc = new NPC(this->character->map, id, this->character->x, this->character->y, 1, 1, index, true);
-            this->character->map->npcs.push_back(npc);
+            this->character->map->AddNPC(npc);
             npc->Spawn();
         }
 	}
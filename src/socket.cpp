@@ -1,6 +1,7 @@
 #include "socket.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <cstddef>
 #include <cstring>
@@ -10,6 +11,12 @@
 
 #include "socket_impl.hpp"
 
+#ifdef SOCKET_EPOLL
+#include <pthread.h>
+#endif // SOCKET_EPOLL
+
+#include "util/spsc_queue.hpp"
+
 #ifdef WIN32
 static WSADATA socket_wsadata;
 #endif
@@ -57,6 +64,8 @@ const char *OSErrorString()
 const char *OSErrorString()
 {
 	eoserv_strlcpy(ErrorBuf, strerror(errno), sizeof(ErrorBuf));
+
+	return ErrorBuf;
 }
 #endif // WIN32
 
@@ -201,12 +210,108 @@ struct Client::impl_
 	SOCKET sock;
 	sockaddr_in sin;
 
+	// Events currently registered with the server's epoll instance
+	std::uint32_t events;
+
+	// Client is in the server's list of clients to check next Select()
+	bool scheduled;
+
+	// Network thread which owns the socket and buffers, if any
+	Socket_IOThread *io;
+
+	// Data sent from the main thread waiting to be buffered by the network thread
+	std::unique_ptr<util::spsc_queue<std::string>> outbound;
+
+	// Client is waiting in one of the network thread's queues
+	std::atomic<bool> queued_ready;
+	std::atomic<bool> queued_send;
+	std::atomic<bool> queued_recv;
+
+	// Set by the network thread, the main thread closes the client when it sees it
+	std::atomic<bool> io_error;
+
+	// Removal has been requested from / confirmed by the network thread
+	bool retired;
+	std::atomic<bool> released;
+
 	impl_(const SOCKET &sock = SOCKET(), const sockaddr_in &sin = sockaddr_in())
 		: sock(sock)
 		, sin(sin)
+		, events(0)
+		, scheduled(false)
+		, io(0)
+		, queued_ready(false)
+		, queued_send(false)
+		, queued_recv(false)
+		, io_error(false)
+		, retired(false)
+		, released(false)
 	{ }
 };
 
+/**
+ * A network thread servicing a share of a Server's clients with its own epoll instance
+ */
+struct Socket_IOThread
+{
+	Server *server;
+
+	// Listening socket if this thread accepts new connections
+	SOCKET listen_sock;
+
+	int epfd;
+	std::atomic<bool> running;
+
+	// Main thread -> network thread
+	util::spsc_queue<Client *> added;
+	util::spsc_queue<Client *> sending;
+	util::spsc_queue<Client *> receiving;
+	util::spsc_queue<Client *> retired;
+
+	// Network thread -> main thread
+	util::spsc_queue<Client *> ready;
+	util::spsc_queue<Socket> accepted;
+
+	// Clients that didn't fit in to the ready queue
+	std::vector<Client *> blocked;
+
+	// Main thread only, clients that didn't fit in to the sending and receiving queues
+	std::vector<Client *> unsent;
+	std::vector<Client *> unreceived;
+
+#ifdef SOCKET_EPOLL
+	pthread_t thread;
+#endif // SOCKET_EPOLL
+
+	Socket_IOThread(Server *server, std::size_t capacity)
+		: server(server)
+		, listen_sock(INVALID_SOCKET)
+		, epfd(-1)
+		, running(false)
+		, added(capacity)
+		, sending(capacity)
+		, receiving(capacity)
+		, retired(capacity)
+		, ready(capacity)
+		, accepted(capacity)
+	{ }
+
+	static void *Run(void *);
+
+	void Loop();
+	void Accept();
+	void Add(Client *);
+	void Flush(Client *);
+	void Resume(Client *);
+	void Retire(Client *);
+	void Fail(Client *);
+	void MarkReady(Client *);
+
+	// Main thread side
+	void Retry();
+	void Forget(Client *);
+};
+
 Client::Client()
 	: impl(new impl_(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)))
 	, server(0)
@@ -322,105 +427,202 @@ void Client::Bind(const IPAddress &addr, uint16_t port)
 	}
 }
 
+std::size_t Client::Peek(char *buf, std::size_t length) const
+{
+	length = std::min(length, this->recv_buffer_used);
+
+	// The data can wrap around the end of the ring buffer, so copy it in at most two pieces
+	const std::size_t start = (this->recv_buffer_gpos + 1) & (this->recv_buffer.length() - 1);
+	const std::size_t first = std::min(length, this->recv_buffer.length() - start);
+
+	std::memcpy(buf, this->recv_buffer.data() + start, first);
+	std::memcpy(buf + first, this->recv_buffer.data(), length - first);
+
+	return length;
+}
+
+void Client::Discard(std::size_t length)
+{
+	length = std::min(length, this->recv_buffer_used);
+
+	const bool was_full = (this->recv_buffer_used == this->recv_buffer.length());
+
+	this->recv_buffer_gpos = (this->recv_buffer_gpos + length) & (this->recv_buffer.length() - 1);
+	this->recv_buffer_used -= length;
+
+	if (was_full && length > 0)
+		this->UpdateEvents();
+}
+
 std::string Client::Recv(std::size_t length)
 {
 	length = std::min(length, this->recv_buffer_used);
 
 	std::string ret(length, char());
 
-	const std::size_t mask = this->recv_buffer.length() - 1;
-
-	for (std::size_t i = 0; i < length; ++i)
+	if (length > 0)
 	{
-		this->recv_buffer_gpos = (this->recv_buffer_gpos + 1) & mask;
-		ret[i] = this->recv_buffer[this->recv_buffer_gpos];
-		//this->recv_buffer[this->recv_buffer_gpos] = '\0';
+		this->Peek(&ret[0], length);
+		this->Discard(length);
 	}
 
-	this->recv_buffer_used -= length;
-
 	return ret;
 }
 
+bool Client::Buffer(const char *data, std::size_t length)
+{
+	if (length > this->send_buffer.length() - this->send_buffer_used)
+		return false;
+
+	const std::size_t start = (this->send_buffer_ppos + 1) & (this->send_buffer.length() - 1);
+	const std::size_t first = std::min(length, this->send_buffer.length() - start);
+
+	std::memcpy(&this->send_buffer[start], data, first);
+
+	if (length > first)
+		std::memcpy(&this->send_buffer[0], data + first, length - first);
+
+	this->send_buffer_ppos = (this->send_buffer_ppos + length) & (this->send_buffer.length() - 1);
+	this->send_buffer_used += length;
+
+	return true;
+}
+
 void Client::Send(const std::string &data)
 {
-	if (data.length() > this->send_buffer.length() - this->send_buffer_used)
+	if (this->impl->io)
 	{
-		this->Close(true);
+		if (this->impl->retired)
+			return;
+
+		if (!this->impl->outbound->push(data))
+		{
+			this->Close(true);
+			return;
+		}
+
+		// Left flagged if the queue is full, so it's pushed again by the next Select()
+		if (!this->impl->queued_send.exchange(true))
+		{
+			if (!this->impl->io->sending.push(this))
+				this->impl->io->unsent.push_back(this);
+		}
+
 		return;
 	}
 
-	const std::size_t mask = this->send_buffer.length() - 1;
+	const bool was_empty = (this->send_buffer_used == 0);
 
-	for (std::size_t i = 0; i < data.length(); ++i)
+	if (!this->Buffer(data))
 	{
-		this->send_buffer_ppos = (this->send_buffer_ppos + 1) & mask;
-		this->send_buffer[this->send_buffer_ppos] = data[i];
+		this->Close(true);
+		return;
 	}
 
-	this->send_buffer_used += data.length();
+	// Write interest only needs to change when the buffer stops being empty
+	if (was_empty && this->send_buffer_used > 0)
+		this->UpdateEvents();
 }
 
 bool Client::DoRecv()
 {
-	char buf[8192];
-
-	const int to_recv = std::min(this->recv_buffer.length() - this->recv_buffer_used, sizeof(buf));
+	const std::size_t mask = this->recv_buffer.length() - 1;
+	const std::size_t to_recv = this->recv_buffer.length() - this->recv_buffer_used;
 
 	if (to_recv == 0)
 		return false;
 
-	const int recieved = recv(this->impl->sock, buf, to_recv, 0);
+	// Read straight in to the free space of the ring buffer, which may be split in two
+	const std::size_t start = (this->recv_buffer_ppos + 1) & mask;
+	const std::size_t first = std::min(to_recv, this->recv_buffer.length() - start);
 
-	if (recieved > 0)
-	{
-		const std::size_t mask = this->recv_buffer.length() - 1;
+#ifdef WIN32
+	const int recieved = recv(this->impl->sock, &this->recv_buffer[start], first, 0);
+#else // WIN32
+	iovec iov[2];
+	iov[0].iov_base = &this->recv_buffer[start];
+	iov[0].iov_len = first;
+	iov[1].iov_base = &this->recv_buffer[0];
+	iov[1].iov_len = to_recv - first;
 
-		for (int i = 0; i < recieved; ++i)
-		{
-			this->recv_buffer_ppos = (this->recv_buffer_ppos + 1) & mask;
-			this->recv_buffer[this->recv_buffer_ppos] = buf[i];
-		}
+	const int recieved = readv(this->impl->sock, iov, (iov[1].iov_len > 0) ? 2 : 1);
+#endif // WIN32
 
-		this->recv_buffer_used += recieved;
-	}
-	else
+	if (recieved <= 0)
 	{
 		return false;
 	}
 
+	this->recv_buffer_ppos = (this->recv_buffer_ppos + recieved) & mask;
+	this->recv_buffer_used += recieved;
+
 	return true;
 }
 
 bool Client::DoSend()
 {
-	char buf[8192];
-
 	const std::size_t mask = this->send_buffer.length() - 1;
-	const std::size_t gpos = this->send_buffer_gpos;
-
-	std::size_t to_send;
 
-	for (to_send = 0; to_send < std::min(this->send_buffer_used, sizeof(buf)); ++to_send)
-	{
-		this->send_buffer_gpos = (this->send_buffer_gpos + 1) & mask;
+	// Write straight out of the ring buffer, which may be split in two
+	const std::size_t start = (this->send_buffer_gpos + 1) & mask;
+	const std::size_t first = std::min(this->send_buffer_used, this->send_buffer.length() - start);
 
-		buf[to_send] = this->send_buffer[this->send_buffer_gpos];
-	}
-
-	const int written = send(this->impl->sock, buf, to_send, 0);
+#ifdef WIN32
+	const int written = send(this->impl->sock, &this->send_buffer[start], first, 0);
+#else // WIN32
+	iovec iov[2];
+	iov[0].iov_base = &this->send_buffer[start];
+	iov[0].iov_len = first;
+	iov[1].iov_base = &this->send_buffer[0];
+	iov[1].iov_len = this->send_buffer_used - first;
+
+	msghdr msg;
+	std::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = (iov[1].iov_len > 0) ? 2 : 1;
+
+	const int written = sendmsg(this->impl->sock, &msg, MSG_NOSIGNAL);
+#endif // WIN32
 
 	if (written < 0 || written == SOCKET_ERROR)
 	{
 	    return false;
 	}
 
-	this->send_buffer_gpos = (gpos + written) & mask;
+	this->send_buffer_gpos = (this->send_buffer_gpos + written) & mask;
 	this->send_buffer_used -= written;
 
 	return true;
 }
 
+void Client::UpdateEvents()
+{
+	if (this->server)
+		this->server->UpdateEvents(this);
+}
+
+void Client::ResumeReceive()
+{
+	if (!this->impl->io || this->impl->retired)
+		return;
+
+	if (!this->impl->queued_recv.exchange(true))
+	{
+		if (!this->impl->io->receiving.push(this))
+			this->impl->io->unreceived.push_back(this);
+	}
+}
+
+bool Client::Threaded() const
+{
+	return this->impl->io != 0;
+}
+
+std::size_t Client::SendQueueSize() const
+{
+	return this->impl->outbound ? this->impl->outbound->size() : 0;
+}
+
 #if defined(SOCKET_POLL) && !defined(WIN32)
 bool Client::Select(double timeout)
 {
@@ -585,9 +787,63 @@ struct Server::impl_
 	fd_set except_fds;
 	SOCKET sock;
 
+	Server::Backend backend;
+
+#ifdef SOCKET_EPOLL
+	int epfd;
+	std::vector<epoll_event> events;
+#endif // SOCKET_EPOLL
+
+	// Clients which had data left over or were woken since the last Select()
+	std::vector<Client *> scheduled;
+	std::vector<Client *> selected;
+
+	// Network threads, empty if networking is done in Select()
+	int io_threads;
+	std::vector<Socket_IOThread *> io;
+	std::size_t io_next;
+
 	impl_(const SOCKET &sock = INVALID_SOCKET)
 		: sock(sock)
+#ifdef SOCKET_POLL
+		, backend(Server::BackendPoll)
+#else
+		, backend(Server::BackendSelect)
+#endif
+#ifdef SOCKET_EPOLL
+		, epfd(-1)
+#endif // SOCKET_EPOLL
+		, io_threads(0)
+		, io_next(0)
 	{ }
+
+	void Schedule(Client *client)
+	{
+		if (!client->impl->scheduled)
+		{
+			client->impl->scheduled = true;
+			this->scheduled.push_back(client);
+		}
+	}
+
+	// Collect clients the network threads have flagged since the last call
+	void DrainReady()
+	{
+		Client *client;
+
+		UTIL_FOREACH(this->io, io)
+		{
+			while (io->ready.pop(client))
+			{
+				client->impl->queued_ready = false;
+
+				if (client->impl->io_error)
+					client->Close(true);
+
+				this->Schedule(client);
+			}
+		}
+	}
 };
 
 Server::Server()
@@ -608,6 +864,493 @@ Server::Server(const IPAddress &addr, uint16_t port)
 	this->Bind(addr, port);
 }
 
+Server::Backend Server::ParseBackend(const std::string &name)
+{
+	std::string lname = util::lowercase(util::trim(name));
+
+	if (lname == "epoll")
+		return BackendEpoll;
+	else if (lname == "poll")
+		return BackendPoll;
+	else if (lname == "select")
+		return BackendSelect;
+
+	return BackendEpoll;
+}
+
+Server::Backend Server::SetBackend(Backend backend)
+{
+#ifndef SOCKET_EPOLL
+	if (backend == BackendEpoll)
+		backend = BackendPoll;
+#endif // SOCKET_EPOLL
+
+#ifdef WIN32
+	if (backend == BackendPoll)
+		backend = BackendSelect;
+#endif // WIN32
+
+	if (backend == this->impl->backend || !this->impl->io.empty())
+		return this->impl->backend;
+
+#ifdef SOCKET_EPOLL
+	if (this->impl->backend == BackendEpoll)
+	{
+		close(this->impl->epfd);
+		this->impl->epfd = -1;
+		this->impl->events.clear();
+
+		UTIL_FOREACH(this->clients, client)
+		{
+			client->impl->events = 0;
+		}
+	}
+
+	if (backend == BackendEpoll)
+	{
+		this->impl->epfd = epoll_create1(EPOLL_CLOEXEC);
+
+		if (this->impl->epfd == -1)
+		{
+			backend = BackendPoll;
+		}
+		else
+		{
+			this->impl->events.resize(256);
+			this->impl->backend = backend;
+
+			UTIL_FOREACH(this->clients, client)
+			{
+				this->Register(client);
+			}
+		}
+	}
+#endif // SOCKET_EPOLL
+
+	return this->impl->backend = backend;
+}
+
+Server::Backend Server::GetBackend() const
+{
+	return this->impl->backend;
+}
+
+void Server::Register(Client *client)
+{
+	if (!this->impl->io.empty())
+	{
+		Socket_IOThread *io = this->impl->io[this->impl->io_next++ % this->impl->io.size()];
+
+		client->impl->io = io;
+		client->impl->outbound.reset(new util::spsc_queue<std::string>(256));
+
+		if (!io->added.push(client))
+			client->Close(true);
+
+		return;
+	}
+
+#ifdef SOCKET_EPOLL
+	if (this->impl->backend != BackendEpoll)
+		return;
+
+	epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = client;
+
+	if (epoll_ctl(this->impl->epfd, EPOLL_CTL_ADD, client->impl->sock, &ev) == -1)
+	{
+		client->Close(true);
+		return;
+	}
+
+	client->impl->events = EPOLLIN;
+	this->UpdateEvents(client);
+#else // SOCKET_EPOLL
+	(void)client;
+#endif // SOCKET_EPOLL
+}
+
+void Server::Unregister(Client *client)
+{
+	if (client->impl->scheduled)
+	{
+		this->impl->scheduled.erase(std::find(UTIL_RANGE(this->impl->scheduled), client));
+		client->impl->scheduled = false;
+	}
+
+#ifdef SOCKET_EPOLL
+	if (this->impl->backend == BackendEpoll && !client->impl->io)
+	{
+		// Pre-2.6.9 kernels require a non-null event pointer for EPOLL_CTL_DEL
+		epoll_event ev;
+		epoll_ctl(this->impl->epfd, EPOLL_CTL_DEL, client->impl->sock, &ev);
+		client->impl->events = 0;
+	}
+#endif // SOCKET_EPOLL
+}
+
+void Server::UpdateEvents(Client *client)
+{
+#ifdef SOCKET_EPOLL
+	if (this->impl->backend != BackendEpoll || client->impl->io_error)
+		return;
+
+	std::uint32_t events = 0;
+
+	if (client->recv_buffer_used != client->recv_buffer.length())
+		events |= EPOLLIN;
+
+	if (client->send_buffer_used > 0)
+		events |= EPOLLOUT;
+
+	if (events == client->impl->events)
+		return;
+
+	epoll_event ev;
+	ev.events = events;
+	ev.data.ptr = client;
+
+	const int epfd = client->impl->io ? client->impl->io->epfd : this->impl->epfd;
+
+	if (epoll_ctl(epfd, EPOLL_CTL_MOD, client->impl->sock, &ev) == -1)
+	{
+		if (client->impl->io)
+			client->impl->io->Fail(client);
+		else
+			client->Close(true);
+
+		return;
+	}
+
+	client->impl->events = events;
+#else // SOCKET_EPOLL
+	(void)client;
+#endif // SOCKET_EPOLL
+}
+
+void Server::Wake(Client *client)
+{
+	if (this->impl->backend == BackendEpoll)
+		this->impl->Schedule(client);
+}
+
+int Server::SetIOThreads(int threads)
+{
+	if (this->impl->backend != BackendEpoll || !this->impl->io.empty())
+		threads = 0;
+
+	return this->impl->io_threads = std::max(threads, 0);
+}
+
+#ifdef SOCKET_EPOLL
+void *Socket_IOThread::Run(void *io_void)
+{
+	static_cast<Socket_IOThread *>(io_void)->Loop();
+	return 0;
+}
+
+void Socket_IOThread::Loop()
+{
+	std::vector<epoll_event> events(256);
+	Client *client;
+
+	while (this->running.load(std::memory_order_acquire))
+	{
+		while (this->added.pop(client))
+			this->Add(client);
+
+		while (this->sending.pop(client))
+		{
+			client->impl->queued_send = false;
+			this->Flush(client);
+		}
+
+		while (this->receiving.pop(client))
+			this->Resume(client);
+
+		while (this->retired.pop(client))
+			this->Retire(client);
+
+		if (!this->blocked.empty())
+		{
+			std::vector<Client *> blocked;
+			blocked.swap(this->blocked);
+
+			UTIL_FOREACH(blocked, client)
+			{
+				if (!this->ready.push(client))
+					this->blocked.push_back(client);
+			}
+		}
+
+		// Short timeout so queued writes from the main thread are picked up promptly
+		int result = epoll_wait(this->epfd, &events[0], events.size(), 1);
+
+		for (int i = 0; i < result; ++i)
+		{
+			client = static_cast<Client *>(events[i].data.ptr);
+			std::uint32_t revents = events[i].events;
+
+			if (!client)
+			{
+				this->Accept();
+				continue;
+			}
+
+			if (client->impl->io_error)
+				continue;
+
+			if (revents & EPOLLERR || revents & EPOLLHUP)
+			{
+				this->Fail(client);
+				continue;
+			}
+
+			if (revents & EPOLLIN && client->recv_buffer_used != client->recv_buffer.length())
+			{
+				if (!client->DoRecv())
+				{
+					this->Fail(client);
+					continue;
+				}
+
+				client->Received();
+				this->MarkReady(client);
+			}
+
+			if (revents & EPOLLOUT && client->send_buffer_used > 0)
+			{
+				if (!client->DoSend())
+				{
+					this->Fail(client);
+					continue;
+				}
+
+				this->Flush(client);
+			}
+
+			this->server->UpdateEvents(client);
+		}
+	}
+}
+
+void Socket_IOThread::Accept()
+{
+	SOCKET newsock;
+	sockaddr_in sin;
+	socklen_t addrsize = sizeof(sockaddr_in);
+
+	while ((newsock = accept(this->listen_sock, reinterpret_cast<sockaddr *>(&sin), &addrsize)) != INVALID_SOCKET)
+	{
+		if (!this->accepted.push(Socket(newsock, sin)))
+			close(newsock);
+
+		addrsize = sizeof(sockaddr_in);
+	}
+}
+
+void Socket_IOThread::Add(Client *client)
+{
+	epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = client;
+
+	if (epoll_ctl(this->epfd, EPOLL_CTL_ADD, client->impl->sock, &ev) == -1)
+	{
+		this->Fail(client);
+		return;
+	}
+
+	client->impl->events = EPOLLIN;
+	this->Flush(client);
+}
+
+void Socket_IOThread::Flush(Client *client)
+{
+	std::string *data;
+
+	while ((data = client->impl->outbound->front()) != 0)
+	{
+		if (data->length() > client->send_buffer.length())
+		{
+			// Would never fit, same as overflowing the send buffer directly
+			this->Fail(client);
+			return;
+		}
+
+		if (!client->Buffer(*data))
+			break;
+
+		client->impl->outbound->pop();
+	}
+
+	this->server->UpdateEvents(client);
+}
+
+void Socket_IOThread::Resume(Client *client)
+{
+	client->impl->queued_recv = false;
+
+	if (client->impl->io_error)
+		return;
+
+	// Complete packets left in a full receive buffer would otherwise wait for bytes that can't arrive
+	std::size_t used = client->recv_buffer_used;
+	client->Received();
+
+	if (client->recv_buffer_used != used)
+		this->MarkReady(client);
+}
+
+void Socket_IOThread::Retire(Client *client)
+{
+	Client *other;
+
+	// Anything the main thread queued before retiring the client has to be dealt with first
+	while (this->added.pop(other))
+		this->Add(other);
+
+	while (this->sending.pop(other))
+	{
+		other->impl->queued_send = false;
+
+		if (other != client)
+			this->Flush(other);
+	}
+
+	while (this->receiving.pop(other))
+	{
+		if (other != client)
+			this->Resume(other);
+		else
+			other->impl->queued_recv = false;
+	}
+
+	this->blocked.erase(std::remove(UTIL_RANGE(this->blocked), client), this->blocked.end());
+
+	epoll_event ev;
+	epoll_ctl(this->epfd, EPOLL_CTL_DEL, client->impl->sock, &ev);
+	close(client->impl->sock);
+
+	client->impl->released.store(true, std::memory_order_release);
+}
+
+void Socket_IOThread::Fail(Client *client)
+{
+	epoll_event ev;
+	epoll_ctl(this->epfd, EPOLL_CTL_DEL, client->impl->sock, &ev);
+	client->impl->events = 0;
+
+	client->impl->io_error = true;
+	this->MarkReady(client);
+}
+
+void Socket_IOThread::MarkReady(Client *client)
+{
+	if (!client->impl->queued_ready.exchange(true))
+	{
+		if (!this->ready.push(client))
+			this->blocked.push_back(client);
+	}
+}
+
+void Socket_IOThread::Retry()
+{
+	std::vector<Client *> clients;
+
+	clients.swap(this->unsent);
+
+	UTIL_FOREACH(clients, client)
+	{
+		if (!this->sending.push(client))
+			this->unsent.push_back(client);
+	}
+
+	clients.clear();
+	clients.swap(this->unreceived);
+
+	UTIL_FOREACH(clients, client)
+	{
+		if (!this->receiving.push(client))
+			this->unreceived.push_back(client);
+	}
+}
+
+void Socket_IOThread::Forget(Client *client)
+{
+	this->unsent.erase(std::remove(UTIL_RANGE(this->unsent), client), this->unsent.end());
+	this->unreceived.erase(std::remove(UTIL_RANGE(this->unreceived), client), this->unreceived.end());
+}
+
+void Server::StartIO()
+{
+	std::size_t capacity = std::max<std::size_t>(this->maxconn * 2, 1024);
+
+	// The listening socket is only ever touched by the first thread from now on
+	fcntl(this->impl->sock, F_SETFL, O_NONBLOCK);
+
+	for (int i = 0; i < this->impl->io_threads; ++i)
+	{
+		Socket_IOThread *io = new Socket_IOThread(this, capacity);
+		io->epfd = epoll_create1(EPOLL_CLOEXEC);
+
+		if (io->epfd == -1)
+		{
+			delete io;
+			break;
+		}
+
+		if (i == 0)
+		{
+			epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.ptr = 0;
+
+			io->listen_sock = this->impl->sock;
+			epoll_ctl(io->epfd, EPOLL_CTL_ADD, io->listen_sock, &ev);
+		}
+
+		io->running = true;
+
+		if (pthread_create(&io->thread, 0, Socket_IOThread::Run, io) != 0)
+		{
+			close(io->epfd);
+			delete io;
+			break;
+		}
+
+		this->impl->io.push_back(io);
+	}
+
+	if (this->impl->io.empty())
+		fcntl(this->impl->sock, F_SETFL, 0);
+
+	// Clients accepted before the threads started are handed over too
+	UTIL_FOREACH(this->clients, client)
+	{
+		this->Unregister(client);
+		this->Register(client);
+	}
+}
+
+void Server::StopIO()
+{
+	UTIL_FOREACH(this->impl->io, io)
+	{
+		io->running = false;
+		pthread_join(io->thread, 0);
+		close(io->epfd);
+		delete io;
+	}
+
+	this->impl->io.clear();
+}
+#else // SOCKET_EPOLL
+void Server::StartIO() { }
+void Server::StopIO() { }
+#endif // SOCKET_EPOLL
+
 void Server::Bind(const IPAddress &addr, uint16_t port)
 {
 	sockaddr_in sin;
@@ -636,6 +1379,10 @@ void Server::Listen(int maxconn, int backlog)
     if (listen(this->impl->sock, backlog) != SOCKET_ERROR)
     {
         this->state = Listening;
+
+        if (this->impl->io_threads > 0)
+            this->StartIO();
+
         return;
     }
 
@@ -653,6 +1400,24 @@ Client *Server::Poll()
 	unsigned long nonblocking;
 #endif // WIN32
 
+	if (!this->impl->io.empty())
+	{
+		Socket sock;
+
+		// Connections are accepted by the first network thread
+		if (!this->impl->io[0]->accepted.pop(sock))
+			return 0;
+
+		newclient = this->ClientFactory(sock);
+		newclient->SetRecvBuffer(this->recv_buffer_max);
+		newclient->SetSendBuffer(this->send_buffer_max);
+
+		this->clients.push_back(newclient);
+		this->Register(newclient);
+
+		return newclient;
+	}
+
 #ifdef WIN32
 	nonblocking = 1;
 	ioctlsocket(this->impl->sock, FIONBIO, &nonblocking);
@@ -684,14 +1449,133 @@ Client *Server::Poll()
 	newclient->SetSendBuffer(this->send_buffer_max);
 
 	this->clients.push_back(newclient);
+	this->Register(newclient);
 
 	return newclient;
 }
 
-#if defined(SOCKET_POLL) && !defined(WIN32)
 std::vector<Client *> *Server::Select(double timeout)
 {
-	static std::vector<Client *> selected;
+	if (!this->impl->io.empty())
+		return this->SelectThreaded(timeout);
+
+	switch (this->impl->backend)
+	{
+		case BackendEpoll: return this->SelectEpoll(timeout);
+		case BackendPoll: return this->SelectPoll(timeout);
+		default: return this->SelectSelect(timeout);
+	}
+}
+
+#ifdef SOCKET_EPOLL
+std::vector<Client *> *Server::SelectEpoll(double timeout)
+{
+	std::vector<Client *> &selected = this->impl->selected;
+
+	int result = epoll_wait(this->impl->epfd, &this->impl->events[0], this->impl->events.size(), int(timeout * 1000));
+
+	if (result == -1)
+	{
+		throw Socket_SelectFailed(OSErrorString());
+	}
+
+	for (int i = 0; i < result; ++i)
+	{
+		Client *client = static_cast<Client *>(this->impl->events[i].data.ptr);
+		std::uint32_t revents = this->impl->events[i].events;
+
+		if (revents & EPOLLERR || revents & EPOLLHUP)
+		{
+			client->Close(true);
+			continue;
+		}
+
+		if (revents & EPOLLIN && client->recv_buffer_used != client->recv_buffer.length())
+		{
+			if (!client->DoRecv())
+			{
+				client->Close(true);
+				continue;
+			}
+		}
+
+		if (revents & EPOLLOUT && client->send_buffer_used > 0)
+		{
+			if (!client->DoSend())
+			{
+				client->Close(true);
+				continue;
+			}
+		}
+
+		this->UpdateEvents(client);
+		this->impl->Schedule(client);
+	}
+
+	// Only clients with buffered data or pending work are handed back, and
+	// they remain scheduled until they have nothing left to process
+	std::vector<Client *> scheduled;
+	scheduled.swap(this->impl->scheduled);
+
+	UTIL_FOREACH(scheduled, client)
+	{
+		client->impl->scheduled = false;
+
+		if (client->recv_buffer_used > 0 || client->NeedTick())
+		{
+			selected.push_back(client);
+			this->impl->Schedule(client);
+		}
+	}
+
+	return &selected;
+}
+#else // SOCKET_EPOLL
+std::vector<Client *> *Server::SelectEpoll(double timeout)
+{
+	return this->SelectPoll(timeout);
+}
+#endif // SOCKET_EPOLL
+
+std::vector<Client *> *Server::SelectThreaded(double timeout)
+{
+	std::vector<Client *> &selected = this->impl->selected;
+
+	UTIL_FOREACH(this->impl->io, io)
+	{
+		io->Retry();
+	}
+
+	this->impl->DrainReady();
+
+	// Nothing to do, so give the network threads a chance to catch up
+	if (this->impl->scheduled.empty())
+	{
+		util::sleep(timeout);
+		this->impl->DrainReady();
+	}
+
+	std::vector<Client *> scheduled;
+	scheduled.swap(this->impl->scheduled);
+
+	UTIL_FOREACH(scheduled, client)
+	{
+		client->impl->scheduled = false;
+
+		if (client->NeedTick())
+		{
+			selected.push_back(client);
+			this->impl->Schedule(client);
+		}
+	}
+
+	return &selected;
+}
+
+#ifndef WIN32
+std::vector<Client *> *Server::SelectPoll(double timeout)
+{
+	std::vector<Client *> &selected = this->impl->selected;
 	std::vector<pollfd> fds;
 	int result;
 	pollfd fd;
@@ -730,7 +1614,7 @@ std::vector<Client *> *Server::Select(double timeout)
 
 	if (result > 0)
 	{
-		if (fds[0].revents & POLLERR == POLLERR)
+		if (fds[0].revents & POLLERR)
 		{
 			throw Socket_Exception("There was an exception on the listening socket.");
 		}
@@ -775,12 +1659,18 @@ std::vector<Client *> *Server::Select(double timeout)
 
 	return &selected;
 }
-#else
-std::vector<Client *> *Server::Select(double timeout)
+#else // WIN32
+std::vector<Client *> *Server::SelectPoll(double timeout)
+{
+	return this->SelectSelect(timeout);
+}
+#endif // WIN32
+
+std::vector<Client *> *Server::SelectSelect(double timeout)
 {
 	long tsecs = long(timeout);
 	timeval timeout_val = {tsecs, long((timeout - double(tsecs))*1000000)};
-	static std::vector<Client *> selected;
+	std::vector<Client *> &selected = this->impl->selected;
 	SOCKET nfds = this->impl->sock;
 	int result;
 
@@ -862,7 +1752,6 @@ std::vector<Client *> *Server::Select(double timeout)
 
 	return &selected;
 }
-#endif
 
 void Server::BuryTheDead()
 {
@@ -873,11 +1762,36 @@ void Server::BuryTheDead()
 
 		if (!client->Connected() && ((client->send_buffer.length() == 0 && client->recv_buffer.length() == 0) || client->closed_time + 2 < std::time(0)))
 		{
-            #ifdef WIN32
-			closesocket(client->impl->sock);
-            #else
-			close(client->impl->sock);
-            #endif
+			if (client->impl->io)
+			{
+				// The network thread closes the socket, wait until it lets go of the client
+				if (!client->impl->retired)
+				{
+					client->impl->retired = client->impl->io->retired.push(client);
+
+					if (client->impl->retired)
+						client->impl->io->Forget(client);
+
+					continue;
+				}
+
+				if (!client->impl->released.load(std::memory_order_acquire))
+					continue;
+
+				this->impl->DrainReady();
+				this->Unregister(client);
+			}
+			else
+			{
+				this->Unregister(client);
+
+                #ifdef WIN32
+				closesocket(client->impl->sock);
+                #else
+				close(client->impl->sock);
+                #endif
+			}
+
 			delete client;
 			this->clients.erase(it);
 			goto restart_loop;
@@ -887,6 +1801,13 @@ void Server::BuryTheDead()
 
 Server::~Server()
 {
+	this->StopIO();
+
+#ifdef SOCKET_EPOLL
+	if (this->impl->epfd != -1)
+		close(this->impl->epfd);
+#endif // SOCKET_EPOLL
+
     #ifdef WIN32
 	closesocket(this->impl->sock);
     #else
@@ -204,6 +204,7 @@ namespace std
 // TODO: Merge Client and Server with Socket
 
 struct Socket;
+struct Socket_IOThread;
 
 /**
  * Generic TCP client class.
@@ -230,6 +231,13 @@ class Client
 		std::size_t send_buffer_ppos;
 		std::size_t send_buffer_used;
 
+		/**
+		 * Copy data in to the send buffer.
+		 * @return false if there is not enough space
+		 */
+		bool Buffer(const char *data, std::size_t length);
+		bool Buffer(const std::string &data) { return this->Buffer(data.data(), data.length()); }
+
 	public:
 		Client();
 		Client(const IPAddress &addr, std::uint16_t port);
@@ -238,6 +246,30 @@ class Client
 
 		virtual bool NeedTick() { return false; }
 
+		/**
+		 * Called after new data has been read in to the receive buffer.
+		 * When network threads are enabled this runs on the network thread.
+		 */
+		virtual void Received() { }
+
+		/**
+		 * Asks the network thread to call Received() again, for when it stopped early
+		 * because whatever it passes packets on to was full and that has since been emptied.
+		 * Does nothing if the client isn't threaded.
+		 */
+		void ResumeReceive();
+
+		/**
+		 * Returns true if this client's socket is serviced by a network thread.
+		 * Recv() must not be called from outside Received() if it is.
+		 */
+		bool Threaded() const;
+
+		/**
+		 * Number of writes waiting to be picked up by the network thread.
+		 */
+		std::size_t SendQueueSize() const;
+
 		void SetRecvBuffer(std::size_t size);
 		void SetSendBuffer(std::size_t size);
 
@@ -248,11 +280,28 @@ class Client
 		std::size_t SendBufferRemaining() { return this->send_buffer.length() - this->send_buffer_used; }
 
 		std::string Recv(std::size_t length);
+
+		/**
+		 * Copy data from the receive buffer without removing it.
+		 * @return Number of bytes copied
+		 */
+		std::size_t Peek(char *buf, std::size_t length) const;
+
+		/**
+		 * Remove data from the receive buffer without copying it.
+		 */
+		void Discard(std::size_t length);
 		void Send(const std::string &data);
 
 		bool DoRecv();
 		bool DoSend();
 
+		/**
+		 * Ask the owning server to refresh the readiness events this client is
+		 * waiting on. Should be called after modifying the buffers directly.
+		 */
+		void UpdateEvents();
+
 		bool Select(double timeout);
 
 		bool Connected() const;
@@ -266,6 +315,7 @@ class Client
 
 	// TODO: Separate Socket type
 	friend class Server;
+	friend struct Socket_IOThread;
 };
 
 /**
@@ -297,11 +347,40 @@ class Server
 			Listening
 		};
 
+		enum Backend
+		{
+			/**
+			 * Portable select() call, rebuilds the descriptor sets every call.
+			 */
+			BackendSelect,
+
+			/**
+			 * POSIX poll() call, rebuilds the descriptor list every call.
+			 */
+			BackendPoll,
+
+			/**
+			 * Linux epoll, clients are registered once and only ready clients are visited.
+			 */
+			BackendEpoll
+		};
+
 	private:
 		struct impl_;
 
 		impl_ *impl;
 
+		void Register(Client *);
+		void Unregister(Client *);
+
+		void StartIO();
+		void StopIO();
+
+		std::vector<Client *> *SelectSelect(double timeout);
+		std::vector<Client *> *SelectPoll(double timeout);
+		std::vector<Client *> *SelectEpoll(double timeout);
+		std::vector<Client *> *SelectThreaded(double timeout);
+
 	protected:
 		virtual Client *ClientFactory(const Socket &sock) { return new Client(sock, this); }
 
@@ -392,6 +471,42 @@ class Server
 		 */
 		std::vector<Client *> *Select(double timeout);
 
+		/**
+		 * Change the method used by Select() to wait for socket readiness.
+		 * Backends not supported on the current platform fall back to the next best one.
+		 * @param backend Requested backend
+		 * @return The backend that is now in use
+		 */
+		Backend SetBackend(Backend backend);
+
+		/**
+		 * Parse a backend name ("epoll", "poll" or "select").
+		 * @return The default backend if the name is not recognised
+		 */
+		static Backend ParseBackend(const std::string &name);
+
+		Backend GetBackend() const;
+
+		/**
+		 * Refresh the readiness events a client is registered for.
+		 * Only has an effect with the epoll backend.
+		 */
+		void UpdateEvents(Client *client);
+
+		/**
+		 * Make sure a client is returned from the next call to Select() even if its socket is idle.
+		 */
+		void Wake(Client *client);
+
+		/**
+		 * Hand socket reads, writes and accepting new connections off to a
+		 * number of network threads once the server is listening.
+		 * Requires the epoll backend.
+		 * @param threads Number of threads to start, 0 to handle networking in Select()
+		 * @return The number of threads that will be used
+		 */
+		int SetIOThreads(int threads);
+
 		/**
 		 * Destroys any dead clients, should be called periodically.
 		 * All pointers to Client objects from this Server should be considered invalid after execution.
@@ -414,6 +529,8 @@ class Server
 		}
 
 		virtual ~Server();
+
+	friend struct Socket_IOThread;
 };
 
 #endif
@@ -27,8 +27,11 @@ typedef int socklen_t;
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/select.h>
-#ifdef SOCKET_POLL
+#include <sys/uio.h>
 #include <sys/poll.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#define SOCKET_EPOLL
 #endif
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -53,6 +56,10 @@ const SOCKET INVALID_SOCKET = -1;
  */
 const int SOCKET_ERROR = -1;
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif // MSG_NOSIGNAL
+
 #endif
 
 struct Socket
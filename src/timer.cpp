@@ -98,6 +98,14 @@ void Clock::SetMaxDelta(int max_delta)
 
 std::unique_ptr<Clock> Timer::clock;
 
+// Number of buckets in the timing wheel, must be a power of two
+static const std::size_t timer_wheel_size = 4096;
+
+static long long timer_tick(double time)
+{
+	return static_cast<long long>(time * 1000.0);
+}
+
 struct Timer::impl_t
 {
 	pthread_mutex_t m;
@@ -159,7 +167,8 @@ Timer::Timer()
 
 	this->resolution = sum / 100.0 - first;
 
-	this->changed = true;
+	this->wheel.resize(timer_wheel_size, 0);
+	this->wheel_tick = timer_tick(Timer::GetTime());
 }
 
 double Timer::GetTime()
@@ -178,24 +187,82 @@ void Timer::SetMaxDelta(int max_delta)
 		clock->SetMaxDelta(max_delta);
 }
 
+void Timer::Insert(TimeEvent *timer)
+{
+	// Events which are already overdue go in the next bucket to be checked
+	long long tick = std::max(timer_tick(timer->lasttime + timer->speed), this->wheel_tick + 1);
+	TimeEvent **head = &this->wheel[tick & (timer_wheel_size - 1)];
+
+	timer->wheel_prev = 0;
+	timer->wheel_next = *head;
+	timer->wheel_head = head;
+
+	if (*head)
+		(*head)->wheel_prev = timer;
+
+	*head = timer;
+}
+
+void Timer::Unlink(TimeEvent *timer)
+{
+	if (!timer->wheel_head)
+		return;
+
+	if (timer->wheel_prev)
+		timer->wheel_prev->wheel_next = timer->wheel_next;
+	else
+		*timer->wheel_head = timer->wheel_next;
+
+	if (timer->wheel_next)
+		timer->wheel_next->wheel_prev = timer->wheel_prev;
+
+	timer->wheel_prev = 0;
+	timer->wheel_next = 0;
+	timer->wheel_head = 0;
+}
+
 void Timer::Tick()
 {
 	double currenttime = Timer::GetTime();
+	long long target = timer_tick(currenttime);
 
 	impl->lock();
-	if (this->changed)
-	{
-		this->execlist = this->timers;
-		this->changed = false;
-	}
 
-	UTIL_FOREACH(this->execlist, timer)
+	long long tick = this->wheel_tick + 1;
+
+	// After a long stall every bucket only needs to be checked once
+	if (target - tick >= static_cast<long long>(timer_wheel_size))
+		tick = target - timer_wheel_size + 1;
+
+	// Anything re-inserted from here on goes in to a bucket that won't be checked until the next call
+	this->wheel_tick = std::max(this->wheel_tick, target);
+
+	for (; tick <= target; ++tick)
 	{
-		if (this->timers.find(timer) == this->timers.end())
+		TimeEvent *&bucket = this->wheel[tick & (timer_wheel_size - 1)];
+
+		if (!bucket)
 			continue;
 
-		if (timer->lasttime + timer->speed < currenttime)
+		// Move the bucket's events on to a local list so callbacks can unregister any of them safely
+		TimeEvent *batch = bucket;
+		bucket = 0;
+
+		for (TimeEvent *timer = batch; timer; timer = timer->wheel_next)
+			timer->wheel_head = &batch;
+
+		while (batch)
 		{
+			TimeEvent *timer = batch;
+			Timer::Unlink(timer);
+
+			// Not due yet, either later in this millisecond or a later turn of the wheel
+			if (!(timer->lasttime + timer->speed < currenttime))
+			{
+				this->Insert(timer);
+				continue;
+			}
+
 			impl->unlock();
 			timer->lasttime += timer->speed;
 
@@ -248,9 +315,18 @@ void Timer::Tick()
 #endif // DEBUG_EXCEPTIONS
 
 			if (timer->manager == 0)
+			{
 				delete timer;
+				impl->lock();
+			}
+			else
+			{
+				impl->lock();
 
-			impl->lock();
+				// Still registered and wasn't re-registered by its own callback
+				if (!timer->wheel_head)
+					this->Insert(timer);
+			}
 		}
 	}
 
@@ -268,16 +344,15 @@ void Timer::Register(TimeEvent *timer)
 	timer->manager = this;
 
 	impl->lock();
-	this->changed = true;
-	this->timers.insert(timer);
+	Timer::Unlink(timer);
+	this->Insert(timer);
 	impl->unlock();
 }
 
 void Timer::Unregister(TimeEvent *timer)
 {
 	impl->lock();
-	this->changed = true;
-	this->timers.erase(timer);
+	Timer::Unlink(timer);
 	impl->unlock();
 	timer->manager = 0;
 }
@@ -285,12 +360,16 @@ void Timer::Unregister(TimeEvent *timer)
 Timer::~Timer()
 {
 	impl->lock();
-	UTIL_FOREACH(this->timers, timer)
+	UTIL_FOREACH_REF(this->wheel, bucket)
 	{
-		timer->manager = 0;
-		delete timer;
+		while (bucket)
+		{
+			TimeEvent *timer = bucket;
+			Timer::Unlink(timer);
+			timer->manager = 0;
+			delete timer;
+		}
 	}
-	this->timers.clear();
 	impl->unlock();
 
 #ifdef WIN32
@@ -309,6 +388,9 @@ TimeEvent::TimeEvent(TimerCallback callback, void *param, double speed, int life
 	this->speed = speed;
 	this->lifetime = lifetime;
 	this->manager = 0;
+	this->wheel_prev = 0;
+	this->wheel_next = 0;
+	this->wheel_head = 0;
 }
 
 TimeEvent::~TimeEvent()
@@ -4,7 +4,7 @@
 #include "fwd/timer.hpp"
 
 #include <memory>
-#include <set>
+#include <vector>
 
 #include "platform.h"
 
@@ -39,19 +39,25 @@ class Timer
 
 	protected:
 		/**
-		 * List of TimeEvent objects a Timer controls
+		 * Timing wheel of TimeEvent objects, bucketed by the millisecond they are next due
+		 * Each bucket is an intrusive list, so registering and unregistering is O(1)
 		 */
-		std::set<TimeEvent *> timers;
+		std::vector<TimeEvent *> wheel;
 
 		/**
-		 * Copy of timers which is used to allow timers to unregister themselves safely
+		 * Millisecond the wheel has been advanced up to
 		 */
-		std::set<TimeEvent *> execlist;
+		long long wheel_tick;
 
 		/**
-		 * Used to track when execlist needs to be remade
+		 * Link a TimeEvent in to the bucket for the next time it is due
 		 */
-		bool changed;
+		void Insert(TimeEvent *);
+
+		/**
+		 * Remove a TimeEvent from whichever bucket it is in
+		 */
+		static void Unlink(TimeEvent *);
 
 	public:
 		/**
@@ -128,6 +134,14 @@ struct TimeEvent
 	 */
 	int lifetime;
 
+	/**
+	 * Intrusive list links used by the owning Timer
+	 * wheel_head is null while the event is not in a bucket (including during its callback)
+	 */
+	TimeEvent *wheel_prev;
+	TimeEvent *wheel_next;
+	TimeEvent **wheel_head;
+
 	/**
 	 * Construct a new TimeEvent object
 	 */
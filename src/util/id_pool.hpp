@@ -0,0 +1,116 @@
+#ifndef UTIL_ID_POOL_HPP_INCLUDED
+#define UTIL_ID_POOL_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace util
+{
+
+/**
+ * Set of IDs in use, handing out the lowest free one.
+ * Kept as a bitmap with the first word that has a free bit remembered, so
+ * the lowest free ID is found without looking at the IDs in use.
+ */
+class id_pool
+{
+	private:
+		std::vector<std::uint64_t> words;
+		std::size_t base;
+
+		// Every word before this one is full
+		std::size_t first_free;
+
+		static std::size_t lowest_zero(std::uint64_t word)
+		{
+#ifdef __GNUC__
+			return __builtin_ctzll(~word);
+#else // __GNUC__
+			std::size_t bit = 0;
+
+			while (word & (std::uint64_t(1) << bit))
+				++bit;
+
+			return bit;
+#endif // __GNUC__
+		}
+
+	public:
+		/**
+		 * IDs start from base, below which nothing is ever handed out
+		 */
+		explicit id_pool(std::size_t base = 1)
+			: base(base)
+			, first_free(0)
+		{ }
+
+		/**
+		 * Returns the lowest ID not in use, without taking it
+		 */
+		std::size_t lowest() const
+		{
+			if (this->first_free == this->words.size())
+				return this->base + this->words.size() * 64;
+
+			return this->base + this->first_free * 64 + lowest_zero(this->words[this->first_free]);
+		}
+
+		/**
+		 * Marks an ID as in use, does nothing if it already is or is below the base
+		 */
+		void take(std::size_t id)
+		{
+			if (id < this->base)
+				return;
+
+			std::size_t word = (id - this->base) / 64;
+
+			if (word >= this->words.size())
+				this->words.resize(word + 1, 0);
+
+			this->words[word] |= std::uint64_t(1) << ((id - this->base) % 64);
+
+			while (this->first_free < this->words.size() && this->words[this->first_free] == ~std::uint64_t(0))
+				++this->first_free;
+		}
+
+		/**
+		 * Takes and returns the lowest ID not in use
+		 */
+		std::size_t acquire()
+		{
+			std::size_t id = this->lowest();
+			this->take(id);
+			return id;
+		}
+
+		/**
+		 * Marks an ID as free again, does nothing if it isn't in use
+		 */
+		void release(std::size_t id)
+		{
+			if (id < this->base)
+				return;
+
+			std::size_t word = (id - this->base) / 64;
+
+			if (word >= this->words.size())
+				return;
+
+			this->words[word] &= ~(std::uint64_t(1) << ((id - this->base) % 64));
+
+			if (word < this->first_free)
+				this->first_free = word;
+		}
+
+		void clear()
+		{
+			this->words.clear();
+			this->first_free = 0;
+		}
+};
+
+}
+
+#endif // UTIL_ID_POOL_HPP_INCLUDED
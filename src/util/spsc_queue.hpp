@@ -0,0 +1,133 @@
+#ifndef UTIL_SPSC_QUEUE_HPP_INCLUDED
+#define UTIL_SPSC_QUEUE_HPP_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace util
+{
+
+/**
+ * Bounded lock-free queue for passing values from exactly one producer thread
+ * to exactly one consumer thread
+ */
+template <class T> class spsc_queue
+{
+	private:
+		std::vector<T> ring;
+		std::size_t mask;
+
+		// Padded out to separate cache lines so the two threads don't fight over them
+		char pad0[64];
+		std::atomic<std::size_t> head;
+		char pad1[64 - sizeof(std::atomic<std::size_t>)];
+		std::atomic<std::size_t> tail;
+		char pad2[64 - sizeof(std::atomic<std::size_t>)];
+
+		spsc_queue(const spsc_queue &) = delete;
+		spsc_queue &operator =(const spsc_queue &) = delete;
+
+	public:
+		/**
+		 * Capacity is rounded up to a power of two
+		 */
+		explicit spsc_queue(std::size_t capacity)
+			: head(0)
+			, tail(0)
+		{
+			std::size_t size = 2;
+
+			while (size < capacity)
+				size *= 2;
+
+			this->ring.resize(size);
+			this->mask = size - 1;
+		}
+
+		/**
+		 * Producer only. Returns false and leaves value untouched if the queue is full.
+		 */
+		bool push(T &&value)
+		{
+			const std::size_t t = this->tail.load(std::memory_order_relaxed);
+
+			if (t - this->head.load(std::memory_order_acquire) > this->mask)
+				return false;
+
+			this->ring[t & this->mask] = std::move(value);
+			this->tail.store(t + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		bool push(const T &value)
+		{
+			T copy(value);
+			return this->push(std::move(copy));
+		}
+
+		/**
+		 * Consumer only. Returns false if the queue is empty.
+		 */
+		bool pop(T &value)
+		{
+			const std::size_t h = this->head.load(std::memory_order_relaxed);
+
+			if (h == this->tail.load(std::memory_order_acquire))
+				return false;
+
+			value = std::move(this->ring[h & this->mask]);
+			this->ring[h & this->mask] = T();
+			this->head.store(h + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		/**
+		 * Consumer only. Returns a pointer to the oldest value, or 0 if the queue is empty.
+		 */
+		T *front()
+		{
+			const std::size_t h = this->head.load(std::memory_order_relaxed);
+
+			if (h == this->tail.load(std::memory_order_acquire))
+				return 0;
+
+			return &this->ring[h & this->mask];
+		}
+
+		/**
+		 * Consumer only. Discards the value returned by front().
+		 */
+		void pop()
+		{
+			const std::size_t h = this->head.load(std::memory_order_relaxed);
+
+			this->ring[h & this->mask] = T();
+			this->head.store(h + 1, std::memory_order_release);
+		}
+
+		/**
+		 * Approximate when called from a thread other than the producer or consumer
+		 */
+		std::size_t size() const
+		{
+			return this->tail.load(std::memory_order_acquire) - this->head.load(std::memory_order_acquire);
+		}
+
+		bool empty() const
+		{
+			return this->size() == 0;
+		}
+
+		std::size_t capacity() const
+		{
+			return this->mask + 1;
+		}
+};
+
+}
+
+#endif // UTIL_SPSC_QUEUE_HPP_INCLUDED
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdarg>
 #include <deque>
 #include <limits>
 #include <map>
@@ -226,8 +227,64 @@ void world_execute_weddings(void *world_void)
     }
 }
 
+World_Config::World_Config()
+	: see_distance(11)
+	, ghost_timer(4.0)
+	, drop_distance(2)
+	, protect_player_drop(5.0)
+	, protect_npc_drop(30.0)
+	, item_despawn_rate(600.0)
+	, npc_spells(false)
+	, npc_bored_timer(30.0)
+	, npc_chase_mode(1)
+	, npc_chase_distance(18)
+	, npc_adjust_max_dam(3)
+	, npc_idle_distance(30)
+	, npc_path_budget(20000)
+	, packet_queue_max(40)
+	, packets_per_tick(64)
+{ }
+
+void World_Config::Load(const Config &config)
+{
+	World_Config def;
+
+	this->see_distance = config.Get("SeeDistance", def.see_distance);
+	this->ghost_timer = config.Get("GhostTimer", def.ghost_timer);
+	this->drop_distance = config.Get("DropDistance", def.drop_distance);
+	this->protect_player_drop = config.Get("ProtectPlayerDrop", def.protect_player_drop);
+	this->protect_npc_drop = config.Get("ProtectNPCDrop", def.protect_npc_drop);
+	this->item_despawn_rate = config.Get("ItemDespawnRate", def.item_despawn_rate);
+
+	this->npc_spells = config.Get("NPCSpells", def.npc_spells);
+	this->npc_bored_timer = config.Get("NPCBoredTimer", def.npc_bored_timer);
+	this->npc_chase_mode = config.Get("NPCChaseMode", def.npc_chase_mode);
+	this->npc_chase_distance = config.Get("NPCChaseDistance", def.npc_chase_distance);
+	this->npc_adjust_max_dam = config.Get("NPCAdjustMaxDam", def.npc_adjust_max_dam);
+	this->npc_idle_distance = config.Get("NPCIdleDistance", def.npc_idle_distance);
+	this->npc_path_budget = config.Get("NPCPathBudget", def.npc_path_budget);
+
+	this->packet_queue_max = std::max(0, int(config.Get("PacketQueueMax", int(def.packet_queue_max))));
+	this->packets_per_tick = std::max(1, int(config.Get("PacketsPerTick", def.packets_per_tick)));
+}
+
 void World::UpdateConfig()
 {
+	int old_see_distance = this->hot_config.see_distance;
+
+	this->hot_config.Load(this->config);
+
+	if (this->hot_config.see_distance != old_see_distance)
+	{
+		UTIL_FOREACH(this->maps, map)
+		{
+			UTIL_FOREACH(map->characters, character)
+			{
+				map->UpdateView(character);
+			}
+		}
+	}
+
     this->timer.SetMaxDelta(this->config["ClockMaxDelta"]);
 
 	double rate_face = this->config["PacketRateFace"];
@@ -269,6 +326,15 @@ void World::UpdateConfig()
 		this->instrument_ids.push_back(int(util::tdparse(instrument_list[i])));
 	}
 
+	std::size_t commit_writes = std::max(int(this->config["CommitWrites"]), 0);
+	std::size_t commit_bytes = std::max(int(this->config["CommitBytes"]), 0);
+	double commit_interval = static_cast<double>(this->config["CommitInterval"]);
+
+	this->db.SetGroupCommit(commit_writes, commit_bytes, commit_interval);
+	this->db_worker.SetGroupCommit(commit_writes, commit_bytes, commit_interval);
+
+	SetPackedSerialize(this->config["PackedColumns"]);
+
 	if (this->db.Pending() && !this->config["TimedSave"])
         this->CommitDB();
 }
@@ -303,13 +369,11 @@ void world_act_npcs(void *world_void)
 	World *world(static_cast<World *>(world_void));
 
 	double current_time = Timer::GetTime();
+	world->npc_path_budget = world->hot_config.npc_path_budget;
+
 	UTIL_FOREACH(world->maps, map)
 	{
-		UTIL_FOREACH(map->npcs, npc)
-		{
-			if (npc->alive && npc->last_act + npc->act_speed < current_time)
-				npc->Act();
-		}
+		map->ActNPCs(current_time);
 	}
 }
 
@@ -494,7 +558,7 @@ bool World::SpawnDevilNPC(int id)
     }
 
     NPC *npc = new NPC(this->GetMap(int(this->devilgate_config["DevilMap"])), id, util::rand(int(this->devilgate_config["DevilSpawnX.1"]), int(this->devilgate_config["DevilSpawnX.2"])), util::rand(int(this->devilgate_config["DevilSpawnY.1"]), int(this->devilgate_config["DevilSpawnY.2"])), 1, 2, npc_index, true);
-    this->GetMap(int(this->devilgate_config["DevilMap"]))->npcs.push_back(npc);
+    this->GetMap(int(this->devilgate_config["DevilMap"]))->AddNPC(npc);
     npc->Spawn();
 
     return true;
@@ -530,7 +594,7 @@ void world_devilgate(void *world_void)
             {
                 for (int i = 0; i <= 5; i++)
                 {
-                    UTIL_FOREACH(maps->npcs, npc) { maps->npcs.erase(std::remove(maps->npcs.begin(), maps->npcs.end(), npc), maps->npcs.end()); }
+                    UTIL_FOREACH(maps->npcs, npc) { maps->RemoveNPC(npc); }
                 }
 
                 world->DevilGateEnabled = false;
@@ -747,24 +811,23 @@ void world_effects(void *world_void)
 {
     World *world = static_cast<World *>(world_void);
 
+    const std::vector<int> &paperdoll_effects = world->paperdoll_effects;
+    const std::vector<int> &inventory_effects = world->inventory_effects;
+
     UTIL_FOREACH(world->characters, character)
     {
-        for (std::size_t i = 0; i < character->paperdoll.size(); ++i)
+        for (std::size_t i = 1; i < character->paperdoll.size(); ++i)
         {
-            if (character->paperdoll[i] > 0 && i > 0)
-            {
-                if (int(world->timedeffects_config[util::to_string(character->paperdoll[i]) + ".paperdoll"]) >= 1)
-                    character->Effect(int(world->timedeffects_config[util::to_string(character->paperdoll[i]) + ".paperdoll"]));
-            }
+            int id = character->paperdoll[i];
+
+            if (id > 0 && std::size_t(id) < paperdoll_effects.size() && paperdoll_effects[id] >= 1)
+                character->Effect(paperdoll_effects[id]);
         }
 
         UTIL_FOREACH(character->inventory, item)
         {
-            if (item.id > 0)
-            {
-                if (int(world->timedeffects_config[util::to_string(item.id) + ".inventory"]) >= 1)
-                    character->Effect(int(world->timedeffects_config[util::to_string(item.id) + ".inventory"]));
-            }
+            if (item.id > 0 && std::size_t(item.id) < inventory_effects.size() && inventory_effects[item.id] >= 1)
+                character->Effect(inventory_effects[item.id]);
         }
     }
 }
@@ -1042,7 +1105,7 @@ void world_despawn_items(void *world_void)
 		restart_loop:
 		UTIL_FOREACH(map->items, item)
 		{
-			if (item->unprotecttime < (Timer::GetTime() - static_cast<double>(world->config["ItemDespawnRate"])))
+			if (item->unprotecttime < (Timer::GetTime() - world->hot_config.item_despawn_rate))
 			{
 			    if (map->id != util::to_int(world->ctf_config["CTFMap"]))
                     map->DelItem(item->uid, 0);
@@ -1057,22 +1120,22 @@ void world_speak_npcs(void *world_void)
 {
     World *world = static_cast<World *>(world_void);
 
+    double current_time = Timer::GetTime();
+
     UTIL_FOREACH(world->maps, map)
     {
         UTIL_FOREACH(map->npcs, npc)
         {
-            double timeinterval = util::to_float(world->npcs_config[util::to_string(npc->id) + ".interval"]), current_time = Timer::GetTime();
-
-            if (timeinterval > 0 && (current_time - npc->last_chat) >= timeinterval)
-            {
-                std::vector<std::string> chats;
+            if (npc->id <= 0 || std::size_t(npc->id) >= world->npc_chats.size())
+                continue;
 
-                for (int i = 1; std::string(world->npcs_config[util::to_string(npc->id) + ".chat" + util::to_string(i)]) != "0"; ++i)
-                    chats.push_back(world->npcs_config[util::to_string(npc->id) + ".chat" + util::to_string(i)]);
+            const NPC_Chat &chat = world->npc_chats[npc->id];
 
-                if (util::rand(0, 100) <= (util::to_int(world->npcs_config[util::to_string(npc->id) + ".frequency"])) && chats.size() > 0)
+            if (chat.interval > 0 && (current_time - npc->last_chat) >= chat.interval)
+            {
+                if (util::rand(0, 100) <= chat.frequency && chat.messages.size() > 0)
                 {
-                    npc->ShowDialog(chats.at(util::rand(0, chats.size() - 1)));
+                    npc->ShowDialog(chat.messages.at(util::rand(0, chat.messages.size() - 1)));
                     npc->last_chat = current_time;
                 }
                 else
@@ -1084,10 +1147,37 @@ void world_speak_npcs(void *world_void)
     }
 }
 
+void world_commit_due(void *world_void)
+{
+	World *world = static_cast<World *>(world_void);
+
+	world->db.CommitDue();
+}
+
+void world_journal(void *world_void)
+{
+	World *world = static_cast<World *>(world_void);
+
+	world->JournalCharacters();
+}
+
+void world_reload_bans(void *world_void)
+{
+	World *world = static_cast<World *>(world_void);
+
+	// Picks up bans added or lifted by anything other than World::Ban and World::Unban, and retries a failed load
+	if (!world->bans.Loaded() || static_cast<double>(world->config["BanRefresh"]) > 0.0)
+		world->LoadBans();
+}
+
 void world_timed_save(void *world_void)
 {
 	World *world = static_cast<World *>(world_void);
 
+	// One wait for everyone, rather than one per character from Save()
+	world->JournalCharacters();
+	world->HoldSavesForJournal();
+
 	UTIL_FOREACH(world->characters, character)
 	{
 		character->Save();
@@ -1100,6 +1190,8 @@ void world_timed_save(void *world_void)
 
 	world->CommitDB();
 	world->BeginDB();
+
+	world->CheckpointJournal();
 }
 
 void world_mapeffects(void *world_void)
@@ -1551,6 +1643,9 @@ void world_restart(void *world_void)
 {
     World *world = static_cast<World *>(world_void);
 
+	world->JournalCharacters();
+	world->journal.Sync();
+
     UTIL_FOREACH(world->characters, character)
     {
         character->Save();
@@ -1563,11 +1658,13 @@ void world_restart(void *world_void)
 
     world->CommitDB();
 	world->BeginDB();
+	world->db_worker.Stop();
+	world->CloseJournal();
 
     std::exit(0);
 }
 
-World::World(std::array<std::string, 6> dbinfo, const Config &eoserv_config, const Config &admin_config) : i18n(eoserv_config.find("ServerLanguage")->second), admin_count(0)
+World::World(std::array<std::string, 6> dbinfo, const Config &eoserv_config, const Config &admin_config) : i18n(eoserv_config.find("ServerLanguage")->second), npc_path_budget(0), admin_count(0)
 {
     this->global = true;
     this->last_chat = 0;
@@ -1587,6 +1684,68 @@ World::World(std::array<std::string, 6> dbinfo, const Config &eoserv_config, con
 	}
 
 	this->db.Connect(engine, dbinfo[1], util::to_int(dbinfo[5]), dbinfo[2], dbinfo[3], dbinfo[4]);
+
+	// The journal has to be on disk before anything newer is committed, or replaying it would roll the database back
+	this->db.SetCommitHook([this]() { this->journal.Sync(); });
+
+	this->journal_mark = 0;
+	this->journal_old_mark = 0;
+	this->journal_checkpointing = false;
+	this->journal_held = 0;
+
+	SetPackedSerialize(this->config["PackedColumns"]);
+
+	// Has to be done before anyone can log in and load a character from the database
+	this->ReplayJournal();
+	this->MigrateColumns();
+
+	if (this->config["TimedSave"] && !std::string(this->config["Journal"]).empty())
+	{
+		try
+		{
+			this->journal.Open(this->config["Journal"]);
+		}
+		catch (std::runtime_error &e)
+		{
+			Console::Wrn(e.what());
+		}
+	}
+
+	// A second SQLite connection would be locked out of the file whenever the worker is writing
+	if (this->config["AsyncSave"] && engine == Database::MySQL)
+	{
+		this->db_worker.Start(engine, dbinfo[1], util::to_int(dbinfo[5]), dbinfo[2], dbinfo[3], dbinfo[4]);
+	}
+
+	// Without the worker db may hold a transaction open, which another connection couldn't see in to
+	if (this->db_worker.Running() && engine == Database::MySQL && this->config["ReadConnection"])
+	{
+		auto read_setting = [&](const char *key, const std::string &main_setting)
+		{
+			std::string setting = this->config[key];
+			return setting.empty() || setting == "0" ? main_setting : setting;
+		};
+
+		try
+		{
+			this->db_read.Connect(engine, read_setting("DBReadHost", dbinfo[1]), util::to_int(read_setting("DBReadPort", dbinfo[5])),
+				read_setting("DBReadUser", dbinfo[2]), read_setting("DBReadPass", dbinfo[3]), read_setting("DBReadName", dbinfo[4]));
+		}
+		catch (Database_OpenFailed &e)
+		{
+			Console::Wrn("Could not open the read connection, reading from the main connection instead: %s", e.error());
+		}
+	}
+
+	try
+	{
+		this->hash_pool.Start(std::max(int(this->config["HashThreads"]), 0));
+	}
+	catch (std::runtime_error &e)
+	{
+		Console::Wrn("%s, hashing passwords on the main thread", e.what());
+	}
+
 	this->BeginDB();
 
 	try
@@ -1646,6 +1805,8 @@ World::World(std::array<std::string, 6> dbinfo, const Config &eoserv_config, con
 	this->esf = new ESF(this->config["ESF"]);
 	this->ecf = new ECF(this->config["ECF"]);
 
+	this->LoadNPCPrototypes();
+
 	this->maps.resize(static_cast<int>(this->config["Maps"]));
 
 	int loaded = 0;
@@ -1886,8 +2047,24 @@ World::World(std::array<std::string, 6> dbinfo, const Config &eoserv_config, con
 	{
 		event = new TimeEvent(world_timed_save, this, static_cast<double>(this->config["TimedSave"]), Timer::FOREVER);
 		this->timer.Register(event);
+
+		event = new TimeEvent(world_commit_due, this, 1.0, Timer::FOREVER);
+		this->timer.Register(event);
+
+		if (this->journal.IsOpen())
+		{
+			event = new TimeEvent(world_journal, this, static_cast<double>(this->config["JournalInterval"]), Timer::FOREVER);
+			this->timer.Register(event);
+		}
 	}
 
+	this->LoadBans();
+
+	// Still needed with BanRefresh off, in case the load above failed
+	double ban_refresh = static_cast<double>(this->config["BanRefresh"]);
+	event = new TimeEvent(world_reload_bans, this, ban_refresh > 0.0 ? ban_refresh : 60.0, Timer::FOREVER);
+	this->timer.Register(event);
+
 	if (int(this->event_config["EventTimer"]) > 0)
 	{
 		event = new TimeEvent(world_event, this, static_cast<double>(this->event_config["EventTimer"]), Timer::FOREVER);
@@ -1911,12 +2088,16 @@ World::World(std::array<std::string, 6> dbinfo, const Config &eoserv_config, con
 	this->LoadFish();
 	this->LoadMine();
 	this->LoadWood();
+	this->LoadNPCChats();
+	this->LoadTimedEffects();
+	this->LoadCurseFilter();
 }
 
 void World::BeginDB()
 {
-	if (this->config["TimedSave"])
-		this->db.BeginTransaction();
+	// The worker commits its own batches, and a transaction held open here would lock it out
+	if (this->config["TimedSave"] && !this->db_worker.Running())
+		this->db.BeginTransaction(true);
 }
 
 void World::CommitDB()
@@ -1925,6 +2106,356 @@ void World::CommitDB()
 		this->db.Commit();
 }
 
+Database &World::ReadDB()
+{
+	return this->db_read.Connected() ? this->db_read : this->db;
+}
+
+void World::QueueQuery(const char *format, ...)
+{
+	std::va_list ap;
+	va_start(ap, format);
+	std::string query = this->db.VFormat(format, ap);
+	va_end(ap);
+
+	if (this->db_worker.Running())
+		this->db_worker.Queue(query);
+	else
+		this->db.RawQuery(query.c_str());
+}
+
+void World::QueueExecute(const std::string &sql, const Database_Params &params, std::vector<std::string> keys, Database_Worker::Callback callback)
+{
+	if (this->db_worker.Running())
+	{
+		this->db_worker.Queue(sql, params, callback, std::move(keys));
+		return;
+	}
+
+	Database_Result result = this->db.Execute(sql, params);
+
+	if (callback)
+		callback(result);
+}
+
+void World::WaitForQueued(const std::string &key)
+{
+	if (this->db_worker.Running())
+		this->db_worker.Wait(key);
+}
+
+void World::JournalCharacters()
+{
+	if (!this->journal.IsOpen())
+		return;
+
+	UTIL_FOREACH(this->characters, character)
+	{
+		character->JournalChanges();
+	}
+
+	this->journal.Flush();
+}
+
+void World::HoldSavesForJournal()
+{
+	if (!this->journal.IsOpen())
+		return;
+
+	std::size_t frames = this->journal.Flush();
+
+	// Without the worker, db syncs the journal before every commit instead
+	if (!this->db_worker.Running() || frames == this->journal_held)
+		return;
+
+	this->journal_held = frames;
+	this->db_worker.QueueWait([this, frames]() { this->journal.WaitWritten(frames); });
+}
+
+void World::CheckpointJournal()
+{
+	if (!this->journal.IsOpen() || this->journal_checkpointing)
+		return;
+
+	std::size_t failures = this->db_worker.Failures();
+
+	if (!this->journal.Rotate())
+		this->journal_old_mark = this->journal_mark;
+
+	this->journal_mark = failures;
+
+	auto checkpoint = [this]()
+	{
+		this->journal_checkpointing = false;
+
+		// A failed write may have lost something only the journal still has, so it's kept for the next start
+		if (this->db_worker.Failures() != this->journal_old_mark)
+		{
+			Console::Wrn("Database writes have failed, keeping the journal to be replayed on the next start");
+			return;
+		}
+
+		this->journal.Checkpoint();
+		this->journal_old_mark = this->journal_mark;
+	};
+
+	// Without the worker, the saves were committed by CommitDB() before getting here
+	if (!this->db_worker.Running())
+	{
+		checkpoint();
+		return;
+	}
+
+	this->journal_checkpointing = true;
+	this->db_worker.QueueCallback([checkpoint](Database_Result &) { checkpoint(); });
+}
+
+void World::CloseJournal()
+{
+	if (!this->journal.IsOpen())
+		return;
+
+	if (this->db_worker.Failures() == this->journal_old_mark)
+	{
+		this->journal.Discard();
+	}
+	else
+	{
+		Console::Wrn("Database writes have failed, keeping the journal to be replayed on the next start");
+		this->journal.Close();
+	}
+}
+
+void World::ReplayJournal()
+{
+	std::string filename = this->config["Journal"];
+
+	if (filename.empty())
+		return;
+
+	struct Replay
+	{
+		// The latest values of the Position, Progress and GoldBank records
+		std::map<int, std::vector<int>> latest;
+
+		// The latest amount of each item that changed
+		std::map<short, int> inventory;
+		std::map<short, int> bank;
+
+		// The latest Paperdoll record
+		std::vector<int> paperdoll;
+	};
+
+	std::map<std::string, Replay> replays;
+
+	std::size_t records = Journal::Read(filename, [&](const Journal::Record &record)
+	{
+		Replay &replay = replays[record.name];
+
+		switch (record.type)
+		{
+			case Journal::Position:
+			case Journal::Progress:
+			case Journal::GoldBank:
+				replay.latest[record.type] = record.values;
+				break;
+
+			case Journal::Inventory:
+			case Journal::Bank:
+			{
+				std::map<short, int> &items = (record.type == Journal::Inventory) ? replay.inventory : replay.bank;
+
+				for (std::size_t i = 0; i + 1 < record.values.size(); i += 2)
+					items[short(record.values[i])] = record.values[i + 1];
+
+				break;
+			}
+
+			case Journal::Paperdoll:
+				replay.paperdoll = record.values;
+				break;
+
+			default:
+				Console::Wrn("Unknown journal record type: %i", int(record.type));
+		}
+	});
+
+	if (records == 0)
+	{
+		Journal::Remove(filename);
+		return;
+	}
+
+	auto apply_items = [](std::list<Character_Item> &list, const std::map<short, int> &changes)
+	{
+		UTIL_FOREACH_CREF(changes, change)
+		{
+			if (change.second <= 0)
+			{
+				list.remove_if([&](const Character_Item &item) { return item.id == change.first; });
+				continue;
+			}
+
+			auto it = std::find_if(UTIL_RANGE(list), [&](const Character_Item &item) { return item.id == change.first; });
+
+			if (it != list.end())
+				it->amount = change.second;
+			else
+				list.push_back(Character_Item(change.first, change.second));
+		}
+	};
+
+	static const std::map<int, const char *> latest_columns = {
+		{Journal::Position, "`map` = ?, `x` = ?, `y` = ?, `direction` = ?"},
+		{Journal::Progress, "`level` = ?, `exp` = ?, `statpoints` = ?, `skillpoints` = ?"},
+		{Journal::GoldBank, "`goldbank` = ?"}
+	};
+
+	static const std::map<int, std::size_t> latest_sizes = {
+		{Journal::Position, 4},
+		{Journal::Progress, 4},
+		{Journal::GoldBank, 1}
+	};
+
+	this->db.BeginTransaction();
+
+	try
+	{
+		UTIL_FOREACH_CREF(replays, entry)
+		{
+			const std::string &name = entry.first;
+			const Replay &replay = entry.second;
+			std::string columns;
+			Database_Params params;
+
+			UTIL_FOREACH_CREF(replay.latest, latest)
+			{
+				if (latest.second.size() != latest_sizes.at(latest.first))
+					continue;
+
+				columns += (columns.empty() ? "" : ", ");
+				columns += latest_columns.at(latest.first);
+
+				UTIL_FOREACH_CREF(latest.second, value)
+				{
+					params.Add(value);
+				}
+			}
+
+			if (!replay.inventory.empty() || !replay.bank.empty())
+			{
+				Database_Result res = this->db.Execute("SELECT `inventory`, `bank` FROM `characters` WHERE `name` = ?", Database_Params().Add(name));
+
+				if (res.empty())
+					continue;
+
+				if (!replay.inventory.empty())
+				{
+					std::list<Character_Item> inventory = ItemUnserialize(res.front()["inventory"]);
+					apply_items(inventory, replay.inventory);
+					columns += (columns.empty() ? "`inventory` = ?" : ", `inventory` = ?");
+					params.Add(ItemSerialize(inventory));
+				}
+
+				if (!replay.bank.empty())
+				{
+					std::list<Character_Item> bank = ItemUnserialize(res.front()["bank"]);
+					apply_items(bank, replay.bank);
+					columns += (columns.empty() ? "`bank` = ?" : ", `bank` = ?");
+					params.Add(ItemSerialize(bank));
+				}
+			}
+
+			if (replay.paperdoll.size() == 15)
+			{
+				std::array<int, 15> paperdoll;
+				std::copy(UTIL_RANGE(replay.paperdoll), paperdoll.begin());
+				columns += (columns.empty() ? "`paperdoll` = ?" : ", `paperdoll` = ?");
+				params.Add(DollSerialize(paperdoll));
+			}
+
+			if (columns.empty())
+				continue;
+
+			params.Add(name);
+			this->db.Execute("UPDATE `characters` SET " + columns + " WHERE `name` = ?", params);
+		}
+
+		this->db.Commit();
+	}
+	catch (Database_Exception &e)
+	{
+		// The journal is left alone so the next start can try again
+		Console::Err("Failed to replay journal %s: %s", filename.c_str(), e.error());
+
+		// A failed commit has already rolled back
+		if (this->db.Pending())
+			this->db.Rollback();
+
+		throw;
+	}
+
+	Console::Out("Replayed %i journal records for %i characters", int(records), int(replays.size()));
+
+	Journal::Remove(filename);
+}
+
+void World::MigrateColumns()
+{
+	bool packed = this->config["PackedColumns"];
+
+	// Packed columns start with '!', and empty columns read the same either way
+	auto other_format = [&](const char *column)
+	{
+		return packed ? std::string("(`") + column + "` <> '' AND `" + column + "` NOT LIKE '!%')"
+		              : std::string("`") + column + "` LIKE '!%'";
+	};
+
+	Database_Result characters = this->db.Query("SELECT `name`, `inventory`, `bank`, `paperdoll`, `spells` FROM `characters` WHERE @ OR @ OR @ OR @",
+		other_format("inventory").c_str(), other_format("bank").c_str(), other_format("paperdoll").c_str(), other_format("spells").c_str());
+
+	Database_Result pets = this->db.Query("SELECT `name`, `owner_name`, `inventory` FROM `pets` WHERE @", other_format("inventory").c_str());
+
+	if (characters.empty() && pets.empty())
+		return;
+
+	Console::Out("Converting %i characters and %i pets to the %s column format...", int(characters.size()), int(pets.size()), packed ? "packed" : "text");
+
+	this->db.BeginTransaction();
+
+	try
+	{
+		UTIL_FOREACH_CREF(characters, row)
+		{
+			this->db.Execute("UPDATE `characters` SET `inventory` = ?, `bank` = ?, `paperdoll` = ?, `spells` = ? WHERE `name` = ?", Database_Params()
+				.Add(ItemSerialize(ItemUnserialize(row["inventory"])))
+				.Add(ItemSerialize(ItemUnserialize(row["bank"])))
+				.Add(DollSerialize(DollUnserialize(row["paperdoll"])))
+				.Add(SpellSerialize(SpellUnserialize(row["spells"])))
+				.Add(row["name"].GetString()));
+		}
+
+		UTIL_FOREACH_CREF(pets, row)
+		{
+			this->db.Execute("UPDATE `pets` SET `inventory` = ? WHERE `name` = ? AND `owner_name` = ?", Database_Params()
+				.Add(ItemSerialize(ItemUnserialize(row["inventory"])))
+				.Add(row["name"].GetString())
+				.Add(row["owner_name"].GetString()));
+		}
+
+		this->db.Commit();
+	}
+	catch (Database_Exception &e)
+	{
+		Console::Err("Failed to convert columns: %s", e.error());
+
+		if (this->db.Pending())
+			this->db.Rollback();
+
+		throw;
+	}
+}
+
 void World::UpdateAdminCount(int admin_count)
 {
 	this->admin_count = admin_count;
@@ -2048,19 +2579,12 @@ int World::GenerateCharacterID()
 
 int World::GeneratePlayerID()
 {
-	unsigned int lowest_free_id = 1;
-	restart_loop:
-	UTIL_FOREACH(this->server->clients, client)
-	{
-		EOClient *eoclient = static_cast<EOClient *>(client);
+	return this->player_ids.acquire();
+}
 
-		if (eoclient->id == lowest_free_id)
-		{
-			lowest_free_id = eoclient->id + 1;
-			goto restart_loop;
-		}
-	}
-	return lowest_free_id;
+void World::ReleasePlayerID(int id)
+{
+	this->player_ids.release(id);
 }
 
 void World::Login(Character *character)
@@ -2131,6 +2655,8 @@ void World::Msg(Command_Source *from, std::string message, bool echo)
 	builder.AddBreakString(from_str);
 	builder.AddBreakString(message);
 
+	PacketBroadcast packet(builder);
+
 	UTIL_FOREACH(this->characters, character)
 	{
 		character->AddChatLog("~", from_str, message);
@@ -2140,7 +2666,7 @@ void World::Msg(Command_Source *from, std::string message, bool echo)
 			continue;
 		}
 
-		character->Send(builder);
+		character->Send(packet);
 	}
 }
 
@@ -2154,6 +2680,8 @@ void World::AdminMsg(Command_Source *from, std::string message, int minlevel, bo
 	builder.AddBreakString(from_str);
 	builder.AddBreakString(message);
 
+	PacketBroadcast packet(builder);
+
 	UTIL_FOREACH(this->characters, character)
 	{
 		character->AddChatLog("+", from_str, message);
@@ -2163,7 +2691,7 @@ void World::AdminMsg(Command_Source *from, std::string message, int minlevel, bo
 			continue;
 		}
 
-		character->Send(builder);
+		character->Send(packet);
 	}
 }
 
@@ -2177,6 +2705,8 @@ void World::AnnounceMsg(Command_Source *from, std::string message, bool echo)
 	builder.AddBreakString(from_str);
 	builder.AddBreakString(message);
 
+	PacketBroadcast packet(builder);
+
 	UTIL_FOREACH(this->characters, character)
 	{
 		character->AddChatLog("@", from_str, message);
@@ -2186,7 +2716,7 @@ void World::AnnounceMsg(Command_Source *from, std::string message, bool echo)
 			continue;
 		}
 
-		character->Send(builder);
+		character->Send(packet);
 	}
 }
 
@@ -2197,9 +2727,11 @@ void World::ServerMsg(std::string message)
 	PacketBuilder builder(PACKET_TALK, PACKET_SERVER, message.length());
 	builder.AddString(message);
 
+	PacketBroadcast packet(builder);
+
 	UTIL_FOREACH(this->characters, character)
 	{
-		character->Send(builder);
+		character->Send(packet);
 	}
 }
 
@@ -2209,9 +2741,11 @@ void World::StatusMsg(std::string message)
     builder.SetID(PACKET_MESSAGE, PACKET_OPEN);
     builder.AddString(message);
 
+    PacketBroadcast packet(builder);
+
     UTIL_FOREACH(this->characters, character)
     {
-        character->Send(builder);
+        character->Send(packet);
     }
 }
 
@@ -2260,7 +2794,7 @@ void World::AdminReport(Character *from, std::string reportee, std::string messa
 		{
 			try
 			{
-				this->db.Query("INSERT INTO `reports` (`reporter`, `reported`, `reason`, `time`, `chat_log`) VALUES ('$', '$', '$', #, '$')",
+				this->QueueQuery("INSERT INTO `reports` (`reporter`, `reported`, `reason`, `time`, `chat_log`) VALUES ('$', '$', '$', #, '$')",
 					from->SourceName().c_str(),
 					reportee.c_str(),
 					message.c_str(),
@@ -2382,18 +2916,18 @@ void World::Rehash()
 	this->LoadFish();
 	this->LoadMine();
 	this->LoadWood();
+	this->LoadNPCChats();
+	this->LoadTimedEffects();
+	this->LoadCurseFilter();
     this->LoadWlist();
 
 	UTIL_FOREACH(this->maps, map)
 	{
 		map->LoadArena();
-
-		UTIL_FOREACH(map->npcs, npc)
-		{
-			npc->LoadShopDrop();
-		}
 	}
 
+	this->LoadNPCPrototypes();
+
 	UTIL_FOREACH(this->commands, command)
     {
         command->Reload(this);
@@ -2466,6 +3000,162 @@ void World::LoadWood()
     }
 }
 
+void World::LoadNPCChats()
+{
+    this->npc_chats.clear();
+
+    UTIL_FOREACH(this->npcs_config, hc)
+    {
+        std::size_t dot = hc.first.find('.');
+
+        if (dot == std::string::npos || hc.first.compare(dot + 1, std::string::npos, "interval") != 0)
+        {
+            continue;
+        }
+
+        int id = util::to_int(hc.first.substr(0, dot));
+
+        if (id <= 0)
+        {
+            continue;
+        }
+
+        std::string prefix = hc.first.substr(0, dot + 1);
+
+        NPC_Chat chat;
+        chat.interval = util::to_float(hc.second);
+        chat.frequency = util::to_int(this->npcs_config.Get(prefix + "frequency"));
+
+        for (int i = 1; ; ++i)
+        {
+            std::string message = this->npcs_config.Get(prefix + "chat" + util::to_string(i));
+
+            if (message == "0")
+            {
+                break;
+            }
+
+            chat.messages.push_back(message);
+        }
+
+        if (std::size_t(id) >= this->npc_chats.size())
+        {
+            this->npc_chats.resize(id + 1);
+        }
+
+        this->npc_chats[id] = chat;
+    }
+}
+
+void World::LoadNPCPrototypes()
+{
+	std::vector<std::shared_ptr<const NPC_Prototype>> prototypes;
+	prototypes.reserve(std::max<std::size_t>(this->enf->data.size(), 1));
+
+	// ID 0 is left empty, to be handed out for unknown IDs
+	prototypes.push_back(std::make_shared<NPC_Prototype>());
+
+	for (std::size_t id = 1; id < this->enf->data.size(); ++id)
+	{
+		prototypes.push_back(std::make_shared<NPC_Prototype>(this, id));
+	}
+
+	// NPCs still pointing at the old prototypes keep them alive until they're moved on to the new ones
+	this->npc_prototypes.swap(prototypes);
+
+	UTIL_FOREACH(this->maps, map)
+	{
+		UTIL_FOREACH(map->npcs, npc)
+		{
+			npc->LoadShopDrop();
+		}
+	}
+}
+
+std::shared_ptr<const NPC_Prototype> World::GetNPCPrototype(short id)
+{
+	if (id <= 0 || std::size_t(id) >= this->npc_prototypes.size())
+		return this->npc_prototypes.empty() ? std::make_shared<NPC_Prototype>() : this->npc_prototypes[0];
+
+	return this->npc_prototypes[id];
+}
+
+void World::LoadTimedEffects()
+{
+    this->paperdoll_effects.clear();
+    this->inventory_effects.clear();
+
+    UTIL_FOREACH(this->timedeffects_config, hc)
+    {
+        std::size_t dot = hc.first.find('.');
+
+        if (dot == std::string::npos)
+        {
+            continue;
+        }
+
+        std::string slot = hc.first.substr(dot + 1);
+        std::vector<int> *effects;
+
+        if (slot == "paperdoll")
+        {
+            effects = &this->paperdoll_effects;
+        }
+        else if (slot == "inventory")
+        {
+            effects = &this->inventory_effects;
+        }
+        else
+        {
+            continue;
+        }
+
+        int id = util::to_int(hc.first.substr(0, dot));
+        int effect = int(hc.second);
+
+        if (id <= 0 || effect < 1)
+        {
+            continue;
+        }
+
+        if (std::size_t(id) >= effects->size())
+        {
+            effects->resize(id + 1, 0);
+        }
+
+        (*effects)[id] = effect;
+    }
+}
+
+void World::LoadCurseFilter()
+{
+    this->curse_filters.clear();
+
+    int amount = this->cursefilter_config.Get("Amount");
+
+    for (int i = 0; i < amount; ++i)
+    {
+        std::string prefix = util::to_string(i + 1);
+        Config::const_iterator message = this->cursefilter_config.find(prefix + ".Message");
+
+        if (message == this->cursefilter_config.end())
+        {
+            continue;
+        }
+
+        Curse_Filter filter;
+        filter.message = static_cast<std::string>(message->second);
+        filter.replacement = static_cast<std::string>(this->cursefilter_config.Get(prefix + ".Replacement"));
+
+        if (filter.message.empty())
+        {
+            continue;
+        }
+
+        this->curse_filters.push_back(filter);
+    }
+}
+
 void World::ReloadPub(bool quiet)
 {
     auto eif_id = this->eif->rid;
@@ -2478,6 +3168,9 @@ void World::ReloadPub(bool quiet)
 	this->esf->Read(this->config["ESF"]);
 	this->ecf->Read(this->config["ECF"]);
 
+	// Vendor IDs may have changed
+	this->LoadNPCPrototypes();
+
 	if (eif_id != this->eif->rid || enf_id != this->enf->rid || esf_id != this->esf->rid || ecf_id != this->ecf->rid)
 	{
 		if (!quiet)
@@ -2722,7 +3415,7 @@ Home *World::GetHome(std::string id)
 
 bool World::CharacterExists(std::string name)
 {
-	Database_Result res = this->db.Query("SELECT 1 FROM `characters` WHERE `name` = '$'", name.c_str());
+	Database_Result res = this->ReadDB().Query("SELECT 1 FROM `characters` WHERE `name` = '$'", name.c_str());
 	return !res.empty();
 }
 
@@ -2742,14 +3435,15 @@ Character *World::CreateCharacter(Player *player, std::string name, Gender gende
 
 	this->db.Query("INSERT INTO `characters` (`name`, `account`, `gender`, `hairstyle`, `haircolor`, `race`, `inventory`, `bank`, `paperdoll`, `spells`, `quest`, `vars`@) VALUES ('$','$',#,#,#,#,'$','','$','$','',''@)",
 		startmapinfo.c_str(), name.c_str(), player->username.c_str(), gender, hairstyle, haircolor, race,
-		static_cast<std::string>(this->config["StartItems"]).c_str(), static_cast<std::string>(gender?this->config["StartEquipMale"]:this->config["StartEquipFemale"]).c_str(),
-		static_cast<std::string>(this->config["StartSpells"]).c_str(), startmapval.c_str());
+		ItemSerialize(ItemUnserialize(this->config["StartItems"])).c_str(), DollSerialize(DollUnserialize(gender?this->config["StartEquipMale"]:this->config["StartEquipFemale"])).c_str(),
+		SpellSerialize(SpellUnserialize(this->config["StartSpells"])).c_str(), startmapval.c_str());
 
 	return new Character(name, this);
 }
 
 void World::DeleteCharacter(std::string name)
 {
+	this->WaitForQueued("character:" + name);
 	this->db.Query("DELETE FROM `pets` WHERE owner_name = '$'", name.c_str());
     this->db.Query("DELETE FROM `characters` WHERE name = '$'", name.c_str());
 }
@@ -2767,14 +3461,20 @@ Player *World::Login(std::string username)
 	return new Player(username, this);
 }
 
-LoginReply World::LoginCheck(const std::string& username, util::secure_string&& password)
+void World::HashPassword(const void *owner, const std::string& username, util::secure_string&& password, Hash_Pool::Callback callback)
 {
+	std::string salt = this->config["PasswordSalt"];
+
+	this->hash_pool.Queue(owner, std::move(password), [salt, username](util::secure_string &password)
 	{
-		util::secure_string password_buffer(std::move(std::string(this->config["PasswordSalt"]) + username + password.str()));
+		util::secure_string password_buffer(std::move(salt + username + password.str()));
 		password = sha256(password_buffer.str());
-	}
+	}, std::move(callback));
+}
 
-	Database_Result res = this->db.Query("SELECT 1 FROM `accounts` WHERE `username` = '$' AND `password` = '$'", username.c_str(), password.str().c_str());
+LoginReply World::LoginCheck(const std::string& username, util::secure_string&& password)
+{
+	Database_Result res = this->ReadDB().Query("SELECT 1 FROM `accounts` WHERE `username` = '$' AND `password` = '$'", username.c_str(), password.str().c_str());
 
 	if (res.empty())
 	{
@@ -2794,11 +3494,6 @@ bool World::CreatePlayer(const std::string& username, util::secure_string&& pass
 	const std::string& fullname, const std::string& location, const std::string& email,
 	const std::string& computer, const std::string& hdid, const std::string& ip)
 {
-	{
-		util::secure_string password_buffer(std::move(std::string(this->config["PasswordSalt"]) + username + password.str()));
-		password = sha256(password_buffer.str());
-	}
-
 	Database_Result result = this->db.Query("INSERT INTO `accounts` (`username`, `password`, `fullname`, `location`, `email`, `computer`, `hdid`, `regip`, `created`) VALUES ('$','$','$','$','$','$','$','$',#)",
 		username.c_str(), password.str().c_str(), fullname.c_str(), location.c_str(), email.c_str(), computer.c_str(), hdid.c_str(), ip.c_str(), int(std::time(0)));
 
@@ -2807,7 +3502,7 @@ bool World::CreatePlayer(const std::string& username, util::secure_string&& pass
 
 bool World::PlayerExists(std::string username)
 {
-	Database_Result res = this->db.Query("SELECT 1 FROM `accounts` WHERE `username` = '$'", username.c_str());
+	Database_Result res = this->ReadDB().Query("SELECT 1 FROM `accounts` WHERE `username` = '$'", username.c_str());
 	return !res.empty();
 }
 
@@ -2918,8 +3613,8 @@ void World::Unban(Command_Source* from, std::string name, bool announce)
 {
     if (this->CharacterExists(name))
     {
-        Database_Result res = this->db.Query("SELECT `account` FROM `characters` WHERE `name` = '$'", name.c_str());
-        std::unordered_map<std::string, util::variant> row = res.front();
+        Database_Result res = this->ReadDB().Query("SELECT `account` FROM `characters` WHERE `name` = '$'", name.c_str());
+        Database_Row row = res.front();
         std::string account = static_cast<std::string>(row["account"]);
 
         if (this->CheckBan(account))
@@ -2927,7 +3622,8 @@ void World::Unban(Command_Source* from, std::string name, bool announce)
             if (announce)
                 this->ServerMsg(i18n.Format("AnnounceUnbanned", util::ucfirst(name), from ? from->SourceName() : "server", i18n.Format("Unbanned")));
 
-            this->db.Query("DELETE FROM `bans` WHERE username = '$'", account.c_str());
+            this->bans.Remove(account);
+            this->QueueExecute("DELETE FROM `bans` WHERE `username` = ?", Database_Params().Add(account), {"bans"});
         }
         else
         {
@@ -2947,74 +3643,101 @@ void World::Ban(Command_Source *from, Character *victim, int duration, bool anno
 	if (announce)
 		this->ServerMsg(i18n.Format("AnnounceRemoved", victim->SourceName(), from_str, i18n.Format("banned")));
 
-	std::string query("INSERT INTO bans (username, ip, hdid, expires, setter) VALUES ");
+	BanList::Ban ban;
+	ban.has_username = ban.has_ip = ban.has_hdid = true;
+	ban.username = victim->player->username;
+	ban.ip = static_cast<int>(victim->player->client->GetRemoteAddr());
+	ban.hdid = victim->player->client->hdid;
+	ban.expires = (duration == -1) ? 0 : int(std::time(0) + duration);
 
-	query += "('" + db.Escape(victim->player->username) + "', ";
-	query += util::to_string(static_cast<int>(victim->player->client->GetRemoteAddr())) + ", ";
-	query += util::to_string(victim->player->client->hdid) + ", ";
+	// The ban takes effect straight away even if it can't be saved, or the list hasn't loaded yet
+	this->bans.Add(ban);
 
-	if (duration == -1)
+	try
 	{
-		query += "0";
+		this->QueueExecute("INSERT INTO `bans` (`username`, `ip`, `hdid`, `expires`, `setter`) VALUES (?, ?, ?, ?, ?)",
+			Database_Params().Add(ban.username).Add(ban.ip).Add(ban.hdid).Add(ban.expires).Add(from_str), {"bans"});
 	}
-	else
+	catch (Database_Exception& e)
 	{
-		query += util::to_string(int(std::time(0) + duration));
+		Console::Err("Could not save ban to database.");
+		Console::Err("%s", e.error());
 	}
 
-	query += ", '" + db.Escape(from_str) + "')";
+	victim->player->client->Close();
+}
+
+void World::LoadBans()
+{
+	// A reload that ran ahead of a queued ban or unban would undo it until the next one
+	this->WaitForQueued("bans");
 
 	try
 	{
-		this->db.Query(query.c_str());
+		this->bans.Load(this->db);
 	}
-	catch (Database_Exception& e)
+	catch (Database_Exception &e)
 	{
-		Console::Err("Could not save ban to database.");
-		Console::Err("%s", e.error());
+		if (this->bans.Loaded())
+			Console::Err("Could not reload bans, keeping the previous list: %s", e.error());
+		else
+			Console::Err("Could not load bans, checking the database directly until they do: %s", e.error());
 	}
-
-	victim->player->client->Close();
 }
 
 int World::CheckBan(const std::string *username, const IPAddress *address, const int *hdid)
 {
-	std::string query("SELECT COALESCE(MAX(expires),-1) AS expires FROM bans WHERE (");
+	int ip = address ? static_cast<int>(*address) : 0;
+	int expires = this->bans.Check(username, address ? &ip : 0, hdid, int(std::time(0)));
+
+	// Until the list loads it only holds bans made since, so the table is asked as well
+	if (this->bans.Loaded() || (!username && !address && !hdid))
+		return expires;
 
-	if (!username && !address && !hdid)
-		return -1;
+	std::string query("SELECT COALESCE(MAX(expires),-1) AS expires FROM bans WHERE (");
+	Database_Params params;
 
+	// At most seven distinct statements come out of this, each prepared once
 	if (username)
 	{
-		query += "username = '";
-		query += db.Escape(*username);
-		query += "' OR ";
+		query += "username = ? OR ";
+		params.Add(*username);
 	}
 
 	if (address)
 	{
-		query += "ip = ";
-		query += util::to_string(static_cast<int>(*const_cast<IPAddress *>(address)));
-		query += " OR ";
+		query += "ip = ? OR ";
+		params.Add(ip);
 	}
 
 	if (hdid)
 	{
-		query += "hdid = ";
-		query += util::to_string(*hdid);
-		query += " OR ";
+		query += "hdid = ? OR ";
+		params.Add(*hdid);
 	}
 
-	Database_Result res = db.Query((query.substr(0, query.length()-4) + ") AND (expires > # OR expires = 0)").c_str(), int(std::time(0)));
+	params.Add(int(std::time(0)));
+
+	this->WaitForQueued("bans");
+	Database_Result res = this->db.Execute(query.substr(0, query.length()-4) + ") AND (expires > ? OR expires = 0)", params);
+	int db_expires = static_cast<int>(res[0]["expires"]);
+
+	if (expires == 0 || db_expires == 0)
+		return 0;
 
-	return static_cast<int>(res[0]["expires"]);
+	return std::max(expires, db_expires);
 }
 
 bool World::CheckBan(std::string username)
 {
-    Database_Result res = this->db.Query("SELECT 1 FROM `bans` WHERE `username` = '$'", username.c_str());
+	if (this->CheckBan(&username, 0, 0) != -1)
+		return true;
+
+	// Expired bans are still matched, so $unban clears them out of the table
+	this->WaitForQueued("bans");
+	Database_Result res = this->db.Execute("SELECT 1 FROM `bans` WHERE `username` = ?", Database_Params().Add(username));
 
-    return !res.empty();
+	return !res.empty();
 }
 
 static std::list<int> PKExceptUnserialize(std::string serialized)
@@ -3123,6 +3846,9 @@ World::~World()
 {
 	std::list<Character *> todelete;
 
+	this->JournalCharacters();
+	this->journal.Sync();
+
 	UTIL_FOREACH(this->characters, character)
 	{
 		todelete.push_back(character);
@@ -3136,10 +3862,9 @@ World::~World()
 
 	delete this->guildmanager;
 
-	if (this->config["TimedSave"])
-	{
-		this->db.Commit();
-	}
+	this->db_worker.Stop();
+	this->CommitDB();
+	this->CloseJournal();
 }
 
 void World::Restart()
@@ -10,10 +10,14 @@
 #include <string>
 #include <vector>
 
+#include "banlist.hpp"
 #include "config.hpp"
 #include "database.hpp"
+#include "hash.hpp"
+#include "journal.hpp"
 #include "map.hpp"
 #include "timer.hpp"
+#include "util/id_pool.hpp"
 #include "util/secure_string.hpp"
 #include "i18n.hpp"
 
@@ -23,6 +27,7 @@
 #include "fwd/eoserver.hpp"
 #include "fwd/guild.hpp"
 #include "fwd/map.hpp"
+#include "fwd/npc.hpp"
 #include "fwd/party.hpp"
 #include "fwd/player.hpp"
 #include "fwd/quest.hpp"
@@ -85,6 +90,54 @@ struct Mine_Drop
     int exp;
 };
 
+struct NPC_Chat
+{
+    double interval;
+    int frequency;
+    std::vector<std::string> messages;
+
+    NPC_Chat() : interval(0.0), frequency(0) { }
+};
+
+struct Curse_Filter
+{
+    std::string message;
+    std::string replacement;
+};
+
+/**
+ * Typed copies of config.ini values read on hot paths, so they don't need a
+ * string hash and variant conversion on every use.
+ * Resolved from World::config on startup and on every rehash.
+ */
+struct World_Config
+{
+	int see_distance;
+	double ghost_timer;
+	int drop_distance;
+	double protect_player_drop;
+	double protect_npc_drop;
+	double item_despawn_rate;
+
+	bool npc_spells;
+	double npc_bored_timer;
+	int npc_chase_mode;
+	int npc_chase_distance;
+	int npc_adjust_max_dam;
+	int npc_idle_distance;
+	int npc_path_budget;
+
+	std::size_t packet_queue_max;
+	int packets_per_tick;
+
+	World_Config();
+
+	/**
+	 * Resolves every field from config without inserting missing keys
+	 */
+	void Load(const Config &config);
+};
+
 /**
  * Object which holds and manages all maps and characters on the server, as well as timed events
  * Only one of these should exist per server
@@ -93,6 +146,9 @@ class World
 {
 	protected:
 		int last_character_id;
+
+		// IDs held by connected clients, see GeneratePlayerID()
+		util::id_pool player_ids;
 		void UpdateConfig();
 
 	public:
@@ -100,6 +156,26 @@ class World
 
 		EOServer *server;
 		Database db;
+		Database_Worker db_worker;
+
+		// Separate connection for ReadDB(), possibly to a read replica
+		Database db_read;
+		Hash_Pool hash_pool;
+
+		Journal journal;
+
+		// Loaded on the first ban check, as the bans table may not have been installed yet
+		BanList bans;
+
+		// db_worker.Failures() from before the oldest record in the current journal file / in its .old file
+		std::size_t journal_mark;
+		std::size_t journal_old_mark;
+
+		// Waiting on db_worker to commit the saves made at the last rotation
+		bool journal_checkpointing;
+
+		// Journal frames already waited on by a job queued on db_worker, see HoldSavesForJournal()
+		std::size_t journal_held;
 
 		GuildManager *guildmanager;
 
@@ -150,6 +226,8 @@ class World
         Config pvp_config;
         Config shrines_config;
 
+		World_Config hot_config;
+
         I18N i18n;
 
 		std::vector<Character *> characters;
@@ -170,6 +248,18 @@ class World
 		std::array<int, 254> exp_table;
 		std::vector<int> instrument_ids;
 
+		// Compiled from npcs_config, timedeffects_config and cursefilter_config, indexed by NPC/item ID
+		std::vector<NPC_Chat> npc_chats;
+		std::vector<int> paperdoll_effects;
+		std::vector<int> inventory_effects;
+		std::vector<Curse_Filter> curse_filters;
+
+		// Built from drops_config, shops_config, skills_config and home_config, indexed by ENF ID
+		std::vector<std::shared_ptr<const NPC_Prototype>> npc_prototypes;
+
+		// Tiles of pathfinding NPCs may still search this tick, reset by world_act_npcs
+		int npc_path_budget;
+
 		int admin_count;
 		int WaveNPCs;
         int wave;
@@ -180,6 +270,64 @@ class World
 		void BeginDB();
 		void CommitDB();
 
+		/**
+		 * Connection for looking up accounts and character names, which are only ever written straight to db.
+		 * Queries on it don't wait for db_worker, so nothing written through QueueQuery() may be read from it.
+		 * Returns db if there's no separate read connection.
+		 */
+		Database &ReadDB();
+
+		/**
+		 * Runs a write query through db_worker if AsyncSave is enabled, otherwise straight away on db
+		 */
+		void QueueQuery(const char *format, ...);
+
+		/**
+		 * Runs a prepared statement through db_worker if AsyncSave is enabled, otherwise straight away on db
+		 * @param keys What the statement writes to, such as "character:<name>", "account:<username>" or "guild:<tag>"
+		 * @param callback Called once the statement has been committed or has failed, straight away without db_worker
+		 */
+		void QueueExecute(const std::string &sql, const Database_Params &params, std::vector<std::string> keys = std::vector<std::string>(), Database_Worker::Callback callback = Database_Worker::Callback());
+
+		/**
+		 * Blocks until the writes queued with a key have been committed.
+		 * To be called before anything on db that reads or writes the same rows.
+		 */
+		void WaitForQueued(const std::string &key);
+
+		/**
+		 * Records changes to every online character in the journal and hands them to its writer thread
+		 */
+		void JournalCharacters();
+
+		/**
+		 * Flushes the journal and holds back saves queued after this until it's on disk,
+		 * as replaying records older than the database would roll characters back
+		 */
+		void HoldSavesForJournal();
+
+		/**
+		 * Rotates the journal after a timed save, and removes the old part once the save has been committed
+		 */
+		void CheckpointJournal();
+
+		/**
+		 * Removes the journal once the final saves have been committed, or leaves it to be replayed if any failed
+		 */
+		void CloseJournal();
+
+		/**
+		 * Writes whatever was left in the journal by a crash to the database
+		 * @throw Database_Exception
+		 */
+		void ReplayJournal();
+
+		/**
+		 * Rewrites item, paperdoll and spell columns stored in the other format to the one selected by PackedColumns
+		 * @throw Database_Exception
+		 */
+		void MigrateColumns();
+
 		void UpdateAdminCount(int admin_count);
 		void IncAdminCount() { UpdateAdminCount(this->admin_count + 1); }
 		void DecAdminCount() { UpdateAdminCount(this->admin_count - 1); }
@@ -191,13 +339,37 @@ class World
 		void LoadFish();
 		void LoadMine();
 		void LoadWood();
+		void LoadNPCChats();
+
+		/**
+		 * Rebuilds every NPC prototype and points the NPCs on every map at the new ones
+		 */
+		void LoadNPCPrototypes();
+
+		/**
+		 * Returns the prototype shared by NPCs with an ENF ID, or an empty one for an unknown ID
+		 */
+		std::shared_ptr<const NPC_Prototype> GetNPCPrototype(short id);
+
+		void LoadTimedEffects();
+		void LoadCurseFilter();
 
         int FindMap(std::string mapname);
 		int GenerateCharacterID();
+
+		/**
+		 * Reserves the lowest player ID not held by a client, to be given back with ReleasePlayerID()
+		 */
 		int GeneratePlayerID();
+		void ReleasePlayerID(int id);
 
 		bool SpawnDevilNPC(int id);
+
+		/**
+		 * Checks for any ban on an account, including expired ones
+		 */
 		bool CheckBan(std::string username);
+
         bool DevilGateEnabled;
 
 		void Login(Character *);
@@ -261,8 +433,17 @@ class World
 		void Ban(Command_Source *from, Character *victim, int duration, bool announce = true);
 		void Unban(Command_Source* from, std::string name, bool announce = true);
 
+		/**
+		 * Checks the cached bans, or the bans table as well if they couldn't be loaded
+		 * @return -1 if not banned, 0 if banned permanently, otherwise when the ban expires
+		 */
 		int CheckBan(const std::string *username, const IPAddress *address, const int *hdid);
 
+		/**
+		 * Reloads the ban cache from the database
+		 */
+		void LoadBans();
+
 		Character *GetCharacter(std::string name);
 		Character *GetCharacterReal(std::string real_name);
 		Character *GetCharacterPID(unsigned int id);
@@ -276,6 +457,13 @@ class World
 		Character *CreateCharacter(Player *, std::string name, Gender, int hairstyle, int haircolor, Skin);
 		void DeleteCharacter(std::string name);
 
+		/**
+		 * Salts and hashes a password on hash_pool, callback is called from the main thread with the result
+		 * @param owner Passed on to Hash_Pool::Cancel(), usually the client the password came from
+		 */
+		void HashPassword(const void *owner, const std::string& username, util::secure_string&& password, Hash_Pool::Callback callback);
+
+		// The following take passwords already hashed by HashPassword()
 		Player *Login(const std::string& username, util::secure_string&& password);
 		Player *Login(std::string username);
 		LoginReply LoginCheck(const std::string& username, util::secure_string&& password);